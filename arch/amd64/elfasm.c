@@ -0,0 +1,2743 @@
+/*	$Id$	*/
+/*
+ * Copyright (c) 2026 The pcc project. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Integrated assembler for amd64 ELF targets.
+ *
+ * The assembler text written by ccom is read back and encoded into a
+ * relocatable ELF64 object, so that the driver need not run as(1).
+ * Only the subset of the AT&T syntax that pcc itself emits is known.
+ * Anything else (stabs, TLS sequences, unusual inline assembler)
+ * makes elfasm() fail without writing the object, and the caller
+ * then falls back to the external assembler.
+ *
+ * Memory is never given back; ccom exits right after.
+ */
+
+# include "pass2.h"
+# include <setjmp.h>
+# include <stdarg.h>
+# include <stdlib.h>
+# include <string.h>
+
+#ifdef TARGET_OBJWRITE
+
+/* ELF definitions used */
+#define	SHT_PROGBITS	1
+#define	SHT_SYMTAB	2
+#define	SHT_STRTAB	3
+#define	SHT_RELA	4
+#define	SHT_NOTE	7
+#define	SHT_NOBITS	8
+#define	SHT_INIT_ARRAY	14
+#define	SHT_FINI_ARRAY	15
+#define	SHT_PREINIT_ARRAY 16
+
+#define	SHF_WRITE	0x1
+#define	SHF_ALLOC	0x2
+#define	SHF_EXECINSTR	0x4
+#define	SHF_MERGE	0x10
+#define	SHF_STRINGS	0x20
+#define	SHF_INFO_LINK	0x40
+#define	SHF_TLS		0x400
+
+#define	SHN_ABS		0xfff1
+#define	SHN_COMMON	0xfff2
+
+#define	STB_LOCAL	0
+#define	STB_GLOBAL	1
+#define	STB_WEAK	2
+
+#define	STT_NOTYPE	0
+#define	STT_OBJECT	1
+#define	STT_FUNC	2
+#define	STT_SECTION	3
+#define	STT_FILE	4
+#define	STT_TLS		6
+
+#define	R_X86_64_64	1
+#define	R_X86_64_PC32	2
+#define	R_X86_64_PLT32	4
+#define	R_X86_64_GOTPCREL 9
+#define	R_X86_64_32	10
+#define	R_X86_64_32S	11
+#define	R_X86_64_16	12
+#define	R_X86_64_PC16	13
+#define	R_X86_64_8	14
+#define	R_X86_64_PC8	15
+#define	R_X86_64_PC64	24
+#define	R_X86_64_GOTPCRELX 41
+#define	R_X86_64_REX_GOTPCRELX 42
+#define	ISGOTREL(t)	((t) == R_X86_64_GOTPCREL || \
+	(t) == R_X86_64_GOTPCRELX || (t) == R_X86_64_REX_GOTPCRELX)
+
+/*
+ * An expression is sym - msym + val, possibly with a relocation modifier.
+ */
+struct expr {
+	struct asym *add, *sub;
+	long long val;
+	int mod;
+#define	M_PLT		1
+#define	M_GOTPCREL	2
+#define	M_GOTPCRELX	3	/* relaxable by the linker */
+#define	M_REXGOTPCRELX	4	/* the same, with a REX prefix */
+};
+
+/*
+ * Section contents are kept in frags; each frag is a fixed part
+ * followed by a variable-sized part (alignment or a relaxable branch)
+ * whose size is only known after layout.
+ */
+struct frag {
+	struct frag *next;
+	unsigned char *buf;
+	int len, alen;
+	int addr;
+	int vtype, vsize;
+#define	V_NONE	0
+#define	V_JMP	1
+#define	V_JCC	2
+#define	V_ALIGN	3
+	int vcc, valign, vfill;
+	struct expr vexp;
+};
+
+struct fixup {
+	struct fixup *next;
+	struct frag *frag;
+	int off, size;
+	int pcrel, pcadj;	/* pc-relative, bytes to end of insn */
+	int sign;		/* sign-extended 32-bit field */
+	int call;		/* call or jump target */
+	struct expr e;
+};
+
+struct rel {
+	int off, type;
+	struct asym *sym;
+	struct asect *sec;	/* if relative a section symbol */
+	long long addend;
+};
+
+struct asect {
+	struct asect *next;
+	char *name;
+	int type, flags, align, entsize;
+	struct frag *first, *last;
+	struct fixup *fix, **lfix;
+	struct rel *rel;
+	int nrel, arel;
+	int size, idx, symidx;
+};
+
+struct asym {
+	struct asym *next, *lnext;
+	char *name;
+	struct asect *sec;	/* defined in this section */
+	struct frag *frag;
+	int off;
+	int bind, type, vis;
+	int temp, used, local, abs;
+	int hassize, comm, calign;
+	long long csize;
+	struct expr size, *set;
+	int idx;
+};
+
+static jmp_buf aserrbuf;
+static int aslineno, asend;
+
+#define	ASHSZ	1024
+static struct asym *symhash[ASHSZ], *symlist, **lsym = &symlist;
+static struct asect *sects, **lsect = &sects;
+static struct asect *cursec, *bsssec, *comsec;
+static struct frag *curfrag;
+static struct asym *filesym, **lcomms;
+static int nlcomm;
+
+static void aserr(char *fmt, ...);
+
+static void *
+asalloc(size_t sz)
+{
+	void *p;
+
+	if ((p = calloc(1, sz)) == NULL)
+		aserr("out of memory");
+	return p;
+}
+
+static char *
+asstrdup(char *s)
+{
+	return strcpy(asalloc(strlen(s) + 1), s);
+}
+
+static void
+aserr(char *fmt, ...)
+{
+	va_list ap;
+
+	if (x2debug) {
+		va_start(ap, fmt);
+		fprintf(stderr, "elfasm: line %d: ", aslineno);
+		vfprintf(stderr, fmt, ap);
+		fputc('\n', stderr);
+		va_end(ap);
+	}
+	longjmp(aserrbuf, 1);
+}
+
+static unsigned int
+ashash(char *s)
+{
+	unsigned int h = 0;
+
+	while (*s)
+		h = h * 31 + (unsigned char)*s++;
+	return h % ASHSZ;
+}
+
+/*
+ * Symbol handling.
+ */
+static struct asym *
+symlook(char *name)
+{
+	struct asym *s;
+	unsigned int h = ashash(name);
+
+	for (s = symhash[h]; s; s = s->next)
+		if (strcmp(s->name, name) == 0)
+			return s;
+	s = asalloc(sizeof(struct asym));
+	s->name = asstrdup(name);
+	s->temp = name[0] == '.' && name[1] == 'L';
+	s->next = symhash[h];
+	symhash[h] = s;
+	*lsym = s;
+	lsym = &s->lnext;
+	return s;
+}
+
+/* position of label, only valid after layout */
+#define	SADDR(s)	((s)->frag->addr + (s)->off)
+
+static void
+setlab(struct asym *s)
+{
+	if (s->sec || s->comm || s->set)
+		aserr("%s redefined", s->name);
+	s->sec = cursec;
+	s->frag = curfrag;
+	s->off = curfrag->len;
+}
+
+/*
+ * Numeric local labels; n: defines, nb and nf refer to the
+ * previous and next definition.  The counter is kept in a temp symbol.
+ */
+static struct asym *
+numlab(char *n, int dir)
+{
+	struct asym *c;
+	char buf[40];
+
+	if (strlen(n) > 20)
+		aserr("bad label %s", n);
+	snprintf(buf, sizeof(buf), "\001%s", n);
+	c = symlook(buf);
+	c->temp = 1;
+	if (dir == 0)
+		c->off++;
+	snprintf(buf, sizeof(buf), "\002%s:%d", n, c->off + (dir == 'f'));
+	c = symlook(buf);
+	c->temp = 1;
+	return c;
+}
+
+/* the current location */
+static struct asym *
+dotsym(void)
+{
+	struct asym *s;
+
+	s = asalloc(sizeof(struct asym));
+	s->name = ".";
+	s->temp = 1;
+	setlab(s);
+	return s;
+}
+
+/*
+ * Section and frag handling.
+ */
+static void
+newfrag(void)
+{
+	struct frag *f;
+
+	f = asalloc(sizeof(struct frag));
+	if (cursec->last)
+		cursec->last->next = f;
+	else
+		cursec->first = f;
+	cursec->last = f;
+	curfrag = f;
+}
+
+static struct asect *
+getsec(char *name, int type, int flags, int entsize)
+{
+	struct asect *s;
+
+	for (s = sects; s; s = s->next)
+		if (strcmp(s->name, name) == 0)
+			return s;
+	s = asalloc(sizeof(struct asect));
+	s->name = asstrdup(name);
+	s->type = type;
+	s->flags = flags;
+	s->entsize = entsize;
+	s->align = 1;
+	s->lfix = &s->fix;
+	*lsect = s;
+	lsect = &s->next;
+	return s;
+}
+
+static void
+setsec(struct asect *s)
+{
+	cursec = s;
+	if (s->last == NULL)
+		newfrag();
+	curfrag = s->last;
+}
+
+/* set the variable part of the current frag and start a new one */
+static struct frag *
+varfrag(int type)
+{
+	struct frag *f = curfrag;
+
+	f->vtype = type;
+	newfrag();
+	return f;
+}
+
+static void
+ob(int c)
+{
+	struct frag *f = curfrag;
+
+	if (cursec->type == SHT_NOBITS)
+		aserr("data in %s", cursec->name);
+	if (f->len == f->alen) {
+		f->alen = f->alen ? f->alen * 2 : 64;
+		if ((f->buf = realloc(f->buf, f->alen)) == NULL)
+			aserr("out of memory");
+	}
+	f->buf[f->len++] = c;
+}
+
+static void
+onum(long long v, int n)
+{
+	while (n-- > 0) {
+		ob((int)(v & 0377));
+		v >>= 8;
+	}
+}
+
+/* output opcode, one to three bytes */
+static void
+oop(int op)
+{
+	if (op > 0xffff)
+		ob(op >> 16);
+	if (op > 0xff)
+		ob((op >> 8) & 0377);
+	ob(op & 0377);
+}
+
+static void
+ospace(long long n, int fill)
+{
+	if (n < 0 || n > 0x7fffffff - curfrag->len)
+		aserr("bad space");
+	if (cursec->type == SHT_NOBITS) {
+		if (fill)
+			aserr("data in %s", cursec->name);
+		curfrag->len += (int)n;
+	} else while (n-- > 0)
+		ob(fill);
+}
+
+/*
+ * Output a field containing e.  If it cannot be computed now it
+ * is resolved after layout.
+ */
+static void
+ofield(struct expr *e, int size, int pcrel, int pcadj, int sign, int call)
+{
+	struct fixup *f;
+
+	if (e->add == NULL && e->sub == NULL && e->mod == 0) {
+		onum(e->val, size);
+		return;
+	}
+	f = asalloc(sizeof(struct fixup));
+	f->frag = curfrag;
+	f->off = curfrag->len;
+	f->size = size;
+	f->pcrel = pcrel;
+	f->pcadj = pcadj;
+	f->sign = sign;
+	f->call = call;
+	f->e = *e;
+	*cursec->lfix = f;
+	cursec->lfix = &f->next;
+	onum(0, size);
+}
+
+/*
+ * Lexical helpers.
+ */
+#define	ISID(c)	(((c) >= 'a' && (c) <= 'z') || ((c) >= 'A' && (c) <= 'Z') || \
+	(c) == '_' || (c) == '.' || (c) == '$' || ((c) >= '0' && (c) <= '9'))
+#define	ISDIG(c) ((c) >= '0' && (c) <= '9')
+
+static char *
+skipws(char *s)
+{
+	while (*s == ' ' || *s == '\t')
+		s++;
+	return s;
+}
+
+static void
+endarg(char *s)
+{
+	if (*skipws(s))
+		aserr("junk '%s'", s);
+}
+
+/*
+ * Split s at commas not within parentheses or strings.
+ */
+static int
+splitargs(char *s, char **av, int max)
+{
+	int n = 0, par = 0;
+
+	s = skipws(s);
+	if (*s == 0)
+		return 0;
+	av[n++] = s;
+	for (; *s; s++) {
+		if (*s == '"') {
+			for (s++; *s && *s != '"'; s++)
+				if (*s == '\\' && s[1])
+					s++;
+			if (*s == 0)
+				aserr("unterminated string");
+		} else if (*s == '(')
+			par++;
+		else if (*s == ')')
+			par--;
+		else if (*s == ',' && par == 0) {
+			*s = 0;
+			if (n == max)
+				aserr("too many operands");
+			av[n++] = s + 1;
+		}
+	}
+	return n;
+}
+
+static void expr(char **cp, struct expr *e);
+
+static void
+addsym(struct expr *e, struct asym *s, int neg)
+{
+	if (neg) {
+		if (e->sub)
+			aserr("bad expression");
+		e->sub = s;
+	} else {
+		if (e->add)
+			aserr("bad expression");
+		e->add = s;
+	}
+}
+
+static void
+term(char **cp, struct expr *e, int neg)
+{
+	struct expr t;
+	struct asym *s;
+	char *p = skipws(*cp), *q, c;
+	long long v;
+
+	if (*p == '-' || *p == '+') {
+		*cp = p + 1;
+		term(cp, e, *p == '-' ? !neg : neg);
+		return;
+	}
+	if (*p == '(') {
+		*cp = p + 1;
+		expr(cp, &t);
+		p = skipws(*cp);
+		if (*p != ')' || t.mod)
+			aserr("bad expression");
+		*cp = p + 1;
+		e->val += neg ? -t.val : t.val;
+		if (t.add)
+			addsym(e, t.add, neg);
+		if (t.sub)
+			addsym(e, t.sub, !neg);
+		return;
+	}
+	if (ISDIG(*p)) {
+		for (q = p; ISDIG(*q); q++)
+			;
+		if ((*q == 'b' || *q == 'f') && !ISID(q[1])) {
+			c = *q;
+			*q = 0;
+			s = numlab(p, c);
+			*q = c;
+			addsym(e, s, neg);
+			*cp = q + 1;
+			return;
+		}
+		v = (long long)strtoull(p, &q, 0);
+		if (ISID(*q))
+			aserr("bad number");
+		e->val += neg ? -v : v;
+		*cp = q;
+		return;
+	}
+	if (*p == '\'' && p[1] && p[1] != '\\') {
+		e->val += neg ? -p[1] : p[1];
+		*cp = p + (p[2] == '\'' ? 3 : 2);
+		return;
+	}
+	if (*p == '.' && !ISID(p[1])) {
+		addsym(e, dotsym(), neg);
+		*cp = p + 1;
+		return;
+	}
+	if (!ISID(*p))
+		aserr("bad expression");
+	for (q = p; ISID(*q); q++)
+		;
+	c = *q;
+	*q = 0;
+	s = symlook(p);
+	*q = c;
+	addsym(e, s, neg);
+	if (*q == '@') {
+		if (neg || e->mod)
+			aserr("bad modifier");
+		if (strncmp(q, "@PLT", 4) == 0 && !ISID(q[4]))
+			e->mod = M_PLT, q += 4;
+		else if (strncmp(q, "@GOTPCREL", 9) == 0 && !ISID(q[9]))
+			e->mod = M_GOTPCREL, q += 9;
+		else
+			aserr("unknown modifier %s", q);
+	}
+	*cp = q;
+}
+
+static void
+expr(char **cp, struct expr *e)
+{
+	char *p;
+
+	memset(e, 0, sizeof(struct expr));
+	term(cp, e, 0);
+	for (;;) {
+		p = skipws(*cp);
+		if (*p != '+' && *p != '-')
+			break;
+		*cp = p + 1;
+		term(cp, e, *p == '-');
+	}
+	if (e->add && e->add == e->sub)
+		e->add = e->sub = NULL;
+}
+
+/* parse a constant expression */
+static long long
+cexpr(char *s)
+{
+	struct expr e;
+
+	expr(&s, &e);
+	endarg(s);
+	if (e.add || e.sub || e.mod)
+		aserr("constant expected");
+	return e.val;
+}
+
+/*
+ * Registers.
+ */
+#define	C_XMM	16
+#define	C_ST	32
+#define	C_RIP	64
+#define	RIP	16
+
+static char *rq[] = { "rax", "rcx", "rdx", "rbx", "rsp", "rbp", "rsi", "rdi",
+	"r8", "r9", "r10", "r11", "r12", "r13", "r14", "r15" };
+static char *rl[] = { "eax", "ecx", "edx", "ebx", "esp", "ebp", "esi", "edi",
+	"r8d", "r9d", "r10d", "r11d", "r12d", "r13d", "r14d", "r15d" };
+static char *rw[] = { "ax", "cx", "dx", "bx", "sp", "bp", "si", "di",
+	"r8w", "r9w", "r10w", "r11w", "r12w", "r13w", "r14w", "r15w" };
+static char *rb[] = { "al", "cl", "dl", "bl", "spl", "bpl", "sil", "dil",
+	"r8b", "r9b", "r10b", "r11b", "r12b", "r13b", "r14b", "r15b" };
+static char *rx[] = { "xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5",
+	"xmm6", "xmm7", "xmm8", "xmm9", "xmm10", "xmm11", "xmm12", "xmm13",
+	"xmm14", "xmm15" };
+
+struct areg {
+	struct areg *next;
+	char *name;
+	int num, cls;
+};
+#define	RHSZ	128
+static struct areg *reghash[RHSZ];
+
+static void
+reginit(char **names, int cls)
+{
+	struct areg *r;
+	int i, h;
+
+	for (i = 0; i < 16; i++) {
+		r = asalloc(sizeof(struct areg));
+		r->name = names[i];
+		r->num = i;
+		r->cls = cls;
+		h = ashash(names[i]) % RHSZ;
+		r->next = reghash[h];
+		reghash[h] = r;
+	}
+}
+
+static struct areg *
+reglook(char *name)
+{
+	struct areg *r;
+
+	for (r = reghash[ashash(name) % RHSZ]; r; r = r->next)
+		if (strcmp(r->name, name) == 0)
+			return r;
+	return NULL;
+}
+
+/*
+ * Operands.
+ */
+struct opnd {
+	int type;
+#define	O_REG	1
+#define	O_IMM	2
+#define	O_MEM	3
+	int reg, cls;
+	int indir;
+	int base, idx, scale;	/* scale is log2 */
+	struct expr e;
+};
+
+/* parse %reg, return number and set class */
+static int
+regnam(char **cp, int *cls)
+{
+	struct areg *r;
+	char *p = *cp + 1, *q, c;
+	int n;
+
+	for (q = p; ISID(*q) && *q != '.' && *q != '$'; q++)
+		;
+	c = *q;
+	*q = 0;
+	if (strcmp(p, "st") == 0) {
+		*q = c;
+		n = 0;
+		if (*q == '(') {
+			if (!ISDIG(q[1]) || q[1] > '7' || q[2] != ')')
+				aserr("bad register");
+			n = q[1] - '0';
+			q += 3;
+		}
+		*cls = C_ST;
+		*cp = q;
+		return n;
+	}
+	if (strcmp(p, "rip") == 0) {
+		*q = c;
+		*cls = C_RIP;
+		*cp = q;
+		return RIP;
+	}
+	if ((r = reglook(p)) == NULL)
+		aserr("unknown register %%%s", p);
+	*q = c;
+	*cls = r->cls;
+	*cp = q;
+	return r->num;
+}
+
+static void
+operand(char *s, struct opnd *o)
+{
+	int cls;
+
+	memset(o, 0, sizeof(struct opnd));
+	o->base = o->idx = -1;
+	s = skipws(s);
+	if (*s == '*')
+		o->indir = 1, s = skipws(s + 1);
+	if (*s == '$') {
+		o->type = O_IMM;
+		s++;
+		expr(&s, &o->e);
+	} else if (*s == '%') {
+		o->type = O_REG;
+		o->reg = regnam(&s, &o->cls);
+		if (*s == ':')
+			aserr("segment override");
+		if (o->cls == C_RIP)
+			aserr("bad use of %%rip");
+	} else {
+		o->type = O_MEM;
+		if (*s != '(')
+			expr(&s, &o->e);
+		s = skipws(s);
+		if (*s == '(') {
+			s = skipws(s + 1);
+			if (*s == '%') {
+				o->base = regnam(&s, &cls);
+				if (cls != 8 && cls != C_RIP)
+					aserr("bad base register");
+				s = skipws(s);
+			}
+			if (*s == ',') {
+				s = skipws(s + 1);
+				if (*s != '%')
+					aserr("bad index");
+				o->idx = regnam(&s, &cls);
+				if (cls != 8 || o->idx == 4 || o->base == RIP)
+					aserr("bad index register");
+				s = skipws(s);
+				if (*s == ',') {
+					s = skipws(s + 1);
+					switch (*s++) {
+					case '1': o->scale = 0; break;
+					case '2': o->scale = 1; break;
+					case '4': o->scale = 2; break;
+					case '8': o->scale = 3; break;
+					default: aserr("bad scale");
+					}
+					s = skipws(s);
+				}
+			}
+			if (*s++ != ')')
+				aserr("missing )");
+		}
+	}
+	endarg(s);
+}
+
+/*
+ * Instruction encoding.
+ */
+#define	REXW	0x8
+#define	REXF	0x40	/* REX needed for the byte register */
+
+/* REX bit needed for %spl, %bpl, %sil and %dil */
+static int
+rexb(struct opnd *o)
+{
+	return o->type == O_REG && o->cls == 1 && o->reg >= 4 && o->reg < 8 ?
+	    REXF : 0;
+}
+
+static int
+fits8(struct expr *e)
+{
+	return e->add == NULL && e->sub == NULL && e->mod == 0 &&
+	    e->val >= -128 && e->val <= 127;
+}
+
+/*
+ * Normalize an immediate to the operand size; as(1) accepts both
+ * signed and unsigned values.
+ */
+static void
+immchk(struct expr *e, int sz)
+{
+	long long v = e->val;
+
+	if (e->mod)
+		aserr("bad immediate");
+	if (e->add || e->sub)
+		return;
+	switch (sz) {
+	case 1:
+		if (v < -128 || v > 255)
+			aserr("immediate out of range");
+		e->val = (signed char)v;
+		break;
+	case 2:
+		if (v < -32768 || v > 65535)
+			aserr("immediate out of range");
+		e->val = (short)v;
+		break;
+	case 4:
+		if (v < -2147483648LL || v > 4294967295LL)
+			aserr("immediate out of range");
+		e->val = (int)v;
+		break;
+	default:
+		if (v < -2147483648LL || v > 2147483647LL)
+			aserr("immediate out of range");
+		break;
+	}
+}
+
+/* output immediate for operand size sz */
+static void
+oimm(struct expr *e, int sz)
+{
+	immchk(e, sz);
+	ofield(e, sz == 8 ? 4 : sz, 0, 0, sz == 8, 0);
+}
+
+static void
+opfx(int sz)
+{
+	if (sz == 2)
+		ob(0x66);
+}
+
+/*
+ * Output [prefix] [rex] opcode modrm [sib] [disp].  reg is the
+ * modrm reg field, either a register or an opcode extension.
+ * isz is the size of any immediate following, needed for %rip.
+ */
+static void
+emodrm(int pfx, int rex, int op, int reg, struct opnd *rm, int isz)
+{
+	struct expr *e = &rm->e, ge;
+	int b, x, mod;
+
+	if (rm->type == O_REG) {
+		b = rm->reg;
+		x = 0;
+	} else if (rm->type == O_MEM) {
+		b = rm->base < 0 || rm->base == RIP ? 0 : rm->base;
+		x = rm->idx < 0 ? 0 : rm->idx;
+	} else
+		aserr("bad operand");
+	if (pfx)
+		ob(pfx);
+	rex |= ((reg & 8) ? 4 : 0) | ((x & 8) ? 2 : 0) | ((b & 8) ? 1 : 0);
+	if (rex)
+		ob(0x40 | (rex & 017));
+	oop(op);
+	reg &= 7;
+	if (rm->type == O_REG) {
+		ob(0300 | reg << 3 | (b & 7));
+		return;
+	}
+	if (e->mod == M_PLT)
+		aserr("bad modifier");
+	if (rm->base == RIP) {
+		ob(reg << 3 | 5);
+		/* mov, test, call, jmp and binops through the GOT */
+		if (e->mod == M_GOTPCREL && (op == 0x8b || op == 0x85 ||
+		    (op & 0307) == 003 ||
+		    (op == 0xff && (reg == 2 || reg == 4)))) {
+			ge = *e;
+			ge.mod = rex ? M_REXGOTPCRELX : M_GOTPCRELX;
+			e = &ge;
+		}
+		ofield(e, 4, 1, 4 + isz, 1, 0);
+		return;
+	}
+	if (e->mod)
+		aserr("bad modifier");
+	if (rm->base < 0) {
+		ob(reg << 3 | 4);
+		if (rm->idx < 0)
+			ob(045);
+		else
+			ob(rm->scale << 6 | (x & 7) << 3 | 5);
+		ofield(e, 4, 0, 0, 1, 0);
+		return;
+	}
+	if (e->add || e->sub)
+		mod = 2;
+	else if (e->val == 0 && (b & 7) != 5)
+		mod = 0;
+	else if (fits8(e))
+		mod = 1;
+	else if (e->val >= -2147483648LL && e->val <= 2147483647LL)
+		mod = 2;
+	else
+		aserr("displacement out of range");
+	if (rm->idx >= 0 || (b & 7) == 4) {
+		ob(mod << 6 | reg << 3 | 4);
+		ob((rm->idx < 0 ? 0 : rm->scale) << 6 |
+		    (rm->idx < 0 ? 4 : x & 7) << 3 | (b & 7));
+	} else
+		ob(mod << 6 | reg << 3 | (b & 7));
+	if (mod == 1)
+		ob((int)e->val);
+	else if (mod == 2)
+		ofield(e, 4, 0, 0, 1, 0);
+}
+
+/* output [prefix] [rex] opcode+reg */
+static void
+oplusr(int pfx, int rex, int op, struct opnd *o)
+{
+	if (pfx)
+		ob(pfx);
+	rex |= (o->reg & 8) ? 1 : 0;
+	if (rex)
+		ob(0x40 | (rex & 017));
+	oop(op + (o->reg & 7));
+}
+
+/*
+ * Instruction table.
+ */
+enum { I_ALU = 1, I_MOV, I_MOVABS, I_TEST, I_UNARY, I_INCDEC, I_SHIFT,
+	I_IMUL, I_LEA, I_MOVX, I_STR, I_PUSH, I_POP, I_CALL, I_JMP, I_NOARG,
+	I_RET, I_PFX, I_SSE, I_SSEMOV, I_SSEI, I_CVTI2F, I_CVTF2I, I_MOVD,
+	I_FMEM, I_FREG, I_FARITH, I_FNSTSW, I_JCC, I_SETCC, I_CMOV };
+
+struct ainsn {
+	struct ainsn *next;
+	char *name;
+	int cls, op, op2, ext;
+};
+
+static struct ainsn ainsns[] = {
+	{ 0, "add", I_ALU, 0 }, { 0, "or", I_ALU, 1 }, { 0, "adc", I_ALU, 2 },
+	{ 0, "sbb", I_ALU, 3 }, { 0, "and", I_ALU, 4 }, { 0, "sub", I_ALU, 5 },
+	{ 0, "xor", I_ALU, 6 }, { 0, "cmp", I_ALU, 7 },
+	{ 0, "mov", I_MOV }, { 0, "movabs", I_MOVABS }, { 0, "test", I_TEST },
+	{ 0, "not", I_UNARY, 2 }, { 0, "neg", I_UNARY, 3 },
+	{ 0, "mul", I_UNARY, 4 }, { 0, "div", I_UNARY, 6 },
+	{ 0, "idiv", I_UNARY, 7 }, { 0, "imul", I_IMUL },
+	{ 0, "inc", I_INCDEC, 0 }, { 0, "dec", I_INCDEC, 1 },
+	{ 0, "rol", I_SHIFT, 0 }, { 0, "ror", I_SHIFT, 1 },
+	{ 0, "rcl", I_SHIFT, 2 }, { 0, "rcr", I_SHIFT, 3 },
+	{ 0, "shl", I_SHIFT, 4 }, { 0, "sal", I_SHIFT, 4 },
+	{ 0, "shr", I_SHIFT, 5 }, { 0, "sar", I_SHIFT, 7 },
+	{ 0, "lea", I_LEA },
+	{ 0, "movzb", I_MOVX, 0x0fb6, 0, 1 },
+	{ 0, "movzw", I_MOVX, 0x0fb7, 0, 2 },
+	{ 0, "movsb", I_MOVX, 0x0fbe, 0xa4, 1 },
+	{ 0, "movsw", I_MOVX, 0x0fbf, 0xa5, 2 },
+	{ 0, "movsl", I_MOVX, 0x63, 0xa5, 4 },
+	{ 0, "movsq", I_STR, 0xa5, 0, 8 },
+	{ 0, "stosb", I_STR, 0xaa, 0, 1 }, { 0, "stosw", I_STR, 0xab, 0, 2 },
+	{ 0, "stosl", I_STR, 0xab, 0, 4 }, { 0, "stosq", I_STR, 0xab, 0, 8 },
+	{ 0, "push", I_PUSH }, { 0, "pop", I_POP },
+	{ 0, "call", I_CALL }, { 0, "jmp", I_JMP }, { 0, "ret", I_RET },
+	{ 0, "leave", I_NOARG, 0xc9 }, { 0, "cltd", I_NOARG, 0x99 },
+	{ 0, "cqto", I_NOARG, 0x4899 }, { 0, "cltq", I_NOARG, 0x4898 },
+	{ 0, "cwtl", I_NOARG, 0x98 }, { 0, "cbtw", I_NOARG, 0x6698 },
+	{ 0, "cwtd", I_NOARG, 0x6699 }, { 0, "nop", I_NOARG, 0x90 },
+	{ 0, "hlt", I_NOARG, 0xf4 }, { 0, "sahf", I_NOARG, 0x9e },
+	{ 0, "lahf", I_NOARG, 0x9f }, { 0, "cld", I_NOARG, 0xfc },
+	{ 0, "std", I_NOARG, 0xfd }, { 0, "ud2", I_NOARG, 0x0f0b },
+	{ 0, "pause", I_NOARG, 0xf390 }, { 0, "int3", I_NOARG, 0xcc },
+	{ 0, "rdtsc", I_NOARG, 0x0f31 }, { 0, "cpuid", I_NOARG, 0x0fa2 },
+	{ 0, "mfence", I_NOARG, 0x0faef0 }, { 0, "lfence", I_NOARG, 0x0faee8 },
+	{ 0, "sfence", I_NOARG, 0x0faef8 },
+	{ 0, "fldz", I_NOARG, 0xd9ee }, { 0, "fld1", I_NOARG, 0xd9e8 },
+	{ 0, "fchs", I_NOARG, 0xd9e0 }, { 0, "fabs", I_NOARG, 0xd9e1 },
+	{ 0, "fsqrt", I_NOARG, 0xd9fa }, { 0, "frndint", I_NOARG, 0xd9fc },
+	{ 0, "fucompp", I_NOARG, 0xdae9 }, { 0, "fwait", I_NOARG, 0x9b },
+	{ 0, "fninit", I_NOARG, 0xdbe3 },
+	{ 0, "rep", I_PFX, 0xf3 }, { 0, "repe", I_PFX, 0xf3 },
+	{ 0, "repz", I_PFX, 0xf3 }, { 0, "repne", I_PFX, 0xf2 },
+	{ 0, "repnz", I_PFX, 0xf2 }, { 0, "lock", I_PFX, 0xf0 },
+
+	/* SSE; ext is the mandatory prefix */
+	{ 0, "addss", I_SSE, 0x0f58, 0, 0xf3 },
+	{ 0, "addsd", I_SSE, 0x0f58, 0, 0xf2 },
+	{ 0, "addps", I_SSE, 0x0f58, 0, 0 },
+	{ 0, "addpd", I_SSE, 0x0f58, 0, 0x66 },
+	{ 0, "subss", I_SSE, 0x0f5c, 0, 0xf3 },
+	{ 0, "subsd", I_SSE, 0x0f5c, 0, 0xf2 },
+	{ 0, "subps", I_SSE, 0x0f5c, 0, 0 },
+	{ 0, "subpd", I_SSE, 0x0f5c, 0, 0x66 },
+	{ 0, "mulss", I_SSE, 0x0f59, 0, 0xf3 },
+	{ 0, "mulsd", I_SSE, 0x0f59, 0, 0xf2 },
+	{ 0, "mulps", I_SSE, 0x0f59, 0, 0 },
+	{ 0, "mulpd", I_SSE, 0x0f59, 0, 0x66 },
+	{ 0, "divss", I_SSE, 0x0f5e, 0, 0xf3 },
+	{ 0, "divsd", I_SSE, 0x0f5e, 0, 0xf2 },
+	{ 0, "divps", I_SSE, 0x0f5e, 0, 0 },
+	{ 0, "divpd", I_SSE, 0x0f5e, 0, 0x66 },
+	{ 0, "minss", I_SSE, 0x0f5d, 0, 0xf3 },
+	{ 0, "minsd", I_SSE, 0x0f5d, 0, 0xf2 },
+	{ 0, "maxss", I_SSE, 0x0f5f, 0, 0xf3 },
+	{ 0, "maxsd", I_SSE, 0x0f5f, 0, 0xf2 },
+	{ 0, "sqrtss", I_SSE, 0x0f51, 0, 0xf3 },
+	{ 0, "sqrtsd", I_SSE, 0x0f51, 0, 0xf2 },
+	{ 0, "ucomiss", I_SSE, 0x0f2e, 0, 0 },
+	{ 0, "ucomisd", I_SSE, 0x0f2e, 0, 0x66 },
+	{ 0, "comiss", I_SSE, 0x0f2f, 0, 0 },
+	{ 0, "comisd", I_SSE, 0x0f2f, 0, 0x66 },
+	{ 0, "cvtss2sd", I_SSE, 0x0f5a, 0, 0xf3 },
+	{ 0, "cvtsd2ss", I_SSE, 0x0f5a, 0, 0xf2 },
+	{ 0, "andps", I_SSE, 0x0f54, 0, 0 },
+	{ 0, "andpd", I_SSE, 0x0f54, 0, 0x66 },
+	{ 0, "andnps", I_SSE, 0x0f55, 0, 0 },
+	{ 0, "andnpd", I_SSE, 0x0f55, 0, 0x66 },
+	{ 0, "orps", I_SSE, 0x0f56, 0, 0 },
+	{ 0, "orpd", I_SSE, 0x0f56, 0, 0x66 },
+	{ 0, "xorps", I_SSE, 0x0f57, 0, 0 },
+	{ 0, "xorpd", I_SSE, 0x0f57, 0, 0x66 },
+	{ 0, "unpcklps", I_SSE, 0x0f14, 0, 0 },
+	{ 0, "unpcklpd", I_SSE, 0x0f14, 0, 0x66 },
+	{ 0, "unpckhps", I_SSE, 0x0f15, 0, 0 },
+	{ 0, "unpckhpd", I_SSE, 0x0f15, 0, 0x66 },
+	{ 0, "paddd", I_SSE, 0x0ffe, 0, 0x66 },
+	{ 0, "paddq", I_SSE, 0x0fd4, 0, 0x66 },
+	{ 0, "psubd", I_SSE, 0x0ffa, 0, 0x66 },
+	{ 0, "psubq", I_SSE, 0x0ffb, 0, 0x66 },
+	{ 0, "pand", I_SSE, 0x0fdb, 0, 0x66 },
+	{ 0, "pandn", I_SSE, 0x0fdf, 0, 0x66 },
+	{ 0, "por", I_SSE, 0x0feb, 0, 0x66 },
+	{ 0, "pxor", I_SSE, 0x0fef, 0, 0x66 },
+	{ 0, "movss", I_SSEMOV, 0x0f10, 0x0f11, 0xf3 },
+	{ 0, "movsd", I_SSEMOV, 0x0f10, 0x0f11, 0xf2 },
+	{ 0, "movaps", I_SSEMOV, 0x0f28, 0x0f29, 0 },
+	{ 0, "movapd", I_SSEMOV, 0x0f28, 0x0f29, 0x66 },
+	{ 0, "movups", I_SSEMOV, 0x0f10, 0x0f11, 0 },
+	{ 0, "movupd", I_SSEMOV, 0x0f10, 0x0f11, 0x66 },
+	{ 0, "movdqa", I_SSEMOV, 0x0f6f, 0x0f7f, 0x66 },
+	{ 0, "movdqu", I_SSEMOV, 0x0f6f, 0x0f7f, 0xf3 },
+	{ 0, "pshufd", I_SSEI, 0x0f70, 0, 0x66 },
+	{ 0, "shufps", I_SSEI, 0x0fc6, 0, 0 },
+	{ 0, "shufpd", I_SSEI, 0x0fc6, 0, 0x66 },
+	{ 0, "cvtsi2ss", I_CVTI2F, 0x0f2a, 0, 0xf3 },
+	{ 0, "cvtsi2sd", I_CVTI2F, 0x0f2a, 0, 0xf2 },
+	{ 0, "cvttss2si", I_CVTF2I, 0x0f2c, 0, 0xf3 },
+	{ 0, "cvttsd2si", I_CVTF2I, 0x0f2c, 0, 0xf2 },
+	{ 0, "cvtss2si", I_CVTF2I, 0x0f2d, 0, 0xf3 },
+	{ 0, "cvtsd2si", I_CVTF2I, 0x0f2d, 0, 0xf2 },
+	{ 0, "movd", I_MOVD },
+
+	/* x87; memory operand with opcode and /digit */
+	{ 0, "flds", I_FMEM, 0xd9, 0 }, { 0, "fldl", I_FMEM, 0xdd, 0 },
+	{ 0, "fldt", I_FMEM, 0xdb, 5 }, { 0, "fsts", I_FMEM, 0xd9, 2 },
+	{ 0, "fstl", I_FMEM, 0xdd, 2 }, { 0, "fstps", I_FMEM, 0xd9, 3 },
+	{ 0, "fstpl", I_FMEM, 0xdd, 3 }, { 0, "fstpt", I_FMEM, 0xdb, 7 },
+	{ 0, "filds", I_FMEM, 0xdf, 0 }, { 0, "fildl", I_FMEM, 0xdb, 0 },
+	{ 0, "fildll", I_FMEM, 0xdf, 5 }, { 0, "fildq", I_FMEM, 0xdf, 5 },
+	{ 0, "fists", I_FMEM, 0xdf, 2 }, { 0, "fistl", I_FMEM, 0xdb, 2 },
+	{ 0, "fistps", I_FMEM, 0xdf, 3 }, { 0, "fistpl", I_FMEM, 0xdb, 3 },
+	{ 0, "fistpll", I_FMEM, 0xdf, 7 }, { 0, "fistpq", I_FMEM, 0xdf, 7 },
+	{ 0, "fisttps", I_FMEM, 0xdf, 1 }, { 0, "fisttpl", I_FMEM, 0xdb, 1 },
+	{ 0, "fisttpll", I_FMEM, 0xdd, 1 }, { 0, "fisttpq", I_FMEM, 0xdd, 1 },
+	{ 0, "fnstcw", I_FMEM, 0xd9, 7 }, { 0, "fldcw", I_FMEM, 0xd9, 5 },
+	{ 0, "fadds", I_FMEM, 0xd8, 0 }, { 0, "faddl", I_FMEM, 0xdc, 0 },
+	{ 0, "fmuls", I_FMEM, 0xd8, 1 }, { 0, "fmull", I_FMEM, 0xdc, 1 },
+	{ 0, "fcoms", I_FMEM, 0xd8, 2 }, { 0, "fcoml", I_FMEM, 0xdc, 2 },
+	{ 0, "fcomps", I_FMEM, 0xd8, 3 }, { 0, "fcompl", I_FMEM, 0xdc, 3 },
+	{ 0, "fsubs", I_FMEM, 0xd8, 4 }, { 0, "fsubl", I_FMEM, 0xdc, 4 },
+	{ 0, "fsubrs", I_FMEM, 0xd8, 5 }, { 0, "fsubrl", I_FMEM, 0xdc, 5 },
+	{ 0, "fdivs", I_FMEM, 0xd8, 6 }, { 0, "fdivl", I_FMEM, 0xdc, 6 },
+	{ 0, "fdivrs", I_FMEM, 0xd8, 7 }, { 0, "fdivrl", I_FMEM, 0xdc, 7 },
+	/* %st(i) operand; op2 is the base, ext the default index */
+	{ 0, "fld", I_FREG, 0xd9, 0xc0, -1 },
+	{ 0, "fst", I_FREG, 0xdd, 0xd0, -1 },
+	{ 0, "fstp", I_FREG, 0xdd, 0xd8, -1 },
+	{ 0, "fxch", I_FREG, 0xd9, 0xc8, 1 },
+	{ 0, "ffree", I_FREG, 0xdd, 0xc0, -1 },
+	{ 0, "fucom", I_FREG, 0xdd, 0xe0, 1 },
+	{ 0, "fucomp", I_FREG, 0xdd, 0xe8, 1 },
+	{ 0, "fucomi", I_FREG, 0xdb, 0xe8, 1 },
+	{ 0, "fucomip", I_FREG, 0xdf, 0xe8, 1 },
+	{ 0, "fcomi", I_FREG, 0xdb, 0xf0, 1 },
+	{ 0, "fcomip", I_FREG, 0xdf, 0xf0, 1 },
+	/* register arithmetic; op is the /digit, op2 set if popping */
+	{ 0, "fadd", I_FARITH, 0 }, { 0, "faddp", I_FARITH, 0, 1 },
+	{ 0, "fmul", I_FARITH, 1 }, { 0, "fmulp", I_FARITH, 1, 1 },
+	{ 0, "fsub", I_FARITH, 4 }, { 0, "fsubp", I_FARITH, 4, 1 },
+	{ 0, "fsubr", I_FARITH, 5 }, { 0, "fsubrp", I_FARITH, 5, 1 },
+	{ 0, "fdiv", I_FARITH, 6 }, { 0, "fdivp", I_FARITH, 6, 1 },
+	{ 0, "fdivr", I_FARITH, 7 }, { 0, "fdivrp", I_FARITH, 7, 1 },
+	{ 0, "fnstsw", I_FNSTSW },
+	{ 0, NULL },
+};
+
+#define	IHSZ	256
+static struct ainsn *insnhash[IHSZ];
+
+/* condition codes, in encoding order */
+static char *ccnames[] = {
+	"o", "no", "b", "ae", "e", "ne", "be", "a",
+	"s", "ns", "p", "np", "l", "ge", "le", "g",
+	"c", "nae", "nb", "nc", "z", "nz", "na", "nbe",
+	"pe", "po", "nge", "nl", "ng", "nle", NULL
+};
+static int ccalias[] = { 2, 2, 3, 3, 4, 5, 6, 7, 10, 11, 12, 13, 14, 15 };
+
+static int
+ccnum(char *s)
+{
+	int i;
+
+	for (i = 0; ccnames[i]; i++)
+		if (strcmp(ccnames[i], s) == 0)
+			return i < 16 ? i : ccalias[i - 16];
+	return -1;
+}
+
+static struct ainsn *
+insnlook(char *name)
+{
+	struct ainsn *ip;
+
+	for (ip = insnhash[ashash(name) % IHSZ]; ip; ip = ip->next)
+		if (strcmp(ip->name, name) == 0)
+			return ip;
+	return NULL;
+}
+
+/*
+ * Find instruction and operand size from the mnemonic.
+ */
+static struct ainsn *
+mnemonic(char *name, int *sz, int *cc)
+{
+	static struct ainsn jcc = { 0, "j", I_JCC }, setcc = { 0, "set", I_SETCC },
+	    cmov = { 0, "cmov", I_CMOV };
+	struct ainsn *ip;
+	char *e;
+	int n, c;
+
+	*sz = *cc = 0;
+	if ((ip = insnlook(name)) != NULL)
+		return ip;
+	if (name[0] == 'j' && (*cc = ccnum(name + 1)) >= 0)
+		return &jcc;
+	if (strncmp(name, "set", 3) == 0 && (*cc = ccnum(name + 3)) >= 0)
+		return &setcc;
+	if (strncmp(name, "cmov", 4) == 0 && (*cc = ccnum(name + 4)) >= 0)
+		return &cmov;
+	n = strlen(name);
+	if (n < 2)
+		return NULL;
+	e = &name[n-1];
+	switch (*e) {
+	case 'b': *sz = 1; break;
+	case 'w': *sz = 2; break;
+	case 'l': *sz = 4; break;
+	case 'q': *sz = 8; break;
+	default: return NULL;
+	}
+	c = *e;
+	*e = 0;
+	if ((ip = insnlook(name)) == NULL &&
+	    strncmp(name, "cmov", 4) == 0 && (*cc = ccnum(name + 4)) >= 0)
+		ip = &cmov;
+	*e = c;
+	if (ip == NULL)
+		return NULL;
+	switch (ip->cls) {
+	case I_PFX: case I_SSE: case I_SSEMOV: case I_SSEI: case I_MOVD:
+	case I_FMEM: case I_FREG: case I_FARITH: case I_FNSTSW:
+		return NULL;
+	}
+	return ip;
+}
+
+static int
+opsize(int sz, struct opnd *o, int n)
+{
+	int i;
+
+	if (sz)
+		return sz;
+	for (i = n-1; i >= 0; i--)
+		if (o[i].type == O_REG && o[i].cls <= 8)
+			return o[i].cls;
+	aserr("operand size unknown");
+	return 0;
+}
+
+static int
+isopreg(struct opnd *o, int cls)
+{
+	return o->type == O_REG && o->cls == cls;
+}
+
+static void
+szchk(struct opnd *o, int sz)
+{
+	if (o->type == O_REG && o->cls != sz)
+		aserr("operand size mismatch");
+}
+
+/* branch target */
+static void
+target(struct opnd *o, struct expr *e)
+{
+	if (o->type != O_MEM || o->base >= 0 || o->idx >= 0 || o->indir ||
+	    o->e.add == NULL || o->e.sub || o->e.mod == M_GOTPCREL)
+		aserr("bad branch target");
+	*e = o->e;
+}
+
+static void insn(char *s);
+
+/*
+ * Encode the instruction ip with operands o.
+ */
+static void
+encode(struct ainsn *ip, int sz, int cc, struct opnd *o, int n, char *rest)
+{
+	struct opnd *s = &o[0], *d = &o[n ? n-1 : 0];
+	struct frag *f;
+	int w, i, op;
+
+	if (n > 0 && o[0].indir && ip->cls != I_CALL && ip->cls != I_JMP)
+		aserr("bad indirection");
+
+	switch (ip->cls) {
+	case I_ALU:
+		if (n != 2)
+			goto bad;
+		sz = opsize(sz, o, n);
+		w = sz == 8 ? REXW : 0;
+		if (s->type == O_IMM) {
+			immchk(&s->e, sz);
+			szchk(d, sz);
+			if (sz == 1 && isopreg(d, 1) && d->reg == 0) {
+				ob(04 + 8 * ip->op);
+				oimm(&s->e, 1);
+			} else if (sz == 1) {
+				emodrm(0, rexb(d), 0x80, ip->op, d, 1);
+				oimm(&s->e, 1);
+			} else if (fits8(&s->e)) {
+				emodrm(sz == 2 ? 0x66 : 0, w, 0x83, ip->op, d, 1);
+				oimm(&s->e, 1);
+			} else if (d->type == O_REG && d->reg == 0) {
+				opfx(sz);
+				if (w)
+					ob(0x40 | w);
+				ob(05 + 8 * ip->op);
+				oimm(&s->e, sz);
+			} else {
+				emodrm(sz == 2 ? 0x66 : 0, w, 0x81, ip->op, d,
+				    sz == 2 ? 2 : 4);
+				oimm(&s->e, sz);
+			}
+		} else if (s->type == O_REG) {
+			szchk(s, sz);
+			szchk(d, sz);
+			emodrm(sz == 2 ? 0x66 : 0, w | rexb(s) | rexb(d),
+			    (sz == 1 ? 0 : 1) + 8 * ip->op, s->reg, d, 0);
+		} else if (d->type == O_REG) {
+			szchk(d, sz);
+			emodrm(sz == 2 ? 0x66 : 0, w | rexb(d),
+			    (sz == 1 ? 2 : 3) + 8 * ip->op, d->reg, s, 0);
+		} else
+			goto bad;
+		break;
+
+	case I_MOV:
+		if (n != 2)
+			goto bad;
+		if (isopreg(s, C_XMM) || isopreg(d, C_XMM)) {
+			/* movq to/from xmm registers */
+			if (sz != 8 && sz != 0)
+				goto bad;
+			if (isopreg(d, C_XMM) && (isopreg(s, C_XMM) ||
+			    s->type == O_MEM))
+				emodrm(0xf3, 0, 0x0f7e, d->reg, s, 0);
+			else if (isopreg(s, C_XMM) && d->type == O_MEM)
+				emodrm(0x66, 0, 0x0fd6, s->reg, d, 0);
+			else if (isopreg(d, C_XMM) && isopreg(s, 8))
+				emodrm(0x66, REXW, 0x0f6e, d->reg, s, 0);
+			else if (isopreg(s, C_XMM) && isopreg(d, 8))
+				emodrm(0x66, REXW, 0x0f7e, s->reg, d, 0);
+			else
+				goto bad;
+			break;
+		}
+		sz = opsize(sz, o, n);
+		w = sz == 8 ? REXW : 0;
+		szchk(s, sz);
+		szchk(d, sz);
+		if (s->type == O_IMM) {
+			if (d->type == O_REG && sz == 8) {
+				if (s->e.add || s->e.sub || (s->e.val >=
+				    -2147483648LL && s->e.val <= 2147483647LL)) {
+					emodrm(0, w, 0xc7, 0, d, 4);
+					oimm(&s->e, 8);
+				} else {
+					oplusr(0, w, 0xb8, d);
+					ofield(&s->e, 8, 0, 0, 0, 0);
+				}
+			} else if (d->type == O_REG) {
+				oplusr(sz == 2 ? 0x66 : 0, rexb(d),
+				    sz == 1 ? 0xb0 : 0xb8, d);
+				oimm(&s->e, sz);
+			} else {
+				emodrm(sz == 2 ? 0x66 : 0, w, sz == 1 ? 0xc6 :
+				    0xc7, 0, d, sz == 8 ? 4 : sz);
+				oimm(&s->e, sz);
+			}
+		} else if (s->type == O_REG) {
+			emodrm(sz == 2 ? 0x66 : 0, w | rexb(s) | rexb(d),
+			    sz == 1 ? 0x88 : 0x89, s->reg, d, 0);
+		} else if (d->type == O_REG) {
+			emodrm(sz == 2 ? 0x66 : 0, w | rexb(d),
+			    sz == 1 ? 0x8a : 0x8b, d->reg, s, 0);
+		} else
+			goto bad;
+		break;
+
+	case I_MOVABS:
+		if (n != 2 || s->type != O_IMM || !isopreg(d, 8) ||
+		    (sz && sz != 8) || s->e.mod)
+			goto bad;
+		oplusr(0, REXW, 0xb8, d);
+		ofield(&s->e, 8, 0, 0, 0, 0);
+		break;
+
+	case I_TEST:
+		if (n != 2)
+			goto bad;
+		sz = opsize(sz, o, n);
+		w = sz == 8 ? REXW : 0;
+		szchk(s, sz);
+		szchk(d, sz);
+		if (s->type == O_IMM) {
+			if (d->type == O_REG && d->reg == 0) {
+				opfx(sz);
+				if (w)
+					ob(0x40 | w);
+				ob(sz == 1 ? 0xa8 : 0xa9);
+			} else
+				emodrm(sz == 2 ? 0x66 : 0, w | rexb(d),
+				    sz == 1 ? 0xf6 : 0xf7, 0, d,
+				    sz == 8 ? 4 : sz);
+			oimm(&s->e, sz);
+		} else if (s->type == O_REG) {
+			emodrm(sz == 2 ? 0x66 : 0, w | rexb(s) | rexb(d),
+			    sz == 1 ? 0x84 : 0x85, s->reg, d, 0);
+		} else if (d->type == O_REG) {
+			emodrm(sz == 2 ? 0x66 : 0, w | rexb(d),
+			    sz == 1 ? 0x84 : 0x85, d->reg, s, 0);
+		} else
+			goto bad;
+		break;
+
+	case I_UNARY:
+	case I_INCDEC:
+		if (n != 1 || s->type == O_IMM)
+			goto bad;
+		sz = opsize(sz, o, n);
+		szchk(s, sz);
+		op = ip->cls == I_UNARY ? 0xf6 : 0xfe;
+		emodrm(sz == 2 ? 0x66 : 0, (sz == 8 ? REXW : 0) | rexb(s),
+		    sz == 1 ? op : op + 1, ip->op, s, 0);
+		break;
+
+	case I_SHIFT:
+		if (n < 1 || n > 2 || d->type == O_IMM)
+			goto bad;
+		sz = opsize(sz, d, 1);
+		szchk(d, sz);
+		w = (sz == 8 ? REXW : 0) | rexb(d);
+		i = sz == 2 ? 0x66 : 0;
+		if (n == 1 || (s->type == O_IMM && s->e.add == NULL &&
+		    s->e.sub == NULL && s->e.val == 1)) {
+			emodrm(i, w, sz == 1 ? 0xd0 : 0xd1, ip->op, d, 0);
+		} else if (isopreg(s, 1) && s->reg == 1) {
+			emodrm(i, w, sz == 1 ? 0xd2 : 0xd3, ip->op, d, 0);
+		} else if (s->type == O_IMM) {
+			emodrm(i, w, sz == 1 ? 0xc0 : 0xc1, ip->op, d, 1);
+			oimm(&s->e, 1);
+		} else
+			goto bad;
+		break;
+
+	case I_IMUL:
+		if (n == 1) {
+			if (s->type == O_IMM)
+				goto bad;
+			sz = opsize(sz, o, n);
+			szchk(s, sz);
+			emodrm(sz == 2 ? 0x66 : 0, (sz == 8 ? REXW : 0) |
+			    rexb(s), sz == 1 ? 0xf6 : 0xf7, 5, s, 0);
+			break;
+		}
+		if (n > 3 || d->type != O_REG)
+			goto bad;
+		sz = opsize(sz, o, n);
+		if (sz == 1)
+			goto bad;
+		szchk(d, sz);
+		w = sz == 8 ? REXW : 0;
+		i = sz == 2 ? 0x66 : 0;
+		if (s->type == O_IMM) {
+			struct opnd *r = n == 3 ? &o[1] : d;
+
+			szchk(r, sz);
+			immchk(&s->e, sz);
+			if (fits8(&s->e)) {
+				emodrm(i, w, 0x6b, d->reg, r, 1);
+				oimm(&s->e, 1);
+			} else {
+				emodrm(i, w, 0x69, d->reg, r, sz == 2 ? 2 : 4);
+				oimm(&s->e, sz);
+			}
+		} else if (n == 2) {
+			szchk(s, sz);
+			emodrm(i, w, 0x0faf, d->reg, s, 0);
+		} else
+			goto bad;
+		break;
+
+	case I_LEA:
+		if (n != 2 || s->type != O_MEM || d->type != O_REG ||
+		    d->cls == 1)
+			goto bad;
+		sz = opsize(sz, o, n);
+		szchk(d, sz);
+		emodrm(sz == 2 ? 0x66 : 0, sz == 8 ? REXW : 0, 0x8d,
+		    d->reg, s, 0);
+		break;
+
+	case I_MOVX:
+		if (n == 0 && sz == 0) {
+			/* string move */
+			opfx(ip->ext);
+			ob(ip->op2);
+			break;
+		}
+		if (n != 2 || d->type != O_REG || s->type == O_IMM)
+			goto bad;
+		sz = opsize(sz, d, 1);
+		szchk(d, sz);
+		szchk(s, ip->ext);
+		if (sz <= ip->ext)
+			goto bad;
+		emodrm(sz == 2 ? 0x66 : 0, (sz == 8 ? REXW : 0) | rexb(s),
+		    ip->op, d->reg, s, 0);
+		break;
+
+	case I_STR:
+		if (n != 0 || sz)
+			goto bad;
+		opfx(ip->ext);
+		if (ip->ext == 8)
+			ob(0x40 | REXW);
+		ob(ip->op);
+		break;
+
+	case I_PUSH:
+	case I_POP:
+		if (n != 1 || (sz && sz != 8))
+			goto bad;
+		if (isopreg(s, 8)) {
+			oplusr(0, 0, ip->cls == I_PUSH ? 0x50 : 0x58, s);
+		} else if (s->type == O_MEM) {
+			if (ip->cls == I_PUSH)
+				emodrm(0, 0, 0xff, 6, s, 0);
+			else
+				emodrm(0, 0, 0x8f, 0, s, 0);
+		} else if (s->type == O_IMM && ip->cls == I_PUSH) {
+			immchk(&s->e, 8);
+			if (fits8(&s->e)) {
+				ob(0x6a);
+				oimm(&s->e, 1);
+			} else {
+				ob(0x68);
+				oimm(&s->e, 8);
+			}
+		} else
+			goto bad;
+		break;
+
+	case I_CALL:
+	case I_JMP:
+		if (n != 1 || (sz && sz != 8))
+			goto bad;
+		if (s->indir) {
+			if (s->type == O_REG && s->cls != 8)
+				goto bad;
+			emodrm(0, 0, 0xff, ip->cls == I_CALL ? 2 : 4, s, 0);
+		} else if (ip->cls == I_CALL) {
+			ob(0xe8);
+			target(s, &s->e);
+			ofield(&s->e, 4, 1, 4, 1, 1);
+		} else {
+			f = varfrag(V_JMP);
+			target(s, &f->vexp);
+		}
+		break;
+
+	case I_JCC:
+		if (n != 1)
+			goto bad;
+		f = varfrag(V_JCC);
+		f->vcc = cc;
+		target(s, &f->vexp);
+		break;
+
+	case I_SETCC:
+		if (n != 1 || (sz && sz != 1) || s->type == O_IMM)
+			goto bad;
+		szchk(s, 1);
+		emodrm(0, rexb(s), 0x0f90 + cc, 0, s, 0);
+		break;
+
+	case I_CMOV:
+		if (n != 2 || d->type != O_REG || s->type == O_IMM)
+			goto bad;
+		sz = opsize(sz, o, n);
+		if (sz == 1)
+			goto bad;
+		szchk(s, sz);
+		szchk(d, sz);
+		emodrm(sz == 2 ? 0x66 : 0, sz == 8 ? REXW : 0, 0x0f40 + cc,
+		    d->reg, s, 0);
+		break;
+
+	case I_NOARG:
+		if (n != 0)
+			goto bad;
+		oop(ip->op);
+		break;
+
+	case I_RET:
+		if (n == 0)
+			ob(0xc3);
+		else if (n == 1 && s->type == O_IMM) {
+			ob(0xc2);
+			oimm(&s->e, 2);
+		} else
+			goto bad;
+		break;
+
+	case I_PFX:
+		ob(ip->op);
+		insn(rest);
+		break;
+
+	case I_SSE:
+		if (n != 2 || !isopreg(d, C_XMM) ||
+		    (s->type != O_MEM && !isopreg(s, C_XMM)))
+			goto bad;
+		emodrm(ip->ext, 0, ip->op, d->reg, s, 0);
+		break;
+
+	case I_SSEMOV:
+		if (n != 2)
+			goto bad;
+		if (isopreg(d, C_XMM) && (isopreg(s, C_XMM) || s->type == O_MEM))
+			emodrm(ip->ext, 0, ip->op, d->reg, s, 0);
+		else if (isopreg(s, C_XMM) && d->type == O_MEM)
+			emodrm(ip->ext, 0, ip->op2, s->reg, d, 0);
+		else
+			goto bad;
+		break;
+
+	case I_SSEI:
+		if (n != 3 || s->type != O_IMM || !isopreg(d, C_XMM) ||
+		    (o[1].type != O_MEM && !isopreg(&o[1], C_XMM)))
+			goto bad;
+		emodrm(ip->ext, 0, ip->op, d->reg, &o[1], 1);
+		oimm(&s->e, 1);
+		break;
+
+	case I_CVTI2F:
+		if (n != 2 || !isopreg(d, C_XMM) || s->type == O_IMM)
+			goto bad;
+		if (s->type == O_REG) {
+			if (s->cls != 4 && s->cls != 8)
+				goto bad;
+			if (sz == 0)
+				sz = s->cls;
+			szchk(s, sz);
+		} else if (sz == 0)
+			sz = 4;
+		if (sz != 4 && sz != 8)
+			goto bad;
+		emodrm(ip->ext, sz == 8 ? REXW : 0, ip->op, d->reg, s, 0);
+		break;
+
+	case I_CVTF2I:
+		if (n != 2 || d->type != O_REG || (d->cls != 4 && d->cls != 8) ||
+		    (s->type != O_MEM && !isopreg(s, C_XMM)))
+			goto bad;
+		if (sz == 0)
+			sz = d->cls;
+		szchk(d, sz);
+		emodrm(ip->ext, sz == 8 ? REXW : 0, ip->op, d->reg, s, 0);
+		break;
+
+	case I_MOVD:
+		if (n != 2)
+			goto bad;
+		/* movd with a 64-bit register is movq, as gas has it */
+		if (isopreg(d, C_XMM) && (s->type == O_MEM || isopreg(s, 4)))
+			emodrm(0x66, 0, 0x0f6e, d->reg, s, 0);
+		else if (isopreg(d, C_XMM) && isopreg(s, 8))
+			emodrm(0x66, REXW, 0x0f6e, d->reg, s, 0);
+		else if (isopreg(s, C_XMM) && (d->type == O_MEM || isopreg(d, 4)))
+			emodrm(0x66, 0, 0x0f7e, s->reg, d, 0);
+		else if (isopreg(s, C_XMM) && isopreg(d, 8))
+			emodrm(0x66, REXW, 0x0f7e, s->reg, d, 0);
+		else
+			goto bad;
+		break;
+
+	case I_FMEM:
+		if (n != 1 || s->type != O_MEM)
+			goto bad;
+		emodrm(0, 0, ip->op, ip->op2, s, 0);
+		break;
+
+	case I_FREG:
+		if (n == 0 && ip->ext >= 0)
+			i = ip->ext;
+		else if (n == 1 && isopreg(s, C_ST))
+			i = s->reg;
+		else if (n == 2 && isopreg(s, C_ST) && isopreg(d, C_ST) &&
+		    d->reg == 0)
+			i = s->reg;
+		else
+			goto bad;
+		ob(ip->op);
+		ob(ip->op2 + i);
+		break;
+
+	case I_FARITH:
+		op = 0300 + 8 * ip->op;
+		if (n == 0 && ip->op2) {
+			ob(0xde);
+			ob(op + 1);
+		} else if (n == 1 && isopreg(s, C_ST)) {
+			ob(ip->op2 ? 0xde : 0xd8);
+			ob(op + s->reg);
+		} else if (n == 2 && isopreg(s, C_ST) && isopreg(d, C_ST) &&
+		    d->reg == 0 && !ip->op2) {
+			ob(0xd8);
+			ob(op + s->reg);
+		} else if (n == 2 && isopreg(s, C_ST) && isopreg(d, C_ST) &&
+		    s->reg == 0) {
+			ob(ip->op2 ? 0xde : 0xdc);
+			ob(op + d->reg);
+		} else
+			goto bad;
+		break;
+
+	case I_FNSTSW:
+		if (n != 1)
+			goto bad;
+		if (isopreg(s, 2) && s->reg == 0) {
+			ob(0xdf);
+			ob(0xe0);
+		} else if (s->type == O_MEM)
+			emodrm(0, 0, 0xdd, 7, s, 0);
+		else
+			goto bad;
+		break;
+
+	default:
+bad:		aserr("bad operands to %s", ip->name);
+	}
+}
+
+#define	MAXOPS	4
+
+static void
+insn(char *s)
+{
+	struct opnd o[MAXOPS];
+	struct ainsn *ip;
+	char *av[MAXOPS], *p, c;
+	int i, n, sz, cc;
+
+	s = skipws(s);
+	if (*s == 0)
+		return;
+	for (p = s; *p && *p != ' ' && *p != '\t'; p++)
+		if (*p >= 'A' && *p <= 'Z')
+			*p += 'a' - 'A';
+	c = *p;
+	*p = 0;
+	if ((ip = mnemonic(s, &sz, &cc)) == NULL)
+		aserr("unknown instruction %s", s);
+	if (c)
+		p++;
+	if (ip->cls == I_PFX) {
+		encode(ip, 0, 0, o, 0, p);
+		return;
+	}
+	n = splitargs(p, av, MAXOPS);
+	for (i = 0; i < n; i++)
+		operand(av[i], &o[i]);
+	encode(ip, sz, cc, o, n, NULL);
+}
+
+/*
+ * Directives.
+ */
+#define	MAXARGS	256
+
+static char *
+symarg(char **cp)
+{
+	char *p = skipws(*cp), *q;
+
+	for (q = p; ISID(*q); q++)
+		;
+	if (q == p)
+		aserr("symbol expected");
+	*cp = q;
+	return p;
+}
+
+/* parse a symbol name terminated by comma or end */
+static struct asym *
+symop(char *s)
+{
+	struct asym *sp;
+	char *p, c;
+
+	p = symarg(&s);
+	c = *s;
+	*s = 0;
+	sp = symlook(p);
+	*s = c;
+	endarg(s);
+	return sp;
+}
+
+/* parse a string into the current section */
+static void
+ostring(char *s, int nul)
+{
+	int c, i;
+
+	s = skipws(s);
+	if (*s++ != '"')
+		aserr("string expected");
+	while ((c = *s++) != '"') {
+		if (c == 0)
+			aserr("unterminated string");
+		if (c == '\\') {
+			switch (c = *s++) {
+			case 'n': c = '\n'; break;
+			case 't': c = '\t'; break;
+			case 'r': c = '\r'; break;
+			case 'b': c = '\b'; break;
+			case 'f': c = '\f'; break;
+			case 'v': c = '\v'; break;
+			case 'x': case 'X':
+				for (c = 0; ISDIG(*s) || (*s >= 'a' && *s <= 'f')
+				    || (*s >= 'A' && *s <= 'F'); s++)
+					c = c * 16 + (ISDIG(*s) ? *s - '0' :
+					    (*s | 040) - 'a' + 10);
+				break;
+			default:
+				if (c >= '0' && c <= '7') {
+					c -= '0';
+					for (i = 0; i < 2 && *s >= '0' &&
+					    *s <= '7'; i++)
+						c = c * 8 + *s++ - '0';
+				} else if (c == 0)
+					aserr("unterminated string");
+				break;
+			}
+		}
+		ob(c & 0377);
+	}
+	if (nul)
+		ob(0);
+	endarg(s);
+}
+
+static void
+align(int n, int fill)
+{
+	struct frag *f;
+
+	if (n < 1 || (n & (n - 1)))
+		aserr("bad alignment %d", n);
+	if (n > cursec->align)
+		cursec->align = n;
+	if (n == 1)
+		return;
+	f = varfrag(V_ALIGN);
+	f->valign = n;
+	f->vfill = fill;
+}
+
+static void
+dosection(char **av, int n)
+{
+	struct asect *s;
+	char *name, *p;
+	int type, flags, entsize;
+
+	name = skipws(av[0]);
+	if (*name == '"') {
+		name++;
+		if ((p = strchr(name, '"')) == NULL)
+			aserr("bad section name");
+		*p++ = 0;
+	} else {
+		for (p = name; ISID(*p) || *p == '-'; p++)
+			;
+		if (p == name)
+			aserr("bad section name");
+	}
+	endarg(p);
+	*p = 0;
+
+	type = SHT_PROGBITS;
+	flags = entsize = 0;
+	if (strncmp(name, ".text", 5) == 0)
+		flags = SHF_ALLOC|SHF_EXECINSTR;
+	else if (strncmp(name, ".data", 5) == 0 ||
+	    strcmp(name, ".ctors") == 0 || strcmp(name, ".dtors") == 0)
+		flags = SHF_ALLOC|SHF_WRITE;
+	else if (strncmp(name, ".bss", 4) == 0)
+		type = SHT_NOBITS, flags = SHF_ALLOC|SHF_WRITE;
+	else if (strncmp(name, ".rodata", 7) == 0)
+		flags = SHF_ALLOC;
+	else if (strcmp(name, ".tdata") == 0)
+		flags = SHF_ALLOC|SHF_WRITE|SHF_TLS;
+	else if (strcmp(name, ".tbss") == 0)
+		type = SHT_NOBITS, flags = SHF_ALLOC|SHF_WRITE|SHF_TLS;
+	else if (strcmp(name, ".init_array") == 0)
+		type = SHT_INIT_ARRAY, flags = SHF_ALLOC|SHF_WRITE;
+	else if (strcmp(name, ".fini_array") == 0)
+		type = SHT_FINI_ARRAY, flags = SHF_ALLOC|SHF_WRITE;
+	else if (strncmp(name, ".note", 5) == 0)
+		type = SHT_NOTE;
+
+	if (n > 1) {
+		p = skipws(av[1]);
+		if (*p++ != '"')
+			aserr("bad section flags");
+		for (flags = 0; *p != '"'; p++) {
+			switch (*p) {
+			case 'a': flags |= SHF_ALLOC; break;
+			case 'w': flags |= SHF_WRITE; break;
+			case 'x': flags |= SHF_EXECINSTR; break;
+			case 'M': flags |= SHF_MERGE; break;
+			case 'S': flags |= SHF_STRINGS; break;
+			case 'T': flags |= SHF_TLS; break;
+			default: aserr("unknown section flag %c", *p);
+			}
+		}
+		endarg(p + 1);
+	}
+	if (n > 2) {
+		p = skipws(av[2]);
+		if (*p != '@' && *p != '%')
+			aserr("bad section type");
+		p++;
+		if (strncmp(p, "progbits", 8) == 0)
+			type = SHT_PROGBITS, p += 8;
+		else if (strncmp(p, "nobits", 6) == 0)
+			type = SHT_NOBITS, p += 6;
+		else if (strncmp(p, "note", 4) == 0)
+			type = SHT_NOTE, p += 4;
+		else if (strncmp(p, "init_array", 10) == 0)
+			type = SHT_INIT_ARRAY, p += 10;
+		else if (strncmp(p, "fini_array", 10) == 0)
+			type = SHT_FINI_ARRAY, p += 10;
+		else if (strncmp(p, "preinit_array", 13) == 0)
+			type = SHT_PREINIT_ARRAY, p += 13;
+		else
+			aserr("unknown section type");
+		endarg(p);
+	}
+	if (n > 3 && (flags & SHF_MERGE))
+		entsize = (int)cexpr(av[3]);
+	else if (n > 3)
+		aserr("bad .section");
+	s = getsec(name, type, flags, entsize);
+	setsec(s);
+}
+
+static void
+docomm(char **av, int n, int local)
+{
+	struct asym *sp;
+	long long sz, al;
+
+	if (n < 2 || n > 3)
+		aserr("bad .comm");
+	sp = symop(av[0]);
+	sz = cexpr(av[1]);
+	al = n > 2 ? cexpr(av[2]) : 1;
+	if (sz < 0 || al < 1 || al > 0x10000 || (al & (al - 1)))
+		aserr("bad .comm");
+	if (sp->sec || sp->comm)
+		aserr("%s redefined", sp->name);
+	sp->comm = 1;
+	sp->csize = sz;
+	sp->calign = (int)al;
+	if (local || sp->local) {
+		sp->local = 1;
+		lcomms = realloc(lcomms, sizeof(struct asym *) * (nlcomm + 1));
+		if (lcomms == NULL)
+			aserr("out of memory");
+		lcomms[nlcomm++] = sp;
+	}
+}
+
+static void
+directive(char *s)
+{
+	char *av[MAXARGS], *d = s + 1, *p;
+	struct asym *sp;
+	struct expr e;
+	int n, i, sz;
+	long long v;
+
+	for (p = d; ISID(*p); p++)
+		;
+	if (*p)
+		*p++ = 0;
+	n = splitargs(p, av, MAXARGS);
+
+	if (strcmp(d, "text") == 0) {
+		setsec(getsec(".text", SHT_PROGBITS,
+		    SHF_ALLOC|SHF_EXECINSTR, 0));
+	} else if (strcmp(d, "data") == 0) {
+		setsec(getsec(".data", SHT_PROGBITS, SHF_ALLOC|SHF_WRITE, 0));
+	} else if (strcmp(d, "bss") == 0) {
+		setsec(bsssec);
+	} else if (strcmp(d, "section") == 0) {
+		if (n < 1)
+			aserr("bad .section");
+		dosection(av, n);
+	} else if (strcmp(d, "globl") == 0 || strcmp(d, "global") == 0 ||
+	    strcmp(d, "weak") == 0) {
+		for (i = 0; i < n; i++)
+			symop(av[i])->bind = *d == 'w' ? STB_WEAK : STB_GLOBAL;
+	} else if (strcmp(d, "local") == 0) {
+		for (i = 0; i < n; i++)
+			symop(av[i])->local = 1;
+	} else if (strcmp(d, "hidden") == 0 || strcmp(d, "internal") == 0 ||
+	    strcmp(d, "protected") == 0) {
+		for (i = 0; i < n; i++)
+			symop(av[i])->vis = *d == 'h' ? 2 : *d == 'i' ? 1 : 3;
+	} else if (strcmp(d, "type") == 0) {
+		if (n != 2)
+			aserr("bad .type");
+		sp = symop(av[0]);
+		p = skipws(av[1]);
+		if (*p == '@' || *p == '%')
+			p++;
+		if (strncmp(p, "function", 8) == 0)
+			sp->type = STT_FUNC, p += 8;
+		else if (strncmp(p, "object", 6) == 0)
+			sp->type = STT_OBJECT, p += 6;
+		else if (strncmp(p, "tls_object", 10) == 0)
+			sp->type = STT_TLS, p += 10;
+		else if (strncmp(p, "notype", 6) == 0)
+			sp->type = STT_NOTYPE, p += 6;
+		else
+			aserr("unknown symbol type");
+		endarg(p);
+	} else if (strcmp(d, "size") == 0) {
+		if (n != 2)
+			aserr("bad .size");
+		sp = symop(av[0]);
+		p = av[1];
+		expr(&p, &sp->size);
+		endarg(p);
+		sp->hassize = 1;
+	} else if (strcmp(d, "align") == 0 || strcmp(d, "balign") == 0 ||
+	    strcmp(d, "p2align") == 0) {
+		if (n < 1 || n > 2)
+			aserr("bad .align");
+		v = cexpr(av[0]);
+		if (*d == 'p')
+			v = v < 0 || v > 16 ? -1 : 1 << v;
+		if (v < 1 || v > 0x10000)
+			aserr("bad alignment");
+		i = n > 1 ? (int)cexpr(av[1]) :
+		    (cursec->flags & SHF_EXECINSTR) ? -1 : 0;
+		align((int)v, i);
+	} else if ((sz = strcmp(d, "byte") == 0 ? 1 :
+	    strcmp(d, "short") == 0 || strcmp(d, "word") == 0 ||
+	    strcmp(d, "value") == 0 || strcmp(d, "2byte") == 0 ? 2 :
+	    strcmp(d, "long") == 0 || strcmp(d, "int") == 0 ||
+	    strcmp(d, "4byte") == 0 ? 4 :
+	    strcmp(d, "quad") == 0 || strcmp(d, "8byte") == 0 ? 8 : 0)) {
+		for (i = 0; i < n; i++) {
+			p = av[i];
+			expr(&p, &e);
+			endarg(p);
+			if (e.mod)
+				aserr("bad modifier");
+			ofield(&e, sz, 0, 0, 0, 0);
+		}
+	} else if (strcmp(d, "ascii") == 0 || strcmp(d, "asciz") == 0 ||
+	    strcmp(d, "string") == 0) {
+		for (i = 0; i < n; i++)
+			ostring(av[i], d[4] == 'z' || *d == 's');
+	} else if (strcmp(d, "space") == 0 || strcmp(d, "skip") == 0 ||
+	    strcmp(d, "zero") == 0) {
+		if (n < 1 || n > 2 || (n > 1 && *d == 'z'))
+			aserr("bad .space");
+		ospace(cexpr(av[0]), n > 1 ? (int)cexpr(av[1]) & 0377 : 0);
+	} else if (strcmp(d, "comm") == 0 || strcmp(d, "lcomm") == 0) {
+		docomm(av, n, *d == 'l');
+	} else if (strcmp(d, "ident") == 0) {
+		struct asect *osec = cursec;
+
+		if (n != 1)
+			aserr("bad .ident");
+		if (comsec == NULL) {
+			comsec = getsec(".comment", SHT_PROGBITS,
+			    SHF_MERGE|SHF_STRINGS, 1);
+			setsec(comsec);
+			ob(0);
+		}
+		setsec(comsec);
+		ostring(av[0], 1);
+		setsec(osec);
+	} else if (strcmp(d, "file") == 0) {
+		if (n != 1 || *skipws(av[0]) != '"' || filesym)
+			aserr("bad .file");
+		p = skipws(av[0]) + 1;
+		if ((s = strchr(p, '"')) == NULL)
+			aserr("bad .file");
+		*s = 0;
+		filesym = asalloc(sizeof(struct asym));
+		filesym->name = asstrdup(p);
+		filesym->type = STT_FILE;
+	} else if (strcmp(d, "set") == 0 || strcmp(d, "equ") == 0) {
+		if (n != 2)
+			aserr("bad .set");
+		sp = symop(av[0]);
+		if (sp->sec || sp->comm || sp->set)
+			aserr("%s redefined", sp->name);
+		sp->set = asalloc(sizeof(struct expr));
+		p = av[1];
+		expr(&p, sp->set);
+		endarg(p);
+		if (sp->set->sub || sp->set->mod)
+			aserr("bad .set");
+	} else if (strcmp(d, "end") == 0) {
+		asend = 1;
+	} else
+		aserr("unknown directive .%s", d);
+}
+
+/*
+ * Handle one statement.
+ */
+static void
+statement(char *s)
+{
+	char *p;
+
+	for (;;) {
+		s = skipws(s);
+		for (p = s; ISID(*p); p++)
+			;
+		if (p == s || *p != ':')
+			break;
+		*p = 0;
+		if (ISDIG(*s)) {
+			for (p = s; *p; p++)
+				if (!ISDIG(*p))
+					aserr("bad label %s", s);
+			setlab(numlab(s, 0));
+		} else
+			setlab(symlook(s));
+		s = p + 1;
+	}
+	if (*s == '.')
+		directive(s);
+	else
+		insn(s);
+}
+
+/*
+ * Split a line into statements, removing comments.
+ */
+static void
+asline(char *s)
+{
+	char *p, *st;
+
+	for (st = p = s; *p; p++) {
+		if (*p == '"') {
+			for (p++; *p && *p != '"'; p++)
+				if (*p == '\\' && p[1])
+					p++;
+			if (*p == 0)
+				break;
+		} else if (*p == '#') {
+			*p = 0;
+			break;
+		} else if (*p == ';') {
+			*p = 0;
+			statement(st);
+			st = p + 1;
+		}
+	}
+	statement(st);
+}
+
+/*
+ * Layout.
+ */
+static const unsigned char nops[][10] = {
+	{ 0x90 },
+	{ 0x66, 0x90 },
+	{ 0x0f, 0x1f, 0x00 },
+	{ 0x0f, 0x1f, 0x40, 0x00 },
+	{ 0x0f, 0x1f, 0x44, 0x00, 0x00 },
+	{ 0x66, 0x0f, 0x1f, 0x44, 0x00, 0x00 },
+	{ 0x0f, 0x1f, 0x80, 0x00, 0x00, 0x00, 0x00 },
+	{ 0x0f, 0x1f, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00 },
+	{ 0x66, 0x0f, 0x1f, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00 },
+	{ 0x66, 0x2e, 0x0f, 0x1f, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00 },
+};
+
+/* can a branch in s reach t directly */
+static int
+nearsym(struct asym *t, struct asect *s)
+{
+	return t->sec == s && t->bind == STB_LOCAL;
+}
+
+static void
+layout(void)
+{
+	struct asect *s;
+	struct frag *f;
+	int a, changed, d;
+
+	do {
+		changed = 0;
+		for (s = sects; s; s = s->next) {
+			for (a = 0, f = s->first; f; f = f->next) {
+				f->addr = a;
+				a += f->len;
+				if (f->vtype == V_ALIGN)
+					f->vsize = -a & (f->valign - 1);
+				else if (f->vtype != V_NONE && f->vsize == 0)
+					f->vsize = 2;
+				a += f->vsize;
+			}
+			s->size = a;
+		}
+		for (s = sects; s; s = s->next) {
+			for (f = s->first; f; f = f->next) {
+				if ((f->vtype != V_JMP && f->vtype != V_JCC) ||
+				    f->vsize != 2)
+					continue;
+				if (nearsym(f->vexp.add, s) && !f->vexp.mod) {
+					d = SADDR(f->vexp.add) +
+					    (int)f->vexp.val -
+					    (f->addr + f->len + 2);
+					if (d >= -128 && d <= 127)
+						continue;
+				}
+				f->vsize = f->vtype == V_JMP ? 5 : 6;
+				changed = 1;
+			}
+		}
+	} while (changed);
+}
+
+/* add a relocation */
+static void
+addrel(struct asect *s, int off, int type, struct asym *sp, long long addend)
+{
+	struct rel *r;
+
+	if (s->nrel == s->arel) {
+		s->arel = s->arel ? s->arel * 2 : 64;
+		s->rel = realloc(s->rel, s->arel * sizeof(struct rel));
+		if (s->rel == NULL)
+			aserr("out of memory");
+	}
+	r = &s->rel[s->nrel++];
+	r->off = off;
+	r->type = type;
+	r->sym = NULL;
+	r->sec = NULL;
+	r->addend = addend;
+	if (ISGOTREL(type))
+		symlook("_GLOBAL_OFFSET_TABLE_")->used = 1;
+	if (sp->sec && sp->bind == STB_LOCAL && !sp->comm &&
+	    !ISGOTREL(type)) {
+		/* local symbols are relative their section */
+		r->sec = sp->sec;
+		r->addend += SADDR(sp);
+	} else {
+		if (sp->temp)
+			aserr("undefined %s", sp->name);
+		sp->used = 1;
+		r->sym = sp;
+	}
+}
+
+/*
+ * Resolve fixup in section s, writing into buf.
+ */
+static void
+resolve(struct asect *s, unsigned char *buf, struct fixup *fx)
+{
+	struct expr *e = &fx->e;
+	struct asym *sp = e->add;
+	long long v = e->val;
+	int p = fx->frag->addr + fx->off, pcrel = fx->pcrel, type, i;
+
+	if (e->sub) {
+		if (e->sub->sec == NULL)
+			aserr("undefined %s", e->sub->name);
+		if (sp && sp->sec == e->sub->sec && !e->mod) {
+			v += SADDR(sp) - SADDR(e->sub);
+			sp = NULL;
+		} else if (e->sub->sec == s && !pcrel) {
+			/* sym - . style */
+			v += p - SADDR(e->sub);
+			pcrel = 1;
+			fx->pcadj = 0;
+		} else
+			aserr("bad expression");
+	}
+	if (sp && pcrel && nearsym(sp, s) && !e->mod) {
+		v = SADDR(sp) + v - (p + fx->pcadj);
+		sp = NULL;
+	}
+	if (sp) {
+		if (sp->sec == NULL && !sp->comm && sp->temp)
+			aserr("undefined %s", sp->name);
+		if (e->mod == M_GOTPCREL)
+			type = R_X86_64_GOTPCREL;
+		else if (e->mod == M_GOTPCRELX)
+			type = R_X86_64_GOTPCRELX;
+		else if (e->mod == M_REXGOTPCRELX)
+			type = R_X86_64_REX_GOTPCRELX;
+		else if (e->mod == M_PLT ||
+		    (fx->call && (sp->sec == NULL || sp->bind != STB_LOCAL)))
+			type = R_X86_64_PLT32;
+		else if (pcrel)
+			type = fx->size == 8 ? R_X86_64_PC64 :
+			    fx->size == 4 ? R_X86_64_PC32 :
+			    fx->size == 2 ? R_X86_64_PC16 : R_X86_64_PC8;
+		else
+			type = fx->size == 8 ? R_X86_64_64 :
+			    fx->size == 4 ? (fx->sign ? R_X86_64_32S :
+			    R_X86_64_32) :
+			    fx->size == 2 ? R_X86_64_16 : R_X86_64_8;
+		if ((ISGOTREL(type) || type == R_X86_64_PLT32) &&
+		    (!pcrel || fx->size != 4))
+			aserr("bad relocation");
+		addrel(s, p, type, sp, pcrel ? v - fx->pcadj : v);
+		v = 0;
+	} else if (fx->size < 8) {
+		if (v < -(1LL << (fx->size * 8 - 1)) ||
+		    v >= (1LL << (fx->size * 8)) ||
+		    (pcrel && v >= (1LL << (fx->size * 8 - 1))))
+			aserr("value out of range");
+	}
+	for (i = 0; i < fx->size; i++) {
+		buf[p + i] = (unsigned char)(v & 0377);
+		v >>= 8;
+	}
+}
+
+/*
+ * Assemble the contents of a section into buf.
+ */
+static void
+secdata(struct asect *s, unsigned char *buf)
+{
+	struct frag *f;
+	struct fixup *fx, fb;
+	unsigned char *b;
+	int n, k, long_, op;
+
+	for (f = s->first; f; f = f->next) {
+		if (s->type == SHT_NOBITS)
+			continue;
+		if (f->len)
+			memcpy(buf + f->addr, f->buf, f->len);
+		b = buf + f->addr + f->len;
+		switch (f->vtype) {
+		case V_ALIGN:
+			if (f->vfill >= 0) {
+				memset(b, f->vfill, f->vsize);
+				break;
+			}
+			for (n = f->vsize; n > 0; n -= k, b += k) {
+				k = n > 10 ? 10 : n;
+				memcpy(b, nops[k-1], k);
+			}
+			break;
+		case V_JMP:
+		case V_JCC:
+			long_ = f->vsize > 2;
+			if (f->vtype == V_JMP)
+				op = long_ ? 0xe9 : 0xeb;
+			else
+				op = long_ ? 0x0f80 + f->vcc : 0x70 + f->vcc;
+			n = 0;
+			if (op > 0xff)
+				b[n++] = op >> 8;
+			b[n++] = op & 0377;
+			if (!long_) {
+				b[n] = (unsigned char)(SADDR(f->vexp.add) +
+				    f->vexp.val - (f->addr + f->len + 2));
+				break;
+			}
+			memset(&fb, 0, sizeof(fb));
+			fb.frag = f;
+			fb.off = f->len + n;
+			fb.size = 4;
+			fb.pcrel = 1;
+			fb.pcadj = 4;
+			fb.call = 1;
+			fb.e = f->vexp;
+			resolve(s, buf, &fb);
+			break;
+		}
+	}
+	for (fx = s->fix; fx; fx = fx->next)
+		resolve(s, buf, fx);
+}
+
+/*
+ * Output buffer.
+ */
+struct obuf {
+	unsigned char *b;
+	size_t len, alen;
+};
+
+static void
+bput(struct obuf *o, const void *p, size_t n)
+{
+	if (o->len + n > o->alen) {
+		while (o->len + n > o->alen)
+			o->alen = o->alen ? o->alen * 2 : 4096;
+		if ((o->b = realloc(o->b, o->alen)) == NULL)
+			aserr("out of memory");
+	}
+	if (p)
+		memcpy(o->b + o->len, p, n);
+	else
+		memset(o->b + o->len, 0, n);
+	o->len += n;
+}
+
+static void
+bnum(struct obuf *o, unsigned long long v, int n)
+{
+	unsigned char b[8];
+	int i;
+
+	for (i = 0; i < n; i++, v >>= 8)
+		b[i] = (unsigned char)(v & 0377);
+	bput(o, b, n);
+}
+
+static void
+balign(struct obuf *o, int n)
+{
+	while (o->len % n)
+		bput(o, NULL, 1);
+}
+
+static int
+bstr(struct obuf *o, char *s)
+{
+	int off = (int)o->len;
+
+	bput(o, s, strlen(s) + 1);
+	return off;
+}
+
+/* section header */
+static void
+shdr(struct obuf *o, int name, int type, long long flags, long long off,
+    long long size, int link, int info, int align, int entsize)
+{
+	bnum(o, name, 4);
+	bnum(o, type, 4);
+	bnum(o, flags, 8);
+	bnum(o, 0, 8);
+	bnum(o, off, 8);
+	bnum(o, size, 8);
+	bnum(o, link, 4);
+	bnum(o, info, 4);
+	bnum(o, align, 8);
+	bnum(o, entsize, 8);
+}
+
+static void
+esym(struct obuf *o, int name, int info, int other, int shndx,
+    long long val, long long size)
+{
+	bnum(o, name, 4);
+	bnum(o, info, 1);
+	bnum(o, other, 1);
+	bnum(o, shndx, 2);
+	bnum(o, val, 8);
+	bnum(o, size, 8);
+}
+
+/* compute the size of a symbol */
+static long long
+symsize(struct asym *sp)
+{
+	struct expr *e = &sp->size;
+
+	if (sp->comm)
+		return sp->csize;
+	if (!sp->hassize)
+		return 0;
+	if (e->add == NULL && e->sub == NULL)
+		return e->val;
+	if (e->add && e->sub && e->add->sec && e->add->sec == e->sub->sec)
+		return SADDR(e->add) - SADDR(e->sub) + e->val;
+	aserr("bad .size for %s", sp->name);
+	return 0;
+}
+
+/*
+ * Finish up and write the object.
+ */
+static void
+elfwrite(FILE *fp)
+{
+	struct obuf o, str, shstr, symtab, sh;
+	struct asect *s;
+	struct asym *sp;
+	long long *offs, symoff, stroff, shstroff;
+	unsigned char **data;
+	int nsec, i, nsyms, nlocal, pass, symidx, *names, *rnames;
+	int symname, strname, shstrname;
+
+	memset(&o, 0, sizeof(o));
+	memset(&str, 0, sizeof(str));
+	memset(&shstr, 0, sizeof(shstr));
+	memset(&symtab, 0, sizeof(symtab));
+	memset(&sh, 0, sizeof(sh));
+
+	for (nsec = 0, s = sects; s; s = s->next)
+		s->idx = ++nsec;
+	data = asalloc(sizeof(unsigned char *) * (nsec + 1));
+	offs = asalloc(sizeof(long long) * (nsec + 1));
+	names = asalloc(sizeof(int) * (nsec + 1));
+	rnames = asalloc(sizeof(int) * (nsec + 1));
+
+	/* assemble sections; this also collects relocations */
+	for (s = sects; s; s = s->next) {
+		data[s->idx] = asalloc(s->size + 1);
+		secdata(s, data[s->idx]);
+	}
+
+	/* symbol table */
+	bstr(&str, "");
+	esym(&symtab, 0, 0, 0, 0, 0, 0);
+	nsyms = 1;
+	if (filesym) {
+		esym(&symtab, bstr(&str, filesym->name),
+		    STB_LOCAL << 4 | STT_FILE, 0, SHN_ABS, 0, 0);
+		nsyms++;
+	}
+	for (s = sects; s; s = s->next) {
+		s->symidx = nsyms++;
+		esym(&symtab, 0, STB_LOCAL << 4 | STT_SECTION, 0, s->idx, 0, 0);
+	}
+	nlocal = 0;
+	for (pass = 0; pass < 2; pass++) {
+		if (pass == 1)
+			nlocal = nsyms;
+		for (sp = symlist; sp; sp = sp->lnext) {
+			if (sp->temp)
+				continue;
+			if (sp->sec == NULL && !sp->comm && !sp->abs &&
+			    !sp->used && sp->bind == STB_LOCAL)
+				continue;
+			/* undefined and common symbols are external */
+			if ((sp->bind == STB_LOCAL && (sp->sec || sp->abs)) !=
+			    (pass == 0))
+				continue;
+			sp->idx = nsyms++;
+			esym(&symtab, bstr(&str, sp->name),
+			    (pass ? (sp->bind == STB_WEAK ? STB_WEAK :
+			    STB_GLOBAL) : STB_LOCAL) << 4 |
+			    (sp->comm && sp->type == STT_NOTYPE ?
+			    STT_OBJECT : sp->type), sp->vis,
+			    sp->sec ? sp->sec->idx : sp->comm ? SHN_COMMON :
+			    sp->abs ? SHN_ABS : 0,
+			    sp->sec ? SADDR(sp) : sp->comm ? sp->calign :
+			    sp->abs ? sp->off : 0, symsize(sp));
+		}
+	}
+
+	/* section names */
+	bstr(&shstr, "");
+	for (s = sects; s; s = s->next) {
+		names[s->idx] = bstr(&shstr, s->name);
+		if (s->nrel) {
+			rnames[s->idx] = (int)shstr.len;
+			bput(&shstr, ".rela", 5);
+			bstr(&shstr, s->name);
+		}
+	}
+	symname = bstr(&shstr, ".symtab");
+	strname = bstr(&shstr, ".strtab");
+	shstrname = bstr(&shstr, ".shstrtab");
+
+	/* file layout; the header is written last */
+	bput(&o, NULL, 64);
+	for (s = sects; s; s = s->next) {
+		if (s->type == SHT_NOBITS) {
+			offs[s->idx] = (long long)o.len;
+			continue;
+		}
+		balign(&o, s->align);
+		offs[s->idx] = (long long)o.len;
+		bput(&o, data[s->idx], s->size);
+	}
+	i = nsec + 1;
+	symidx = i;
+	for (s = sects; s; s = s->next)
+		if (s->nrel)
+			symidx++;
+
+	shdr(&sh, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+	for (s = sects; s; s = s->next)
+		shdr(&sh, names[s->idx], s->type, s->flags, offs[s->idx],
+		    s->size, 0, 0, s->align, s->entsize);
+	for (s = sects; s; s = s->next) {
+		struct rel *r;
+		int j;
+
+		if (s->nrel == 0)
+			continue;
+		balign(&o, 8);
+		shdr(&sh, rnames[s->idx], SHT_RELA, SHF_INFO_LINK,
+		    (long long)o.len, s->nrel * 24LL, symidx, s->idx, 8, 24);
+		for (j = 0, r = s->rel; j < s->nrel; j++, r++) {
+			bnum(&o, r->off, 8);
+			bnum(&o, (unsigned long long)(r->sec ?
+			    r->sec->symidx : r->sym->idx) << 32 | r->type, 8);
+			bnum(&o, (unsigned long long)r->addend, 8);
+		}
+	}
+	balign(&o, 8);
+	symoff = (long long)o.len;
+	bput(&o, symtab.b, symtab.len);
+	stroff = (long long)o.len;
+	bput(&o, str.b, str.len);
+	shstroff = (long long)o.len;
+	bput(&o, shstr.b, shstr.len);
+	shdr(&sh, symname, SHT_SYMTAB, 0, symoff, (long long)symtab.len,
+	    symidx + 1, nlocal, 8, 24);
+	shdr(&sh, strname, SHT_STRTAB, 0, stroff, (long long)str.len,
+	    0, 0, 1, 0);
+	shdr(&sh, shstrname, SHT_STRTAB, 0, shstroff, (long long)shstr.len,
+	    0, 0, 1, 0);
+	balign(&o, 8);
+
+	/* ELF header */
+	memcpy(o.b, "\177ELF\2\1\1", 7);
+	memset(o.b + 7, 0, 9);
+	o.b[16] = 1;			/* ET_REL */
+	o.b[17] = 0;
+	o.b[18] = 62;			/* EM_X86_64 */
+	o.b[19] = 0;
+	o.b[20] = 1;			/* EV_CURRENT */
+	memset(o.b + 21, 0, 19);
+	for (i = 0; i < 8; i++)		/* e_shoff */
+		o.b[40 + i] = (unsigned char)((o.len >> (8 * i)) & 0377);
+	memset(o.b + 48, 0, 4);		/* e_flags */
+	o.b[52] = 64;			/* e_ehsize */
+	o.b[53] = 0;
+	memset(o.b + 54, 0, 4);		/* no program headers */
+	o.b[58] = 64;			/* e_shentsize */
+	o.b[59] = 0;
+	i = (int)(sh.len / 64);
+	o.b[60] = i & 0377;		/* e_shnum */
+	o.b[61] = i >> 8;
+	o.b[62] = (i - 1) & 0377;	/* e_shstrndx */
+	o.b[63] = (i - 1) >> 8;
+	bput(&o, sh.b, sh.len);
+
+	if (fwrite(o.b, 1, o.len, fp) != o.len)
+		aserr("write error");
+}
+
+/*
+ * Resolve everything that can only be done when all input is read.
+ */
+static void
+asfinish(void)
+{
+	struct asym *sp;
+	int i;
+
+	/* local commons go to .bss */
+	setsec(bsssec);
+	for (i = 0; i < nlcomm; i++) {
+		sp = lcomms[i];
+		align(sp->calign, 0);
+		sp->comm = 0;
+		setlab(sp);
+		ospace(sp->csize, 0);
+	}
+
+	/* aliases */
+	for (sp = symlist; sp; sp = sp->lnext) {
+		struct expr *e = sp->set;
+
+		if (e == NULL)
+			continue;
+		if (e->add == NULL) {
+			sp->abs = 1;
+			sp->off = (int)e->val;
+			continue;
+		}
+		if (e->add->sec == NULL)
+			aserr("%s: bad .set", sp->name);
+		sp->sec = e->add->sec;
+		sp->frag = e->add->frag;
+		sp->off = e->add->off + (int)e->val;
+		if (sp->type == STT_NOTYPE)
+			sp->type = e->add->type;
+	}
+
+	for (sp = symlist; sp; sp = sp->lnext)
+		if (sp->local && sp->sec == NULL)
+			aserr("%s: local but undefined", sp->name);
+	layout();
+}
+
+static void
+asinit(void)
+{
+	struct ainsn *ip;
+	int h;
+
+	reginit(rq, 8);
+	reginit(rl, 4);
+	reginit(rw, 2);
+	reginit(rb, 1);
+	reginit(rx, C_XMM);
+	for (ip = ainsns; ip->name; ip++) {
+		h = ashash(ip->name) % IHSZ;
+		ip->next = insnhash[h];
+		insnhash[h] = ip;
+	}
+	setsec(getsec(".text", SHT_PROGBITS, SHF_ALLOC|SHF_EXECINSTR, 0));
+	getsec(".data", SHT_PROGBITS, SHF_ALLOC|SHF_WRITE, 0);
+	bsssec = getsec(".bss", SHT_NOBITS, SHF_ALLOC|SHF_WRITE, 0);
+}
+
+/*
+ * Assemble sfile into the object file ofile.
+ * Returns 0 on success; on failure ofile is not created.
+ */
+int
+elfasm(char *sfile, char *ofile)
+{
+	static FILE *ifp, *ofp;
+	char *buf, *p, *q;
+	long n;
+
+	ifp = ofp = NULL;
+	if (setjmp(aserrbuf)) {
+		if (ifp)
+			fclose(ifp);
+		if (ofp) {
+			fclose(ofp);
+			remove(ofile);
+		}
+		return 1;
+	}
+	if ((ifp = fopen(sfile, "r")) == NULL)
+		aserr("cannot open %s", sfile);
+	if (fseek(ifp, 0L, SEEK_END) || (n = ftell(ifp)) < 0 ||
+	    fseek(ifp, 0L, SEEK_SET))
+		aserr("cannot read %s", sfile);
+	buf = asalloc(n + 1);
+	if (fread(buf, 1, n, ifp) != (size_t)n)
+		aserr("cannot read %s", sfile);
+	fclose(ifp);
+	ifp = NULL;
+	buf[n] = 0;
+
+	asinit();
+	for (p = buf, aslineno = 1; *p && !asend; p = q, aslineno++) {
+		if ((q = strchr(p, '\n')) != NULL)
+			*q++ = 0;
+		else
+			q = p + strlen(p);
+		asline(p);
+	}
+	asfinish();
+
+	if ((ofp = fopen(ofile, "wb")) == NULL)
+		aserr("cannot create %s", ofile);
+	elfwrite(ofp);
+	if (fclose(ofp) == EOF) {
+		remove(ofile);
+		return 1;
+	}
+	return 0;
+}
+#endif
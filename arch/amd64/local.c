@@ -520,7 +520,7 @@ myp2tree(NODE *p)
 	if (p->n_op == STCALL || p->n_op == USTCALL) {
 		/* save struct encoding */
 		p->n_ap = attr_add(p->n_ap,
-		    ap = attr_new(ATTR_AMD64_CMPLRET, 1));
+		    ap = tattr_new(ATTR_AMD64_CMPLRET, 1));
 		ap->iarg(0) = codeatyp(p);
 	}
 
@@ -543,7 +543,7 @@ myp2tree(NODE *p)
 			printf("\t.long 0x80000000,0,0,0\n");
 		}
 		p->n_ap = attr_add(p->n_ap,
-		    ap = attr_new(ATTR_AMD64_XORLBL, 1));
+		    ap = tattr_new(ATTR_AMD64_XORLBL, 1));
 		ap->iarg(0) = p->n_type == FLOAT ? fltxor : dblxor;
 		return;
 	}
@@ -593,6 +593,7 @@ myp2tree(NODE *p)
 	p->n_op = NAME;
 	p->n_lval = 0;
 	p->n_sp = sp;
+	p->n_ap = attr_add(p->n_ap, tattr_new(ATTR_AMD64_FCON, 0));
 }
 
 /*
@@ -29,6 +29,7 @@
 
 # include "pass2.h"
 # include <ctype.h>
+# include <stdarg.h>
 # include <string.h>
 
 static int stkpos;
@@ -862,6 +863,541 @@ myoptim(struct interpass *ip)
 {
 }
 
+/*
+ * Simple loop vectorizer, called by the optimizer for innermost
+ * counted loops.  The body may only consist of stores of elementwise
+ * expressions into arrays indexed by the loop variable, and of integer
+ * sum reductions.  The vector part is emitted as an extended asm
+ * statement before the loop test; it runs as many full 16-byte rounds
+ * as possible and leaves the remainder to the scalar loop.  Arrays
+ * that may overlap are checked at runtime.
+ *
+ * Operands of the asm are %0 index, %1 limit, then arrays, invariants
+ * and reductions, and last a scratch register.  Vector values live in
+ * %xmm8-%xmm15, which are clobbered.
+ */
+#define	VNARG	7	/* operands besides index, limit and scratch */
+#define	VXMM	8	/* first vector register */
+
+static struct {
+	TWORD t;		/* element type */
+	int sh;			/* log2 of element size */
+	int ind;		/* loop variable */
+	int narg, nxmm, maxr, bad;
+	NODE *arg[VNARG];
+	int st[VNARG];		/* array is stored into */
+	int xr[VNARG];		/* broadcast register, or reduction sum */
+	int red[VNARG];		/* reduction */
+	int ncp;		/* copies back at the loop end, after ssa */
+	int cpd[VNARG], cps[VNARG];
+	char buf[2048];
+	int pos;
+} vs;
+
+static void
+vpr(char *fmt, ...)
+{
+	va_list ap;
+	int n;
+
+	va_start(ap, fmt);
+	n = vsnprintf(vs.buf + vs.pos, sizeof(vs.buf) - vs.pos, fmt, ap);
+	va_end(ap);
+	if (n < 0 || vs.pos + n >= (int)sizeof(vs.buf))
+		vs.bad = 1;
+	else
+		vs.pos += n;
+}
+
+static char *
+vins(int o)
+{
+	static char *ins[][3] = {
+		{ "movups", "movupd", "movdqu" },
+		{ "movaps", "movapd", "movdqa" },
+		{ "addps", "addpd", "paddd" },
+		{ "subps", "subpd", "psubd" },
+		{ "mulps", "mulpd", NULL },
+		{ "divps", "divpd", NULL },
+		{ NULL, NULL, "pand" },
+		{ NULL, NULL, "por" },
+		{ NULL, NULL, "pxor" },
+	};
+	int i;
+
+	switch (o) {
+	case UMUL: i = 0; break;
+	case ASSIGN: i = 1; break;
+	case PLUS: i = 2; break;
+	case MINUS: i = 3; break;
+	case MUL: i = 4; break;
+	case DIV: i = 5; break;
+	case AND: i = 6; break;
+	case OR: i = 7; break;
+	case ER: i = 8; break;
+	default: return NULL;
+	}
+	return ins[i][vs.t == FLOAT ? 0 : vs.t == DOUBLE ? 1 : 2];
+}
+
+/*
+ * Count the references to temp n in tree p.
+ */
+static int
+vcount(NODE *p, int n)
+{
+	int o = optype(p->n_op);
+
+	if (p->n_op == TEMP)
+		return regno(p) == n;
+	if (o == LTYPE)
+		return 0;
+	if (o == UTYPE)
+		return vcount(p->n_left, n);
+	return vcount(p->n_left, n) + vcount(p->n_right, n);
+}
+
+/*
+ * Count the references to temp n in the function.
+ */
+static int
+vuses(struct p2env *p2e, int n)
+{
+	struct interpass *ip;
+	int k = 0;
+
+	DLIST_FOREACH(ip, &p2e->ipole, qelem)
+		if (ip->type == IP_NODE)
+			k += vcount(ip->ip_node, n);
+	return k;
+}
+
+/*
+ * Return the operand number for the invariant p, add it if new.
+ */
+static int
+vopnd(NODE *p)
+{
+	NODE *q;
+	int i;
+
+	for (i = 0; i < vs.narg; i++) {
+		q = vs.arg[i];
+		if (q->n_op != p->n_op || q->n_type != p->n_type)
+			continue;
+		if (p->n_op == TEMP && regno(p) == regno(q))
+			return i;
+		if ((p->n_op == ICON || p->n_op == NAME) &&
+		    p->n_lval == q->n_lval && strcmp(p->n_name, q->n_name) == 0)
+			return i;
+		if (p->n_op == FCON && p->n_dcon == q->n_dcon)
+			return i;
+	}
+	if (vs.narg == VNARG) {
+		vs.bad = 1;
+		return 0;
+	}
+	vs.arg[vs.narg] = p;
+	vs.st[vs.narg] = vs.xr[vs.narg] = vs.red[vs.narg] = 0;
+	return vs.narg++;
+}
+
+/*
+ * Check that p is the address of element i of an array.
+ * Return the operand number of the array.
+ */
+static int
+vaddr(NODE *p)
+{
+	NODE *l, *r;
+
+	if (p->n_op != PLUS) {
+		vs.bad = 1;
+		return 0;
+	}
+	l = p->n_left, r = p->n_right;
+	if (l->n_op == LS)
+		l = p->n_right, r = p->n_left;
+	if (r->n_op != LS || r->n_right->n_op != ICON ||
+	    r->n_right->n_lval != vs.sh)
+		goto bad;
+	r = r->n_left;
+	if (r->n_op == SCONV && r->n_type == LONG &&
+	    r->n_left->n_type == INT)
+		r = r->n_left;
+	if (r->n_op != TEMP || regno(r) != vs.ind)
+		goto bad;
+	if (l->n_type != INCREF(vs.t))
+		goto bad;
+	if (l->n_op == TEMP && regno(l) != vs.ind)
+		return vopnd(l);
+	if (l->n_op == ICON && l->n_name[0] != 0)
+		return vopnd(l);
+bad:	vs.bad = 1;
+	return 0;
+}
+
+/*
+ * Check an elementwise expression.
+ */
+static void
+vexpr(NODE *p)
+{
+	int i;
+
+	if (p->n_type != vs.t) {
+		vs.bad = 1;
+		return;
+	}
+	switch (p->n_op) {
+	case UMUL:
+		vaddr(p->n_left);
+		return;
+	case TEMP:
+		if (regno(p) == vs.ind)
+			break;
+		/* FALLTHROUGH */
+	case ICON:
+	case FCON:
+		i = vopnd(p);
+		vs.xr[i] = -1;
+		return;
+	case NAME:
+		/* floating point constants are never written */
+		if (attr_find(p->n_ap, ATTR_AMD64_FCON) == NULL)
+			break;
+		i = vopnd(p);
+		vs.xr[i] = -1;
+		return;
+	default:
+		if (optype(p->n_op) != BITYPE || vins(p->n_op) == NULL)
+			break;
+		vexpr(p->n_left);
+		vexpr(p->n_right);
+		return;
+	}
+	vs.bad = 1;
+}
+
+/*
+ * Generate code for p into vector register r.
+ */
+static void
+vgen(NODE *p, int r)
+{
+	int i;
+
+	if (r > vs.maxr)
+		vs.maxr = r;
+	switch (p->n_op) {
+	case UMUL:
+		vpr("\t%s (%%%d,%%0,%d),%%%%xmm%d\n", vins(UMUL),
+		    vaddr(p->n_left) + 2, 1 << vs.sh, r);
+		return;
+	case TEMP:
+	case ICON:
+	case FCON:
+	case NAME:
+		i = vopnd(p);
+		vpr("\t%s %%%%xmm%d,%%%%xmm%d\n", vins(ASSIGN), vs.xr[i], r);
+		return;
+	}
+	vgen(p->n_left, r);
+	if (p->n_right->n_op == UMUL) {
+		vgen(p->n_right, r+1);
+		i = r+1;
+	} else if (optype(p->n_right->n_op) == LTYPE) {
+		i = vs.xr[vopnd(p->n_right)];
+	} else {
+		vgen(p->n_right, r+1);
+		i = r+1;
+	}
+	vpr("\t%s %%%%xmm%d,%%%%xmm%d\n", vins(p->n_op), i, r);
+}
+
+/*
+ * p is t = a + b.  If it is s = s + e, or after ssa s' = s + e with
+ * s = s' copied back at the loop end, return the operand that is s.
+ */
+static NODE *
+vred(NODE *p)
+{
+	NODE *q = p->n_right;
+	int n = regno(p->n_left), i;
+
+	for (i = 0; i < vs.ncp; i++)
+		if (vs.cps[i] == n)
+			n = vs.cpd[i];
+	if (q->n_left->n_op == TEMP && regno(q->n_left) == n)
+		return q->n_left;
+	if (q->n_right->n_op == TEMP && regno(q->n_right) == n)
+		return q->n_right;
+	return NULL;
+}
+
+static struct interpass *
+vput(struct interpass *ip, NODE *p)
+{
+	struct interpass *ip2 = ipnode(p);
+
+	DLIST_INSERT_AFTER(ip, ip2, qelem);
+	return ip2;
+}
+
+int
+myvector(struct p2env *p2e, struct loopinfo *li)
+{
+	struct interpass *ip, *ip2, *end;
+	NODE *p, *q, *r, *ops, *cl, *jt, *mt, *gt;
+	int i, j, k, n, w, nred;
+
+	memset(&vs, 0, sizeof(vs));
+	if ((li->ind->n_type != INT && li->ind->n_type != LONG) ||
+	    (li->lim->n_op == TEMP ? li->lim->n_type != li->ind->n_type :
+	    li->lim->n_op != ICON || li->lim->n_name[0] != 0))
+		return 0;
+	vs.ind = regno(li->ind);
+
+	/*
+	 * The increment is last, before the back jump.  After ssa it is
+	 * t = i + 1, followed by the copies back of the values carried
+	 * around the loop, i = t among them.
+	 */
+	for (end = DLIST_PREV(li->last, qelem); ;
+	    end = DLIST_PREV(end, qelem)) {
+		if (end->type != IP_NODE)
+			return 0;
+		p = end->ip_node;
+		if (p->n_op != ASSIGN || p->n_left->n_op != TEMP ||
+		    p->n_right->n_op != TEMP)
+			break;
+		if (vs.ncp == VNARG)
+			return 0;
+		vs.cpd[vs.ncp] = regno(p->n_left);
+		vs.cps[vs.ncp++] = regno(p->n_right);
+	}
+	n = vs.ind;
+	for (i = 0; i < vs.ncp; i++)
+		if (vs.cpd[i] == vs.ind)
+			n = vs.cps[i];
+	if (p->n_op != ASSIGN || p->n_left->n_op != TEMP ||
+	    regno(p->n_left) != n || (n != vs.ind && vuses(p2e, n) != 2))
+		return 0;
+	/* the other copies must all be sums */
+	nred = vs.ncp - (n != vs.ind);
+	p = p->n_right;
+	if (p->n_op != PLUS || p->n_left->n_op != TEMP ||
+	    regno(p->n_left) != vs.ind || p->n_right->n_op != ICON ||
+	    p->n_right->n_lval != 1)
+		return 0;
+
+	for (ip = li->first; ip != end; ip = DLIST_NEXT(ip, qelem)) {
+		if (ip->type == IP_DEFLAB)
+			continue;
+		if (ip->type != IP_NODE || ip->ip_node->n_op != ASSIGN)
+			return 0;
+		p = ip->ip_node;
+		q = p->n_left;
+		if (q->n_op == TEMP && p->n_right->n_op == TEMP &&
+		    regno(p->n_right) == vs.ind) {
+			/* leftover from i++, must be unused */
+			if (vuses(p2e, regno(q)) != 1)
+				return 0;
+			continue;
+		}
+		if (vs.t == 0) {
+			vs.t = p->n_type;
+			if (vs.t == FLOAT || vs.t == INT || vs.t == UNSIGNED)
+				vs.sh = 2;
+			else if (vs.t == DOUBLE)
+				vs.sh = 3;
+			else
+				return 0;
+		}
+		if (p->n_type != vs.t)
+			return 0;
+		if (q->n_op == UMUL) {
+			vs.st[vaddr(q->n_left)] = 1;
+			vexpr(p->n_right);
+		} else if (q->n_op == TEMP && regno(q) != vs.ind &&
+		    (vs.t == INT || vs.t == UNSIGNED) &&
+		    p->n_right->n_op == PLUS) {
+			/* s = s + expr */
+			if ((r = vred(p)) == NULL)
+				return 0;
+			vexpr(r == p->n_right->n_left ?
+			    p->n_right->n_right : p->n_right->n_left);
+			n = 0;
+			for (ip2 = li->first; ip2 != li->last;
+			    ip2 = DLIST_NEXT(ip2, qelem))
+				if (ip2->type == IP_NODE)
+					n += vcount(ip2->ip_node, regno(r));
+			if (n != 2 || (li->lim->n_op == TEMP &&
+			    regno(li->lim) == regno(r)))
+				return 0;
+			if (regno(r) != regno(q)) {
+				/* s' is only copied back */
+				if (vuses(p2e, regno(q)) != 2)
+					return 0;
+				nred--;
+			}
+			vs.red[vopnd(r)] = 1;
+		} else
+			return 0;
+		if (vs.bad)
+			return 0;
+	}
+	if (vs.t == 0 || nred != 0 || vs.narg + 3 > 10)
+		return 0;
+	w = 16 >> vs.sh;
+
+	/* runtime overlap checks, skip to the scalar loop if needed */
+	k = vs.narg + 2;
+	for (i = 0; i < vs.narg; i++) {
+		if (vs.arg[i]->n_type != INCREF(vs.t))
+			continue;
+		for (j = i+1; j < vs.narg; j++) {
+			if (vs.arg[j]->n_type != INCREF(vs.t) ||
+			    (vs.st[i] == 0 && vs.st[j] == 0))
+				continue;
+			if (vs.arg[i]->n_op == ICON && vs.arg[j]->n_op == ICON) {
+				/* different arrays, or constant distance */
+				if (strcmp(vs.arg[i]->n_name,
+				    vs.arg[j]->n_name) != 0)
+					continue;
+				if (vs.arg[i]->n_lval - vs.arg[j]->n_lval >= 16 ||
+				    vs.arg[j]->n_lval - vs.arg[i]->n_lval >= 16)
+					continue;
+				return 0;
+			}
+			vpr("\tmovq %%%d,%%%d\n\tsubq %%%d,%%%d\n", i+2, k,
+			    j+2, k);
+			vpr("\taddq $15,%%%d\n\tcmpq $30,%%%d\n\tjbe 2f\n", k, k);
+		}
+	}
+	vpr("\tleaq %d(%%0),%%%d\n\tcmpq %%1,%%%d\n\tjg 2f\n", w, k, k);
+
+	/* broadcast invariants and clear sums */
+	vs.maxr = vs.nxmm = VXMM;
+	for (i = 0; i < vs.narg; i++) {
+		if (vs.red[i]) {
+			vs.xr[i] = vs.nxmm++;
+			vpr("\tpxor %%%%xmm%d,%%%%xmm%d\n", vs.xr[i], vs.xr[i]);
+		}
+		if (vs.xr[i] != -1)
+			continue;
+		vs.xr[i] = n = vs.nxmm++;
+		if (vs.t == DOUBLE)
+			vpr("\tmovapd %%%d,%%%%xmm%d\n"
+			    "\tunpcklpd %%%%xmm%d,%%%%xmm%d\n", i+2, n, n, n);
+		else if (vs.t == FLOAT)
+			vpr("\tmovaps %%%d,%%%%xmm%d\n"
+			    "\tshufps $0,%%%%xmm%d,%%%%xmm%d\n", i+2, n, n, n);
+		else
+			vpr("\tmovd %%%d,%%%%xmm%d\n"
+			    "\tpshufd $0,%%%%xmm%d,%%%%xmm%d\n", i+2, n, n, n);
+	}
+
+	/* the vector loop */
+	vpr("1:\n");
+	for (ip = li->first; ip != end; ip = DLIST_NEXT(ip, qelem)) {
+		if (ip->type != IP_NODE)
+			continue;
+		p = ip->ip_node;
+		q = p->n_left;
+		if (q->n_op == UMUL) {
+			vgen(p->n_right, vs.nxmm);
+			vpr("\t%s %%%%xmm%d,(%%%d,%%0,%d)\n", vins(UMUL),
+			    vs.nxmm, vaddr(q->n_left) + 2, 1 << vs.sh);
+		} else if (p->n_right->n_op == PLUS) {
+			/* reduction */
+			r = vred(p);
+			i = vopnd(r);
+			p = p->n_right;
+			vgen(p->n_left == r ? p->n_right : p->n_left, vs.nxmm);
+			vpr("\tpaddd %%%%xmm%d,%%%%xmm%d\n", vs.nxmm, vs.xr[i]);
+		}
+	}
+	vpr("\taddq $%d,%%0\n\tleaq %d(%%0),%%%d\n", w, w, k);
+	vpr("\tcmpq %%1,%%%d\n\tjle 1b\n", k);
+
+	/* add up the sums */
+	for (i = 0; i < vs.narg; i++) {
+		if (vs.red[i] == 0)
+			continue;
+		n = vs.xr[i];
+		vpr("\tpshufd $0x4e,%%%%xmm%d,%%%%xmm%d\n", n, vs.nxmm);
+		vpr("\tpaddd %%%%xmm%d,%%%%xmm%d\n", vs.nxmm, n);
+		vpr("\tpshufd $0xb1,%%%%xmm%d,%%%%xmm%d\n", n, vs.nxmm);
+		vpr("\tpaddd %%%%xmm%d,%%%%xmm%d\n", vs.nxmm, n);
+		vpr("\tmovd %%%%xmm%d,%%k%d\n\taddl %%k%d,%%%d\n", n, k, k, i+2);
+	}
+	vpr("2:");
+	if (vs.bad || vs.maxr > 15)
+		return 0;
+
+	/*
+	 * All fine, build the asm statement.
+	 * Constants and array addresses are put in temporaries first.
+	 */
+	ip = li->at;
+#define	VTEMP(t) mklnode(TEMP, 0, p2e->epp->ip_tmpnum++, t)
+	jt = VTEMP(LONG);
+	mt = VTEMP(LONG);
+	gt = VTEMP(LONG);
+	q = tcopy(li->ind);
+	if (q->n_type != LONG)
+		q = mkunode(SCONV, q, 0, LONG);
+	ip = vput(ip, mkbinode(ASSIGN, tcopy(jt), q, LONG));
+	if ((q = tcopy(li->lim))->n_op == ICON)
+		q->n_type = LONG;
+	else if (q->n_type != LONG)
+		q = mkunode(SCONV, q, 0, LONG);
+	ip = vput(ip, mkbinode(ASSIGN, tcopy(mt), q, LONG));
+
+	p = mkunode(XARG, jt, 0, LONG);
+	p->n_name = "+r";
+	q = mkunode(XARG, mt, 0, LONG);
+	q->n_name = "r";
+	ops = mkbinode(CM, p, q, INT);
+	for (i = 0; i < vs.narg; i++) {
+		p = vs.arg[i];
+		if (p->n_op == TEMP) {
+			p = tcopy(p);
+		} else {
+			q = VTEMP(p->n_type);
+			ip = vput(ip, mkbinode(ASSIGN, tcopy(q), tcopy(p),
+			    p->n_type));
+			p = q;
+		}
+		p = mkunode(XARG, p, 0, p->n_type);
+		p->n_name = vs.red[i] ? "+r" : "r";
+		ops = mkbinode(CM, ops, p, INT);
+	}
+	p = mkunode(XARG, gt, 0, LONG);
+	p->n_name = "=&r";
+	ops = mkbinode(CM, ops, p, INT);
+
+	cl = mkunode(XARG, mklnode(ICON, 0, 0, INT), 0, INT);
+	cl->n_name = "memory";	/* stores through the array pointers */
+	for (i = VXMM; i <= vs.maxr; i++) {
+		p = mkunode(XARG, mklnode(ICON, 0, 0, INT), 0, INT);
+		p->n_name = rnames[XMM0+i];
+		cl = mkbinode(CM, cl, p, INT);
+	}
+	p = mkbinode(XASM, ops, cl, INT);
+	p->n_name = tmpstrdup(vs.buf + 1); /* genxasm adds a tab */
+	ip = vput(ip, p);
+
+	q = tcopy(jt);
+	if (li->ind->n_type != LONG)
+		q = mkunode(SCONV, q, 0, li->ind->n_type);
+	ip = vput(ip, mkbinode(ASSIGN, tcopy(li->ind), q, li->ind->n_type));
+	if (li->pre->last == li->at)
+		li->pre->last = ip;
+	return 1;
+}
+
 void
 rmove(int s, int d, TWORD t)
 {
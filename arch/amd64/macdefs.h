@@ -103,6 +103,7 @@ typedef long long OFFSZ;
 #define CONFMT	"%lld"		/* format for printing constants */
 #define LABFMT	".L%d"		/* format for printing labels */
 #define	STABLBL	".LL%d"		/* format for stab (debugging) labels */
+#define	DWARF_FPREG	6		/* DWARF number of %rbp */
 #ifdef LANG_F77
 #define BLANKCOMMON "_BLNK_"
 #define MSKIREG  (M(TYSHORT)|M(TYLONG))
@@ -227,6 +228,7 @@ int COLORMAP(int c, int *r);
 
 #define	RETREG(x)	(x == FLOAT || x == DOUBLE ? XMM0 : \
 			 x == LDOUBLE ? 32 : RAX)
+#define	PERMTYPE(x)	LONG	/* callee-saved regs are moved as 64 bits */
 
 /* XXX - to die */
 #define FPREG	RBP	/* frame pointer */
@@ -261,6 +263,13 @@ int numconv(void *ip, void *p, void *q);
 #define	XASM_NUMCONV(ip, p, q)	numconv(ip, p, q)
 #define	XASMCONSTREGS(x)	xasmconstregs(x)
 
+#define	MYVECTOR	/* simple loops may use packed SSE2 insns */
+
+#ifdef ELFABI
+#define	TARGET_OBJWRITE	/* ccom may write ELF objects itself */
+int elfasm(char *, char *);
+#endif
+
 #define	HAVE_WEAKREF
 #define TARGET_FLT_EVAL_METHOD	0	/* all as their type */
 /*
@@ -288,4 +297,4 @@ NODE *amd64_builtin_va_copy(const struct bitable *, NODE *a);
 #undef NODE
 
 /* target specific attributes */
-#define ATTR_MI_TARGET  ATTR_AMD64_CMPLRET, ATTR_AMD64_XORLBL
+#define ATTR_MI_TARGET  ATTR_AMD64_CMPLRET, ATTR_AMD64_XORLBL, ATTR_AMD64_FCON
@@ -826,7 +826,7 @@ myp2tree(NODE *p)
 	if ((p->n_op == STCALL || p->n_op == USTCALL) && 
 	    attr_find(p->n_ap, ATTR_COMPLEX) &&
 	    strmemb(p->n_ap)->stype == FLOAT)
-		p->n_ap = attr_add(p->n_ap, attr_new(ATTR_I386_FCMPLRET, 1));
+		p->n_ap = attr_add(p->n_ap, tattr_new(ATTR_I386_FCMPLRET, 1));
 
 	if (p->n_op != FCON)
 		return;
@@ -1286,7 +1286,7 @@ pass1_lastchance(struct interpass *ip)
 	    (ip->ip_node->n_op == CALL || ip->ip_node->n_op == UCALL) &&
 	    ISFTY(ip->ip_node->n_type))
 		ip->ip_node->n_ap = attr_add(ip->ip_node->n_ap,
-		    attr_new(ATTR_I386_FPPOP, 1));
+		    tattr_new(ATTR_I386_FPPOP, 1));
  
 	if (ip->type == IP_EPILOG) {
 		struct interpass_prolog *ipp = (struct interpass_prolog *)ip;
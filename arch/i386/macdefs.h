@@ -111,6 +111,7 @@ typedef long long OFFSZ;
 #if defined(ELFABI)
 #define LABFMT	".L%d"		/* format for printing labels */
 #define	STABLBL	".LL%d"		/* format for stab (debugging) labels */
+#define	DWARF_FPREG	5		/* DWARF number of %ebp */
 #else
 #define LABFMT	"L%d"		/* format for printing labels */
 #define	STABLBL	"LL%d"		/* format for stab (debugging) labels */
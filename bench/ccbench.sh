@@ -0,0 +1,145 @@
+#!/bin/sh
+#	$Id$
+#
+# Compile-time benchmark for pcc.
+#
+# usage: ccbench.sh [-n runs] [-s scale] [-w dir] [-B libexecdir]
+#	    [-c cc] [-o file]
+#	 ccbench.sh -d old new
+#
+# Generates the stress inputs from gen.sh in dir and times cpp, ccom
+# and the full driver (cpp, ccom and as through cc -c) on each one.
+# Times are the least user+system CPU time over runs.  The ccom -s
+# and cpp -V counters are recorded along with them.
+#
+# Results are lines of "input stage metric value", sorted, so two
+# runs can be compared with -d, which prints the change per metric
+# and the total time per stage.
+#
+
+usage()
+{
+	echo "usage: $0 [-n runs] [-s scale] [-w dir] [-B libexecdir]" \
+	    "[-c cc] [-o file]" >&2
+	echo "       $0 -d old new" >&2
+	exit 1
+}
+
+# compare two result files
+compare()
+{
+	awk '
+	/^#/ { next }
+	FNR == NR { old[$1 " " $2 " " $3] = $4; next }
+	{
+		k = $1 " " $2 " " $3
+		if (!(k in old))
+			next
+		o = old[k]; n = $4
+		if ($3 == "time") {
+			ot[$2] += o; nt[$2] += n
+		}
+		if (o == n)
+			next
+		if (o == 0)
+			printf "%-40s %12s %12s\n", k, o, n
+		else
+			printf "%-40s %12s %12s %+7.1f%%\n", k, o, n,
+			    (n - o) * 100 / o
+	}
+	END {
+		print ""
+		for (s in ot)
+			printf "%-40s %12.3f %12.3f %+7.1f%%\n", "total " s " time",
+			    ot[s], nt[s], ot[s] ? (nt[s] - ot[s]) * 100 / ot[s] : 0
+	}' "$1" "$2"
+}
+
+# print the least user+sys seconds used by "$@" in $RUNS runs
+cputime()
+{
+	i=0
+	while [ $i -lt $RUNS ]; do
+		( "$@" >/dev/null 2>&1 || echo fail; times )
+		i=$((i + 1))
+	done | awk '
+	/fail/ { f = 1 }
+	/m.*s .*m.*s/ && ++l % 2 == 0 {
+		split($1, u, /[ms]/); split($2, s, /[ms]/)
+		t = u[1] * 60 + u[2] + s[1] * 60 + s[2]
+		if (min == "" || t < min)
+			min = t
+	}
+	END { if (f) print "fail"; else printf "%.3f\n", min }'
+}
+
+# turn "Name of counter:   123 pcs" lines into "name_of_counter 123"
+counters()
+{
+	sed -n 's/^\([A-Za-z][A-Za-z /-]*\):[ 	]*\([0-9][0-9]*\).*/\1 \2/p' |
+	    awk '{ v = $NF; $NF = ""; n = tolower($0); gsub(/[ \/-]+$/, "", n);
+		gsub(/[ \/-]+/, "_", n); print n, v }'
+}
+
+RUNS=3
+SCALE=1
+W=
+LIBEXEC=/usr/local/libexec
+PCC=pcc
+OUT=
+while getopts n:s:w:B:c:o:d ch; do
+	case $ch in
+	n) RUNS=$OPTARG ;;
+	s) SCALE=$OPTARG ;;
+	w) W=$OPTARG ;;
+	B) LIBEXEC=$OPTARG ;;
+	c) PCC=$OPTARG ;;
+	o) OUT=$OPTARG ;;
+	d) DIFF=1 ;;
+	*) usage ;;
+	esac
+done
+shift $((OPTIND - 1))
+
+if [ -n "$DIFF" ]; then
+	[ $# -eq 2 ] || usage
+	compare "$1" "$2"
+	exit 0
+fi
+[ $# -eq 0 ] || usage
+
+CPP=$LIBEXEC/cpp
+CCOM=$LIBEXEC/ccom
+for p in "$CPP" "$CCOM"; do
+	[ -x "$p" ] || { echo "$0: $p: not found" >&2; exit 1; }
+done
+if [ -z "$W" ]; then
+	W=${TMPDIR:-/tmp}/ccbench.$$
+	trap 'rm -rf "$W"' 0 1 2 15
+fi
+sh "$(dirname "$0")/gen.sh" "$W" "$SCALE" || exit 1
+
+{
+	echo "# ccbench runs $RUNS scale $SCALE $(uname -sm)"
+	echo "# cpp $CPP ccom $CCOM cc $PCC"
+	for f in "$W"/*.c; do
+		b=$(basename "$f" .c)
+		flags=$(cat "$W/$b.flags")
+		# $flags is split on purpose
+		if ! $CPP $flags "$f" "$W/$b.i" 2>"$W/$b.err"; then
+			echo "$0: cpp failed on $b:" >&2
+			cat "$W/$b.err" >&2
+			continue
+		fi
+		echo "$b cpp time $(cputime $CPP $flags "$f" /dev/null)"
+		$CPP -V $flags "$f" /dev/null 2>&1 | counters |
+		    sed "s/^/$b cpp /"
+		echo "$b cpp bytes $(wc -c < "$W/$b.i" | tr -d ' ')"
+		echo "$b ccom time $(cputime $CCOM "$W/$b.i" /dev/null)"
+		$CCOM -s "$W/$b.i" "$W/$b.s" 2>&1 | counters |
+		    sed "s/^/$b ccom /"
+		echo "$b ccom bytes $(wc -c < "$W/$b.s" | tr -d ' ')"
+		echo "$b cc time" \
+		    "$(cputime $PCC -B"$LIBEXEC/" $flags -c -o "$W/$b.o" "$f")"
+	done | sort
+} > "${OUT:-/dev/stdout}"
@@ -0,0 +1,58 @@
+/*	$Id$	*/
+/*
+ * Floating-point loops: dot products, a matrix multiply and a
+ * polynomial evaluation in float and double.
+ */
+
+int printf(const char *, ...);
+
+#define	N	96
+
+static double ma[N][N], mb[N][N], mc[N][N];
+static float fv[4096];
+
+static void
+matmul(void)
+{
+	double s;
+	int i, j, k;
+
+	for (i = 0; i < N; i++)
+		for (j = 0; j < N; j++) {
+			s = 0;
+			for (k = 0; k < N; k++)
+				s += ma[i][k] * mb[k][j];
+			mc[i][j] = s;
+		}
+}
+
+static float
+poly(float x)
+{
+	return ((((0.5f * x + 1.25f) * x - 3.0f) * x + 0.125f) * x) + 7.0f;
+}
+
+int
+main(void)
+{
+	double d = 0;
+	float f = 0;
+	int i, j, r;
+
+	for (i = 0; i < N; i++)
+		for (j = 0; j < N; j++) {
+			ma[i][j] = (i + j) * 0.01;
+			mb[i][j] = (i - j) * 0.02;
+		}
+	for (i = 0; i < 4096; i++)
+		fv[i] = i * 0.001f;
+	for (r = 0; r < 20; r++) {
+		matmul();
+		d += mc[r][r];
+		for (j = 0; j < 200; j++)
+			for (i = 0; i < 4096; i++)
+				f += poly(fv[i]) * 1e-6f;
+	}
+	printf("%.6g %.4g\n", d, (double)f);
+	return 0;
+}
@@ -0,0 +1,71 @@
+/*	$Id$	*/
+/*
+ * Integer hashing: FNV-1a, a multiplicative mixer and an open
+ * addressing table insert/lookup loop.
+ */
+
+int printf(const char *, ...);
+
+#define	TABSZ	(1 << 16)
+
+static unsigned int tab[TABSZ];
+
+static unsigned int
+fnv(unsigned int x)
+{
+	unsigned int h = 2166136261U;
+	int i;
+
+	for (i = 0; i < 4; i++) {
+		h ^= x & 0377;
+		h *= 16777619U;
+		x >>= 8;
+	}
+	return h;
+}
+
+static unsigned long
+mix(unsigned long x)
+{
+	x ^= x >> 33;
+	x *= 0xff51afd7ed558ccdUL;
+	x ^= x >> 33;
+	x *= 0xc4ceb9fe1a85ec53UL;
+	x ^= x >> 33;
+	return x;
+}
+
+static int
+insert(unsigned int k)
+{
+	unsigned int i = fnv(k) & (TABSZ-1);
+
+	while (tab[i] != 0) {
+		if (tab[i] == k)
+			return 0;
+		i = (i + 1) & (TABSZ-1);
+	}
+	tab[i] = k;
+	return 1;
+}
+
+int
+main(void)
+{
+	unsigned long s = 0;
+	unsigned int k;
+	int r, n;
+
+	for (r = 0; r < 40; r++) {
+		for (k = 0; k < TABSZ; k++)
+			tab[k] = 0;
+		n = 0;
+		for (k = 1; k < TABSZ/2; k++)
+			n += insert((unsigned int)mix(k + r) | 1);
+		s += n;
+		for (k = 1; k < 200000; k++)
+			s += mix(k ^ s) >> 40;
+	}
+	printf("%lu\n", s);
+	return 0;
+}
@@ -0,0 +1,55 @@
+/*	$Id$	*/
+/*
+ * Switch-dispatch bytecode interpreter running a small loop program.
+ */
+
+int printf(const char *, ...);
+
+enum { PUSH, LOAD, STORE, ADD, SUB, MUL, AND, XOR, SHR, JNZ, DUP,
+	POP, SWAP, HALT };
+
+static long mem[16];
+
+static long
+run(const int *pc0)
+{
+	long st[64], *sp = st, t;
+	const int *pc = pc0;
+
+	for (;;) {
+		switch (*pc++) {
+		case PUSH: *sp++ = *pc++; break;
+		case LOAD: *sp++ = mem[*pc++]; break;
+		case STORE: mem[*pc++] = *--sp; break;
+		case ADD: sp--; sp[-1] += sp[0]; break;
+		case SUB: sp--; sp[-1] -= sp[0]; break;
+		case MUL: sp--; sp[-1] *= sp[0]; break;
+		case AND: sp--; sp[-1] &= sp[0]; break;
+		case XOR: sp--; sp[-1] ^= sp[0]; break;
+		case SHR: sp--; sp[-1] >>= sp[0]; break;
+		case JNZ: if (*--sp) pc = pc0 + *pc; else pc++; break;
+		case DUP: sp[0] = sp[-1]; sp++; break;
+		case POP: sp--; break;
+		case SWAP: t = sp[-1]; sp[-1] = sp[-2]; sp[-2] = t; break;
+		case HALT: return mem[1];
+		}
+	}
+}
+
+/* mem[0] counts down, mem[1] accumulates a hash */
+static const int prog[] = {
+	PUSH, 5000000, STORE, 0,
+	PUSH, 1, STORE, 1,
+/* 8 */	LOAD, 1, PUSH, 31, MUL, LOAD, 0, XOR, PUSH, 1048575, AND,
+	LOAD, 1, PUSH, 3, SHR, ADD, STORE, 1,
+	LOAD, 0, PUSH, 1, SUB, DUP, STORE, 0,
+	JNZ, 8,
+	HALT
+};
+
+int
+main(void)
+{
+	printf("%ld\n", run(prog));
+	return 0;
+}
@@ -0,0 +1,63 @@
+/*	$Id$	*/
+/*
+ * Recursive calls: fib, ackermann and a recursive quicksort.
+ */
+
+int printf(const char *, ...);
+
+static int
+fib(int n)
+{
+	return n < 2 ? n : fib(n - 1) + fib(n - 2);
+}
+
+static int
+ack(int m, int n)
+{
+	if (m == 0)
+		return n + 1;
+	if (n == 0)
+		return ack(m - 1, 1);
+	return ack(m - 1, ack(m, n - 1));
+}
+
+static void
+qsrt(int *a, int l, int r)
+{
+	int i = l, j = r, p = a[(l + r) / 2], t;
+
+	while (i <= j) {
+		while (a[i] < p)
+			i++;
+		while (a[j] > p)
+			j--;
+		if (i <= j) {
+			t = a[i], a[i] = a[j], a[j] = t;
+			i++, j--;
+		}
+	}
+	if (l < j)
+		qsrt(a, l, j);
+	if (i < r)
+		qsrt(a, i, r);
+}
+
+static int arr[100000];
+
+int
+main(void)
+{
+	unsigned int x = 1;
+	long s;
+	int i, r;
+
+	s = fib(30) + ack(2, 2000) + ack(3, 7);
+	for (r = 0; r < 5; r++) {
+		for (i = 0; i < 100000; i++)
+			arr[i] = (int)((x = x * 1103515245U + 12345U) >> 8);
+		qsrt(arr, 0, 99999);
+		s += arr[r * 1000];
+	}
+	printf("%ld\n", s);
+	return 0;
+}
@@ -0,0 +1,55 @@
+/*	$Id$	*/
+/*
+ * memcpy-heavy struct code: struct assignment, structs passed and
+ * returned by value and explicit memcpy of records.
+ */
+
+int printf(const char *, ...);
+void *memcpy(void *, const void *, unsigned long);
+
+struct rec {
+	int id;
+	short kind;
+	char name[22];
+	double w;
+	long v[4];
+};
+
+#define	NREC	1024
+
+static struct rec a[NREC], b[NREC];
+
+static struct rec
+upd(struct rec r, int i)
+{
+	r.id += i;
+	r.kind = (short)(r.kind ^ i);
+	r.name[i % 22] = (char)i;
+	r.w = r.w * 0.5 + i;
+	r.v[i & 3] += r.id;
+	return r;
+}
+
+int
+main(void)
+{
+	struct rec t;
+	long s = 0;
+	int i, j;
+
+	for (i = 0; i < NREC; i++) {
+		a[i].id = i;
+		a[i].kind = (short)i;
+		a[i].w = i;
+	}
+	for (j = 0; j < 4000; j++) {
+		for (i = 0; i < NREC; i++) {
+			t = a[i];
+			b[(i + j) % NREC] = upd(t, j);
+		}
+		memcpy(a, b, sizeof(a));
+		s += a[j % NREC].id + a[j % NREC].v[j & 3];
+	}
+	printf("%ld %d\n", s, (int)a[7].w);
+	return 0;
+}
@@ -0,0 +1,143 @@
+#!/bin/sh
+#	$Id$
+#
+# Generated-code benchmark for pcc.
+#
+# usage: codebench.sh [-n runs] [-B libexecdir] [-c cc] [-l linkcc]
+#	    [-r refcc] [-x "flags ..."] [-w dir] [-o file]
+#	 codebench.sh -d old new
+#
+# Compiles each kernel in code/ with cc -S once per flag set, links
+# it with linkcc (default cc) and times the program.  Times are the
+# least user+system CPU time over runs.  Instructions are counted per
+# function from the .s output.  Program output is checked against
+# refcc (or, without -r, against the first flag set).
+#
+# The flag sets are separated by spaces, commas join flags within a
+# set and "none" is the empty set; the default is
+#	none -xtemps -xdeljumps -xinline -xssa -O
+#
+# Results are lines of "kernel flags metric value", the same format
+# as ccbench.sh, and -d compares two of them the same way.
+#
+
+usage()
+{
+	echo "usage: $0 [-n runs] [-B libexecdir] [-c cc] [-l linkcc]" \
+	    "[-r refcc] [-x \"flags ...\"] [-w dir] [-o file]" >&2
+	echo "       $0 -d old new" >&2
+	exit 1
+}
+
+# print the least user+sys seconds used by "$@" in $RUNS runs
+cputime()
+{
+	i=0
+	while [ $i -lt $RUNS ]; do
+		( "$@" >/dev/null 2>&1 || echo fail; times )
+		i=$((i + 1))
+	done | awk '
+	/fail/ { f = 1 }
+	/m.*s .*m.*s/ && ++l % 2 == 0 {
+		split($1, u, /[ms]/); split($2, s, /[ms]/)
+		t = u[1] * 60 + u[2] + s[1] * 60 + s[2]
+		if (min == "" || t < min)
+			min = t
+	}
+	END { if (f) print "fail"; else printf "%.3f\n", min }'
+}
+
+# count instructions per function in an assembler file
+insns()
+{
+	awk '
+	# functions are those with a ".size f,.-f", static ones have no .type
+	FNR == NR {
+		if ($1 == ".size" && $2 ~ /,\.-/) {
+			split($2, a, ","); isfn[a[1]] = 1
+		}
+		next
+	}
+	/^[A-Za-z_.$][A-Za-z0-9_.$]*:/ {
+		l = substr($1, 1, index($1, ":") - 1)
+		if (l in isfn)
+			fn = l
+		next
+	}
+	/^[ \t]*\.size[ \t]/ { fn = ""; next }
+	/^[ \t]+[a-z]/ && fn != "" { n[fn]++; tot++ }
+	END {
+		print "insns", tot + 0
+		for (f in n)
+			print "insns." f, n[f]
+	}' "$1" "$1"
+}
+
+D=$(dirname "$0")
+RUNS=3
+LIBEXEC=/usr/local/libexec
+PCC=pcc
+LINK=
+REF=
+SETS="none -xtemps -xdeljumps -xinline -xssa -O"
+W=
+OUT=
+while getopts n:B:c:l:r:x:w:o:d ch; do
+	case $ch in
+	n) RUNS=$OPTARG ;;
+	B) LIBEXEC=$OPTARG ;;
+	c) PCC=$OPTARG ;;
+	l) LINK=$OPTARG ;;
+	r) REF=$OPTARG ;;
+	x) SETS=$OPTARG ;;
+	w) W=$OPTARG ;;
+	o) OUT=$OPTARG ;;
+	d) DIFF=1 ;;
+	*) usage ;;
+	esac
+done
+shift $((OPTIND - 1))
+
+if [ -n "$DIFF" ]; then
+	[ $# -eq 2 ] || usage
+	exec sh "$D/ccbench.sh" -d "$1" "$2"
+fi
+[ $# -eq 0 ] || usage
+
+LINK=${LINK:-$PCC}
+if [ -z "$W" ]; then
+	W=${TMPDIR:-/tmp}/codebench.$$
+	trap 'rm -rf "$W"' 0 1 2 15
+fi
+mkdir -p "$W" || exit 1
+
+{
+	echo "# codebench runs $RUNS $(uname -sm)"
+	echo "# cc $PCC -B$LIBEXEC/ link $LINK ref ${REF:-first set}"
+	for f in "$D"/code/*.c; do
+		k=$(basename "$f" .c)
+		rm -f "$W/$k.ref"
+		if [ -n "$REF" ]; then
+			# $REF and $LINK are split on purpose
+			$REF -o "$W/$k.rx" "$f" && "$W/$k.rx" > "$W/$k.ref"
+		fi
+		for set in $SETS; do
+			flags=$(echo "$set" | sed 's/^none$//; s/,/ /g')
+			if ! $PCC -B"$LIBEXEC/" $flags -S -o "$W/$k.s" "$f" ||
+			    ! $LINK -o "$W/$k" "$W/$k.s"; then
+				echo "$0: $k $set: compile failed" >&2
+				echo "$k $set status fail"
+				continue
+			fi
+			"$W/$k" > "$W/$k.out"
+			[ -f "$W/$k.ref" ] || cp "$W/$k.out" "$W/$k.ref"
+			if ! cmp -s "$W/$k.out" "$W/$k.ref"; then
+				echo "$0: $k $set: wrong output" >&2
+				echo "$k $set status wrong"
+				continue
+			fi
+			echo "$k $set time $(cputime "$W/$k")"
+			insns "$W/$k.s" | sed "s/^/$k $set /"
+		done
+	done | sort
+} > "${OUT:-/dev/stdout}"
@@ -0,0 +1,143 @@
+#!/bin/sh
+#	$Id$
+#
+# Generate synthetic stress inputs for ccbench.sh.
+#
+# usage: gen.sh dir [scale]
+#
+# Each input is a self-contained C file (no system headers); extra
+# preprocessor flags it needs are written to a .flags file next to it.
+# The output depends only on scale, so runs are comparable.
+#
+#	macro.c		deep macro nesting (cpp kfind/submac)
+#	func.c		very large functions (ccom ngenregs)
+#	switch.c	huge switches (ccom genswitch)
+#	init.c		megabyte initializers (ccom endinit)
+#	incl.c		long include chains over many -I dirs (cpp fsrch)
+#
+
+if [ $# -lt 1 ] || [ $# -gt 2 ]; then
+	echo "usage: $0 dir [scale]" >&2
+	exit 1
+fi
+D=$1
+S=${2:-1}
+mkdir -p "$D" || exit 1
+
+# deep macro nesting: chains of object- and function-like macros,
+# each level expanding the one below it.
+awk -v s="$S" 'BEGIN {
+	n = 200 * s
+	print "#define A0 1"
+	for (i = 1; i < n; i++)
+		printf "#define A%d (A%d+%d)\n", i, i-1, i
+	print "#define F0(x) (x)"
+	for (i = 1; i < n; i++)
+		printf "#define F%d(x) F%d((x)+%d)\n", i, i-1, i
+	print "#define CAT(a,b) a ## b"
+	print "#define XCAT(a,b) CAT(a,b)"
+	print "#define STR(x) #x"
+	print "#define XSTR(x) STR(x)"
+	for (i = 0; i < 100 * s; i++) {
+		printf "int a%d = A%d;\n", i, n - 1 - i % 50
+		printf "int XCAT(f, %d) = F%d(%d);\n", i, n - 1 - i % 50, i
+		printf "char *s%d = XSTR(F%d(%d));\n", i, 20 + i % 10, i
+	}
+}' > "$D/macro.c"
+: > "$D/macro.flags"
+
+# very large functions: many live locals, long expression chains
+awk -v s="$S" 'BEGIN {
+	nv = 200
+	for (f = 0; f < 4 * s; f++) {
+		printf "int\nbig%d(int *p, int n)\n{\n", f
+		for (i = 0; i < nv; i++)
+			printf "\tint v%d = p[%d];\n", i, i
+		print "\tint i;\n\tfor (i = 0; i < n; i++) {"
+		for (i = 0; i < 2000; i++)
+			printf "\t\tv%d = v%d * %d + (v%d ^ v%d) - (v%d >> %d);\n",
+			    i % nv, (i * 7 + 1) % nv, i % 13 + 1,
+			    (i * 3 + 2) % nv, (i * 11 + 5) % nv,
+			    (i * 17 + 3) % nv, i % 5
+		print "\t}"
+		printf "\treturn v0"
+		for (i = 1; i < nv; i++)
+			printf " + v%d", i
+		print ";\n}\n"
+	}
+}' > "$D/func.c"
+: > "$D/func.flags"
+
+# huge switches: a dense one, a sparse one and one with ranges of
+# shared bodies
+awk -v s="$S" 'BEGIN {
+	n = 5000 * s
+	print "int\ndense(int c)\n{\n\tswitch (c) {"
+	for (i = 0; i < n; i++)
+		printf "\tcase %d: return %d;\n", i, (i * 31) % 1000
+	print "\tdefault: return -1;\n\t}\n}\n"
+	print "long\nsparse(long c)\n{\n\tswitch (c) {"
+	for (i = 0; i < n; i++)
+		printf "\tcase %dL: return %d;\n", i * 1009 + (i % 7) * 100003, i
+	print "\tdefault: return -1;\n\t}\n}\n"
+	print "int\nshared(unsigned c)\n{\n\tint r = 0;\n\tswitch (c) {"
+	for (i = 0; i < n; i++) {
+		printf "\tcase %d:\n", i * 3
+		if (i % 4 == 3)
+			printf "\t\tr += %d;\n\t\tbreak;\n", i
+	}
+	print "\tdefault: r = -1;\n\t}\n\treturn r;\n}"
+}' > "$D/switch.c"
+: > "$D/switch.flags"
+
+# megabyte initializers: scalar arrays, a struct array and strings
+awk -v s="$S" 'BEGIN {
+	n = 65536 * s
+	printf "int itab[%d] = {\n", n
+	for (i = 0; i < n; i += 8) {
+		printf "\t"
+		for (j = i; j < i + 8; j++)
+			printf "%d, ", (j * 2654435761) % 2147483647
+		print ""
+	}
+	print "};\n"
+	print "struct ent { char *name; int id; short s[3]; double d; };"
+	printf "struct ent etab[] = {\n"
+	for (i = 0; i < n / 8; i++)
+		printf "\t{ \"name%d\", %d, { %d, %d, %d }, %d.5 },\n",
+		    i, i, i % 100, i % 7, -i % 300, i
+	print "};\n"
+	printf "char ctab[][16] = {\n"
+	for (i = 0; i < n / 8; i++)
+		printf "\t\"str%d\",\n", i
+	print "};"
+}' > "$D/init.c"
+: > "$D/init.flags"
+
+# long include chains: header k lives in directory k % nd and
+# includes header k+1 with <>, so each step searches the -I list.
+# Chains are nc long to stay below the nesting limit.
+rm -rf "$D/inc"
+awk -v s="$S" -v d="$D" 'BEGIN {
+	nd = 100
+	nc = 50
+	nh = 2000 * s
+	for (i = 0; i < nd; i++) {
+		system("mkdir -p " d "/inc/d" i)
+		flags = flags " -I" d "/inc/d" i
+	}
+	print flags > (d "/incl.flags")
+	for (i = 0; i < nh; i++) {
+		f = d "/inc/d" (i % nd) "/h" i ".h"
+		printf "#ifndef H%d\n#define H%d\n", i, i > f
+		printf "int h%d(int);\n", i > f
+		if ((i + 1) % nc)
+			printf "#include <h%d.h>\n", i + 1 > f
+		print "#endif" > f
+		close(f)
+	}
+	c = d "/incl.c"
+	for (i = 0; i < nh; i += nc)
+		printf "#include <h%d.h>\n#include <h%d.h>\n", i, i > c
+	print "int incl(void) { return h0(1); }" > c
+}'
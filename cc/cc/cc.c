@@ -101,6 +101,14 @@
 #endif
 #include <assert.h>
 
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#define	CCSERVER	/* may hand compiles to a ccom -xserver= */
+#define	CCCACHE		/* may reuse output from a PCC_CACHE directory */
+#endif
+
 #ifdef  _WIN32
 #include <windows.h>
 #include <process.h>
@@ -240,12 +248,30 @@ char *defcxxlibs[] = DEFCXXLIBS;
 char	*outfile, *MFfile, *fname;
 static char **lav;
 static int lac;
+static char *errcopy;	/* compiler stderr goes here too, for the cache */
 static char *find_file(const char *file, struct strlist *path, int mode);
 static int preprocess_input(char *input, char *output, int dodep);
-static int compile_input(char *input, char *output);
+static int compile_input(char *input, char *output, char *objfile);
 static int assemble_input(char *input, char *output);
 static int run_linker(void);
 static int strlist_exec(struct strlist *l);
+#ifndef _WIN32
+static int copyfd(char *from, int ofd);
+#endif
+#ifdef CCSERVER
+static int server_compile(char *, struct strlist *, char *, char *, char *);
+#endif
+#ifdef CCCACHE
+static char *cache_key(char *input, int mode);
+static int cache_get(char *key, char *output);
+static void cache_put(char *key, char *input, char *errf);
+static int cache_stats(void);
+#else
+#define	cache_key(i, m)	NULL
+#define	cache_get(k, o)	0
+#define	cache_put(k, i, e)
+#define	cache_stats()	0
+#endif
 
 char *cat(const char *, const char *);
 char *setsuf(char *, char);
@@ -272,10 +298,12 @@ char *win32pathsubst(char *);
 char *win32commandline(struct strlist *l);
 #endif
 int	sspflag;
+int	iasflag;	/* let ccom write the object itself */
 int	freestanding;
 int	Sflag;
 int	cflag;
 int	gflag;
+int	dwarfflag;	/* -gdwarf */
 int	rflag;
 int	vflag;
 int	noexec;	/* -### */
@@ -300,7 +328,7 @@ int	xuchar = 0;
 #endif
 int	cxxflag;
 int	cppflag;
-int	printprogname, printfilename;
+int	printprogname, printfilename, printcache;
 
 #ifdef SOFTFLOAT
 int	softfloat = 1;
@@ -592,6 +620,8 @@ main(int argc, char *argv[])
 			} else if (match(u, "stack-protector") ||
 			    match(u, "stack-protector-all")) {
 				sspflag = j ? 0 : 1;
+			} else if (match(u, "integrated-as")) {
+				iasflag = j ? 0 : 1;
 			}
 			/* silently ignore the rest */
 			break;
@@ -601,6 +631,10 @@ main(int argc, char *argv[])
 				gflag = 0;
 			else
 				gflag++;
+			if (strncmp(argp, "-gdwarf", 7) == 0)
+				dwarfflag = !cxxflag;
+			else if (strncmp(argp, "-gstabs", 7) == 0)
+				dwarfflag = 0;
 			break;
 
 
@@ -721,6 +755,8 @@ main(int argc, char *argv[])
 			} else if (match(argp, "-print-libgcc-file-name")) {
 				fname = "libpcc.a";
 				printfilename = 1;
+			} else if (match(argp, "-print-cache-stats")) {
+				printcache = 1;
 			} else
 				oerror(argp);
 			break;
@@ -906,7 +942,7 @@ main(int argc, char *argv[])
 			ninput--;
 		}
 	}
-	if (ninput == 0 && !(printprogname || printfilename))
+	if (ninput == 0 && !(printprogname || printfilename || printcache))
 		errorx(8, "no input files");
 	if (outfile && (cflag || Sflag || Eflag) && ninput > 1)
 		errorx(8, "-o given with -c || -E || -S and more than one file");
@@ -948,12 +984,13 @@ main(int argc, char *argv[])
 	} else if (printfilename) {
 		printf("%s\n", find_file(fname, &crtdirs, R_OK));
 		return 0;
-	}
+	} else if (printcache)
+		return cache_stats();
 
 	msuffix = NULL;
 	STRLIST_FOREACH(s, &inputs) {
 		char *suffix;
-		char *ifile, *ofile = NULL;
+		char *ifile, *ofile = NULL, *objfile = NULL, *ckey, *ckerr;
 
 		ifile = s->value;
 		if (ifile[0] == ')') { /* -x source type given */
@@ -1003,6 +1040,37 @@ main(int argc, char *argv[])
 			suffix = match(suffix, "S") ? "s" : "i";
 		}
 
+		/*
+		 * Compile cache, keyed on the preprocessed input
+		 */
+		ckey = ckerr = NULL;
+		if (match(suffix, "i")) {
+			int mode = Sflag ? 'S' : 'o';
+
+#ifdef TARGET_OBJWRITE
+			if (iasflag && !Sflag && !cxxflag && !gflag &&
+			    !amd64_i386)
+				mode = 'O';
+#endif
+			ckey = cache_key(ifile, mode);
+		}
+		if (ckey) {
+			if (Sflag || cflag) {
+				ofile = outfile;
+				if (ofile == NULL)
+					ofile = setsuf(s->value, Sflag ? 's' : 'o');
+			} else
+				strlist_append(&temp_outputs, ofile = gettmp());
+			if (cache_get(ckey, ofile)) {
+				free(ckey);
+				ckey = NULL;
+				if (Sflag)
+					continue;
+				ifile = ofile;
+				suffix = "o";
+			}
+		}
+
 		/*
 		 * C compiler
 		 */
@@ -1014,12 +1082,36 @@ main(int argc, char *argv[])
 					ofile = setsuf(s->value, 's');
 			} else
 				strlist_append(&temp_outputs, ofile = gettmp());
-			if (compile_input(ifile, ofile))
+#ifdef TARGET_OBJWRITE
+			if (iasflag && !Sflag && !cxxflag && !gflag && !amd64_i386) {
+				if (cflag) {
+					objfile = outfile;
+					if (objfile == NULL)
+						objfile = setsuf(s->value, 'o');
+				} else
+					strlist_append(&temp_outputs,
+					    objfile = gettmp());
+				(void)unlink(objfile);
+			}
+#endif
+			if (ckey)
+				strlist_append(&temp_outputs,
+				    errcopy = ckerr = gettmp());
+			if (compile_input(ifile, ofile, objfile))
 				exandrm(ofile);
-			if (Sflag)
+			errcopy = NULL;
+			if (Sflag) {
+				if (ckey)
+					cache_put(ckey, ofile, ckerr);
 				continue;
+			}
 			ifile = ofile;
 			suffix = "s";
+			/* no object means ccom could not assemble; use as(1) */
+			if (objfile && access(objfile, F_OK) == 0) {
+				ifile = ofile = objfile;
+				suffix = "o";
+			}
 		}
 
 		/*
@@ -1038,6 +1130,10 @@ main(int argc, char *argv[])
 				exandrm(ofile);
 			ifile = ofile;
 		}
+		if (ckey) {
+			cache_put(ckey, ifile, ckerr);
+			free(ckey);
+		}
 
 		if (ninput > 1 && !Eflag && ifile == ofile && ifile[0] != '-')
 			printf("%s:\n", ifile);
@@ -1154,13 +1250,22 @@ find_file(const char *file, struct strlist *path, int mode)
 }
 
 static int
-compile_input(char *input, char *output)
+compile_input(char *input, char *output, char *objfile)
 {
 	struct strlist args;
 	int retval;
 
+#ifdef CCSERVER
+	if (!cxxflag && (retval = server_compile(find_file(pass0,
+	    &progdirs, X_OK), &compiler_flags, objfile, input, output)) >= 0)
+		return retval;
+#endif
 	strlist_init(&args);
 	strlist_append_list(&args, &compiler_flags);
+	if (objfile) {
+		strlist_append(&args, "-o");
+		strlist_append(&args, objfile);
+	}
 	strlist_append(&args, input);
 	strlist_append(&args, output);
 	strlist_prepend(&args,
@@ -1367,6 +1472,25 @@ strlist_exec(struct strlist *l)
 
 #else
 
+/*
+ * Write the contents of file from to ofd.
+ */
+static int
+copyfd(char *from, int ofd)
+{
+	char buf[BUFSIZ];
+	ssize_t n;
+	int ifd;
+
+	if ((ifd = open(from, O_RDONLY)) < 0)
+		return -1;
+	while ((n = read(ifd, buf, sizeof(buf))) > 0)
+		if (write(ofd, buf, n) != n)
+			break;
+	close(ifd);
+	return n == 0 ? 0 : -1;
+}
+
 static int
 strlist_exec(struct strlist *l)
 {
@@ -1387,6 +1511,8 @@ strlist_exec(struct strlist *l)
 
 	switch ((child = fork())) {
 	case 0:
+		if (errcopy && (result = open(errcopy, O_WRONLY|O_APPEND)) >= 0)
+			dup2(result, STDERR_FILENO), close(result);
 		execvp(argv[0], argv);
 		result = write(STDERR_FILENO, "Exec of ", 8);
 		result = write(STDERR_FILENO, argv[0], strlen(argv[0]));
@@ -1398,6 +1524,8 @@ strlist_exec(struct strlist *l)
 	default:
 		while (waitpid(child, &result, 0) == -1 && errno == EINTR)
 			/* nothing */(void)0;
+		if (errcopy)
+			(void)copyfd(errcopy, STDERR_FILENO);
 		result = WEXITSTATUS(result);
 		if (result)
 			errorx(1, "%s terminated with status %d", argv[0], result);
@@ -1409,6 +1537,375 @@ strlist_exec(struct strlist *l)
 	return exit_now;
 }
 
+#ifdef CCSERVER
+/*
+ * If PCC_SERVER names a directory, send the compile to a ccom started
+ * there with -xserver= and the same flags, starting one for later use
+ * if there is none.  Returns -1 if the job must be run the usual way.
+ * See ccom main.c for the protocol.
+ */
+static int
+server_compile(char *prog, struct strlist *flags, char *obj,
+    char *input, char *output)
+{
+	struct sockaddr_un su;
+	struct strlist args;
+	struct string *s;
+	struct stat sb;
+	char *dir, *buf, cwd[1024], nb[12], ident[64];
+	unsigned long h;
+	size_t len, sz;
+	ssize_t n;
+	int fd, cnt, st;
+	const char *p;
+
+	if ((dir = getenv("PCC_SERVER")) == NULL || noexec ||
+	    strcmp(input, "-") == 0 || strcmp(output, "-") == 0 ||
+	    getcwd(cwd, sizeof(cwd)) == NULL)
+		return -1;
+
+	/* one server per compiler, its build and flag set */
+	ident[0] = 0;
+	if (stat(prog, &sb) == 0)
+		snprintf(ident, sizeof(ident), "%lld:%lld",
+		    (long long)sb.st_size, (long long)sb.st_mtime);
+	h = 2166136261UL;
+	for (p = prog; *p; p++)
+		h = ((h ^ (unsigned char)*p) * 16777619UL) & 0xffffffffUL;
+	for (p = ident; *p; p++)
+		h = ((h ^ (unsigned char)*p) * 16777619UL) & 0xffffffffUL;
+	cnt = 4;
+	STRLIST_FOREACH(s, flags) {
+		for (p = s->value; *p; p++)
+			h = ((h ^ (unsigned char)*p) * 16777619UL) &
+			    0xffffffffUL;
+		h = (h * 16777619UL) & 0xffffffffUL;
+		cnt++;
+	}
+	/* in a directory of our own that nobody else may write to */
+	memset(&su, 0, sizeof(su));
+	su.sun_family = AF_UNIX;
+	if ((size_t)snprintf(su.sun_path, sizeof(su.sun_path), "%s/pcc-%lu",
+	    dir, (unsigned long)geteuid()) >= sizeof(su.sun_path))
+		return -1;
+	(void)mkdir(su.sun_path, 0700);
+	if (lstat(su.sun_path, &sb) < 0 || !S_ISDIR(sb.st_mode) ||
+	    sb.st_uid != geteuid() || (sb.st_mode & (S_IWGRP|S_IWOTH)) != 0)
+		return -1;
+	len = strlen(su.sun_path);
+	if ((size_t)snprintf(su.sun_path + len, sizeof(su.sun_path) - len,
+	    "/ccom-%08lx", h) >= sizeof(su.sun_path) - len)
+		return -1;
+
+	if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+		return -1;
+	if (connect(fd, (struct sockaddr *)&su, sizeof(su)) < 0) {
+		close(fd);
+		/* start a server, detached, for the next compile */
+		strlist_init(&args);
+		strlist_append_list(&args, flags);
+		strlist_prepend(&args, cat("-xserver=", su.sun_path));
+		strlist_prepend(&args, prog);
+		if (vflag) {
+			printf("Starting ");
+			strlist_print(&args, stdout, 0);
+			printf("\n");
+		}
+		switch (fork()) {
+		case 0:
+			if (fork() == 0) {
+				char **av;
+				size_t ac;
+
+				setsid();
+				if ((fd = open("/dev/null", O_RDWR)) >= 0) {
+					dup2(fd, 0), dup2(fd, 1), dup2(fd, 2);
+					if (fd > 2)
+						close(fd);
+				}
+				strlist_make_array(&args, &av, &ac);
+				execv(av[0], av);
+			}
+			_exit(0);
+		case -1:
+			break;
+		default:
+			(void)wait(NULL);
+		}
+		strlist_free(&args);
+		return -1;
+	}
+
+	/* only trust a server of ours */
+	if (lstat(su.sun_path, &sb) < 0 || !S_ISSOCK(sb.st_mode) ||
+	    sb.st_uid != geteuid()) {
+		close(fd);
+		return -1;
+	}
+
+	/* send the job */
+	len = sz = 0;
+	buf = NULL;
+#define	SRVADD(str) do {						\
+	size_t l = strlen(str) + 1;					\
+	if (len + l > sz)						\
+		buf = xrealloc(buf, sz = 2 * sz + l);			\
+	memcpy(buf + len, str, l), len += l;				\
+} while (0)
+	snprintf(nb, sizeof(nb), "%d", cnt);
+	SRVADD(nb);
+	SRVADD(cwd);
+	SRVADD(obj ? obj : "");
+	SRVADD(input);
+	SRVADD(output);
+	STRLIST_FOREACH(s, flags)
+		SRVADD(s->value);
+#undef SRVADD
+	if (vflag) {
+		printf("Sending to %s: ", su.sun_path);
+		strlist_print(flags, stdout, 0);
+		printf(" %s %s\n", input, output);
+	}
+	for (p = buf; len > 0; p += n, len -= n)
+		if ((n = write(fd, p, len)) <= 0)
+			break;
+
+	/* stderr text, a 0 and the exit status */
+	len = 0;
+	while ((n = read(fd, buf + len, sz - len)) > 0)
+		if ((len += n) == sz)
+			buf = xrealloc(buf, sz *= 2);
+	close(fd);
+	if (len < 2 || buf[len-2] != 0 || (st = buf[len-1] & 0377) == 255) {
+		free(buf);
+		return -1;
+	}
+	fwrite(buf, 1, len-2, stderr);
+	if (errcopy && (fd = open(errcopy, O_WRONLY|O_APPEND)) >= 0) {
+		(void)write(fd, buf, len-2);
+		close(fd);
+	}
+	free(buf);
+	if (st)
+		errorx(1, "%s terminated with status %d", prog, st);
+	return 0;
+}
+#endif
+
+#ifdef CCCACHE
+/*
+ * Compile cache.  If PCC_CACHE names a directory, the output of
+ * compile (and assemble) is saved there under a 128-bit FNV-1a hash
+ * of the preprocessed input, the flags and the programs used, and
+ * reused when the same hash shows up again.  The compiler's stderr
+ * is saved in a .err file beside it and shown again on a hit.
+ */
+struct chash {
+	unsigned long long hi, lo;
+};
+
+static void
+chadd(struct chash *h, const void *v, size_t n)
+{
+	const unsigned char *p = v;
+	unsigned long long t0, t1;
+
+	/* multiply by the 128-bit FNV prime 2^88 + 0x13b */
+	while (n-- > 0) {
+		h->lo ^= *p++;
+		t0 = (h->lo & 0xffffffffULL) * 0x13b;
+		t1 = (h->lo >> 32) * 0x13b + (t0 >> 32);
+		h->hi = h->hi * 0x13b + (t1 >> 32) + (h->lo << 24);
+		h->lo = (t1 << 32) | (t0 & 0xffffffffULL);
+	}
+}
+
+static void
+chstr(struct chash *h, const char *s)
+{
+	chadd(h, s, strlen(s) + 1);
+}
+
+/* program name and identity */
+static void
+chprog(struct chash *h, const char *prog)
+{
+	struct stat st;
+	char buf[64];
+
+	chstr(h, prog);
+	if (stat(prog, &st) == 0) {
+		snprintf(buf, sizeof(buf), "%lld:%lld",
+		    (long long)st.st_size, (long long)st.st_mtime);
+		chstr(h, buf);
+	}
+}
+
+static void
+cstat(const char *dir, char c)
+{
+	char *f = cat(dir, "/stats");
+	int fd;
+
+	(void)mkdir(dir, 0777);
+	if ((fd = open(f, O_WRONLY|O_APPEND|O_CREAT, 0666)) >= 0) {
+		(void)write(fd, &c, 1);
+		close(fd);
+	}
+	free(f);
+}
+
+/*
+ * Hash input and everything else that affects the output.
+ * mode is 'S' for assembler output, 'o' for an object made by as
+ * and 'O' for one made by the compiler.  Returns NULL if no cache.
+ */
+static char *
+cache_key(char *input, int mode)
+{
+	struct chash h;
+	struct string *s;
+	char buf[BUFSIZ], *dir, *key;
+	ssize_t n;
+	int fd;
+
+	if ((dir = getenv("PCC_CACHE")) == NULL || *dir == 0 || noexec ||
+	    strcmp(input, "-") == 0 || (outfile && strcmp(outfile, "-") == 0))
+		return NULL;
+	if ((fd = open(input, O_RDONLY)) < 0)
+		return NULL;
+	h.hi = 0x6c62272e07bb0142ULL;
+	h.lo = 0x62b821756295c58dULL;
+	buf[0] = mode;
+	chadd(&h, buf, 1);
+	chprog(&h, find_file(cxxflag ? passxx0 : pass0, &progdirs, X_OK));
+	STRLIST_FOREACH(s, &compiler_flags)
+		chstr(&h, s->value);
+	/* the debug info names the directory compiled in */
+	if (gflag && getcwd(buf, sizeof(buf)) != NULL)
+		chstr(&h, buf);
+	if (mode != 'S') {
+		chprog(&h, find_file(as, &progdirs, X_OK));
+		STRLIST_FOREACH(s, &assembler_flags)
+			chstr(&h, s->value);
+	}
+	while ((n = read(fd, buf, sizeof(buf))) > 0)
+		chadd(&h, buf, n);
+	close(fd);
+	if (n < 0)
+		return NULL;
+	key = xmalloc(strlen(dir) + 40);
+	sprintf(key, "%s/%02llx/%016llx%016llx", dir, h.hi >> 56, h.hi, h.lo);
+	return key;
+}
+
+static int
+copyfile(char *from, char *to, int flags)
+{
+	int ofd, rv;
+
+	if ((ofd = open(to, O_WRONLY|O_TRUNC|O_CREAT|flags, 0666)) < 0)
+		return -1;
+	rv = copyfd(from, ofd);
+	if (close(ofd) < 0)
+		rv = -1;
+	if (rv)
+		(void)unlink(to);
+	return rv;
+}
+
+/*
+ * Copy a cached file to output and show the compiler messages saved
+ * with it.  Returns 1 on a hit.
+ */
+static int
+cache_get(char *key, char *output)
+{
+	char *e;
+	int hit;
+
+	hit = access(key, R_OK) == 0 && copyfile(key, output, 0) == 0;
+	if (vflag)
+		printf("Cache %s %s\n", hit ? "hit" : "miss", key);
+	cstat(getenv("PCC_CACHE"), hit ? 'h' : 'm');
+	if (hit) {
+		e = cat(key, ".err");
+		(void)copyfd(e, STDERR_FILENO);
+		free(e);
+	}
+	return hit;
+}
+
+/*
+ * Copy from to the cache file to, via a temp file so that readers
+ * never see a partial file.
+ */
+static void
+cache_save(char *from, char *to)
+{
+	char *tmp, nb[24];
+
+	snprintf(nb, sizeof(nb), ".%ld", (long)getpid());
+	tmp = cat(to, nb);
+	if (copyfile(from, tmp, O_EXCL) == 0 && rename(tmp, to) < 0)
+		(void)unlink(tmp);
+	free(tmp);
+}
+
+/*
+ * Save input in the cache, and the compiler messages in errf next
+ * to it.  The messages go first so that they are there for anyone
+ * who finds the output.
+ */
+static void
+cache_put(char *key, char *input, char *errf)
+{
+	struct stat st;
+	char *d;
+
+	d = xstrdup(key);
+	*strrchr(d, '/') = 0;
+	(void)mkdir(d, 0777);
+	free(d);
+	if (errf && stat(errf, &st) == 0 && st.st_size > 0) {
+		d = cat(key, ".err");
+		cache_save(errf, d);
+		free(d);
+	}
+	cache_save(input, key);
+}
+
+static int
+cache_stats(void)
+{
+	char buf[BUFSIZ], *dir, *f;
+	long hits, misses;
+	ssize_t i, n;
+	int fd;
+
+	if ((dir = getenv("PCC_CACHE")) == NULL || *dir == 0)
+		errorx(1, "PCC_CACHE not set");
+	hits = misses = 0;
+	f = cat(dir, "/stats");
+	if ((fd = open(f, O_RDONLY)) >= 0) {
+		while ((n = read(fd, buf, sizeof(buf))) > 0)
+			for (i = 0; i < n; i++) {
+				if (buf[i] == 'h')
+					hits++;
+				else if (buf[i] == 'm')
+					misses++;
+			}
+		close(fd);
+	}
+	free(f);
+	printf("cache %s: %ld hits, %ld misses", dir, hits, misses);
+	if (hits + misses)
+		printf(" (%ld%% hits)", hits * 100 / (hits + misses));
+	printf("\n");
+	return 0;
+}
+#endif
+
 #endif
 
 /*
@@ -1769,6 +2266,7 @@ struct flgcheck ccomflgcheck[] = {
 	{ &freestanding, 1, "-ffreestanding" },
 	{ &pgflag, 1, "-p" },
 	{ &gflag, 1, "-g" },
+	{ &dwarfflag, 1, "-xdwarf" },
 	{ &xgnu89, 1, "-xgnu89" },
 	{ &xgnu99, 1, "-xgnu99" },
 	{ &xuchar, 1, "-xuchar" },
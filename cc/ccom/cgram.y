@@ -149,6 +149,7 @@
 # include <stdlib.h>
 
 int fun_inline;	/* Reading an inline function */
+int looplvl;	/* Nesting depth of loops */
 int oldstyle;	/* Current function being defined */
 static struct symtab *xnf;
 extern int enummer, tvaloff, inattr;
@@ -716,7 +717,9 @@ init_declarator:   declarator attr_var {
 		|  xnfdeclarator '=' e { 
 			if ($1->sclass == STATIC || $1->sclass == EXTDEF)
 				statinit++;
+			inline_owner($1);
 			simpleinit($1, eve($3));
+			inline_owner(NULL);
 			if ($1->sclass == STATIC || $1->sclass == EXTDEF)
 				statinit--;
 			xnf = NULL;
@@ -823,6 +826,7 @@ statement:	   e ';' { ecomp(eve($1)); symclear(blevel); }
 			else
 				reached = 0;
 			resetbc(0);
+			looplvl--;
 		}
 		|  doprefix statement C_WHILE '(' e ')' ';' {
 			plabel(contlab);
@@ -836,6 +840,7 @@ statement:	   e ';' { ecomp(eve($1)); symclear(blevel); }
 			plabel( brklab);
 			reached = 1;
 			resetbc(0);
+			looplvl--;
 		}
 		|  forprefix .e ')' statement
 			{  plabel( contlab );
@@ -846,6 +851,7 @@ statement:	   e ';' { ecomp(eve($1)); symclear(blevel); }
 			    if( (flostat&FBRK) || !(flostat&FLOOP) ) reached = 1;
 			    else reached = 0;
 			    resetbc(0);
+			    looplvl--;
 			    blevel--;
 			    symclear(blevel);
 			    }
@@ -963,6 +969,7 @@ label:		   C_NAME ':' attr_var { deflabel($1, $3); reached = 1; }
 
 doprefix:	C_DO {
 			savebc();
+			looplvl++;
 			brklab = getlab();
 			contlab = getlab();
 			plabel(  $$ = getlab());
@@ -986,6 +993,7 @@ ifelprefix:	  ifprefix statement C_ELSE {
 
 whprefix:	  C_WHILE  '('  e  ')' {
 			savebc();
+			looplvl++;
 			$3 = eve($3);
 			if ($3->n_op == ICON && $3->n_lval != 0)
 				flostat = FLOOP;
@@ -1003,6 +1011,7 @@ forprefix:	  C_FOR  '('  .e  ';' .e  ';' {
 			if ($3)
 				ecomp($3);
 			savebc();
+			looplvl++;
 			contlab = getlab();
 			brklab = getlab();
 			plabel( $$ = getlab());
@@ -1014,6 +1023,7 @@ forprefix:	  C_FOR  '('  .e  ';' .e  ';' {
 		}
 		|  C_FOR '(' { ++blevel; } declaration .e ';' {
 			savebc();
+			looplvl++;
 			contlab = getlab();
 			brklab = getlab();
 			plabel( $$ = getlab());
@@ -1237,7 +1247,7 @@ bdty(int op, ...)
 		break;
 
 	case GOTO: /* for named labels */
-		q->n_ap = attr_add(q->n_ap, attr_new(ATTR_P1LABELS, 1));
+		q->n_ap = attr_add(q->n_ap, tattr_new(ATTR_P1LABELS, 1));
 		/* FALLTHROUGH */
 	case NAME:
 		q->n_op = NAME;
@@ -1686,8 +1696,13 @@ fundef(NODE *tp, NODE *p)
 		inline_start(s, class);
 		if (class == EXTERN)
 			class = EXTDEF;
-	} else if (class == EXTERN)
+	} else if (class == EXTERN) {
 		class = SNULL; /* same result */
+	} else if (class == STATIC && (xautoinline || xdelstatic) &&
+	    gflag == 0) {
+		/* save for automatic inlining or until referenced */
+		inline_start(s, class);
+	}
 
 	cftnsp = s;
 	defid(p, class);
@@ -1723,6 +1738,7 @@ fend(void)
 		cerror("function level error");
 	ftnend();
 	fun_inline = 0;
+	looplvl = 0;
 	if (alwinl & 2) xtemps = 0;
 	alwinl = 0;
 	cftnsp = NULL;
@@ -2044,7 +2060,7 @@ eve(NODE *p)
 	case NAME:
 		sp = lookup((char *)p->n_sp,
 		    attr_find(p->n_ap, ATTR_P1LABELS) ? SLBLNAME : 0);
-		if (sp->sflags & SINLINE)
+		if ((sp->sflags & SINLINE) || inline_static(sp))
 			inline_ref(sp);
 		r = nametree(sp);
 		if (sp->sflags & SDYNARRAY)
@@ -82,9 +82,9 @@
  *   out in memory. Static or extern variables outside functions.
  * - Initialization at run-time, written to their values as code.
  *
- * Currently run-time-initialized variables are only initialized by using
- * move instructions.  An optimization might be to detect that it is
- * initialized with constants and therefore copied from readonly memory.
+ * Run-time-initialized variables are initialized by using move
+ * instructions, except large aggregates initialized mostly with constants
+ * which are block copied from a template in readonly memory (tmplinit()).
  */
 
 /*
@@ -160,6 +160,17 @@ static struct initctx {
 	int numents;
 } *inilnk;
 
+/*
+ * Initializer of a static object kept until it is referenced (-xdelstatic).
+ */
+struct dinit {
+	struct llh lpole;
+	OFFSZ tbit;
+	int seg;
+	int nnodes;
+};
+static int nodefer;	/* nested initializer seen, write out directly */
+
 static struct ilist *
 getil(struct ilist *next, CONSZ b, int sz, NODE *n)
 {
@@ -405,7 +416,10 @@ beginit(struct symtab *sp)
 		ict->numents = numents;
 		is = tmpalloc(sizeof(struct instk));
 	}
+	if (doing_init)
+		nodefer = 1;
 	csym = sp;
+	inline_owner(sp);
 
 	numents = 0; /* no entries in array list */
 	if (ISARY(sp->stype)) {
@@ -791,6 +805,222 @@ clearbf(OFFSZ off, OFFSZ fsz)
 		insbf(off, fsz, 0);
 }
 
+/*
+ * Automatic aggregates of at least this many bytes, where the constant
+ * initializers outnumber the others, are copied from a template in
+ * read-only memory instead of being stored element by element.
+ */
+#ifndef TMPLINITSZ
+#define	TMPLINITSZ	32
+#endif
+
+/*
+ * Return true if p can be laid out in memory at compile-time.
+ */
+static int
+isconinit(NODE *p)
+{
+	return p->n_op == ICON || p->n_op == FCON;
+}
+
+/*
+ * Check whether the current auto initialization should use a template.
+ */
+static int
+usetmpl(OFFSZ tbit)
+{
+	struct llist *ll;
+	struct ilist *il;
+	int ncon, nvar;
+
+	if (tbit < TMPLINITSZ*SZCHAR)
+		return 0;
+	ncon = nvar = 0;
+	SLIST_FOREACH(ll, &lpole, next) {
+		for (il = ll->il; il; il = il->next) {
+			if (isconinit(il->n))
+				ncon++;
+			else
+				nvar++;
+		}
+	}
+	return ncon >= nvar;
+}
+
+/*
+ * Print out the initializers at the current location.
+ * If concheck is set, only the constant entries are printed and the
+ * others are left as zeroes to be written later.
+ */
+static void
+prtinit(OFFSZ tbit, int concheck)
+{
+	struct llist *ll;
+	struct ilist *il;
+	OFFSZ lastoff;
+	int fsz;
+
+	lastoff = 0;
+	SLIST_FOREACH(ll, &lpole, next) {
+		for (il = ll->il; il; il = il->next) {
+			if (concheck && !isconinit(il->n))
+				continue;
+			fsz = il->fsz;
+			if (ll->begsz + il->off > lastoff)
+				zbits(lastoff, (ll->begsz + il->off) - lastoff);
+			if (fsz < 0) {
+				fsz = -fsz;
+				infld(il->off, fsz, il->n->n_lval);
+			} else
+				inval(il->off, fsz, il->n);
+			tfree(il->n);
+			il->n = NIL;
+			lastoff = ll->begsz + il->off + fsz;
+		}
+	}
+	zbits(lastoff, tbit-lastoff);
+}
+
+/*
+ * Generate code to store the remaining initializers into csym.
+ * If clear is set, also zero out everything in between.
+ */
+static void
+autoinit(OFFSZ tbit, int clear)
+{
+	struct llist *ll;
+	struct ilist *il;
+	struct symtab sym;
+	NODE *p, *r, *n;
+	OFFSZ lastoff;
+	int fsz;
+
+	lastoff = 0;
+	SLIST_FOREACH(ll, &lpole, next) {
+		for (il = ll->il; il; il = il->next) {
+			if ((n = il->n) == NIL)
+				continue;
+			fsz = il->fsz;
+			if (clear && ll->begsz + il->off > lastoff)
+				clearbf(lastoff, (ll->begsz + il->off) - lastoff);
+
+			/* Fake a struct reference */
+			p = buildtree(ADDROF, nametree(csym), NIL);
+			sym.stype = n->n_type;
+			sym.squal = n->n_qual;
+			sym.sdf = n->n_df;
+			sym.sap = n->n_ap;
+			sym.soffset = (int)(ll->begsz + il->off);
+			sym.sclass = (char)(fsz < 0 ? FIELD | -fsz : 0);
+			r = xbcon(0, &sym, INT);
+			p = block(STREF, p, r, INT, 0, 0);
+			ecomp(buildtree(ASSIGN, stref(p), n));
+			if (fsz < 0)
+				fsz = -fsz;
+			lastoff = ll->begsz + il->off + fsz;
+		}
+	}
+	if (clear)
+		clearbf(lastoff, tbit-lastoff);
+}
+
+/*
+ * Emit the constant part of the auto initialization of csym as an
+ * anonymous read-only object and generate code to block copy it.
+ */
+static void
+tmplinit(OFFSZ tbit)
+{
+	struct symtab *sp;
+	NODE *p;
+
+	sp = getsymtab(csym->sname, STEMP);
+	sp->sclass = STATIC;
+	sp->slevel = 1;
+	sp->soffset = getlab();
+	sp->stype = csym->stype;
+	sp->squal = (CON >> TSHIFT);
+	sp->sdf = csym->sdf;
+	sp->sap = csym->sap;
+
+	locctr(RDATA, sp);
+	defloc(sp);
+	prtinit(tbit, 1);
+
+	p = buildtree(ADDROF, nametree(sp), NIL);
+	p = block(STASG, nametree(csym), p, csym->stype, csym->sdf, csym->sap);
+	ecomp(p);
+}
+
+static void
+dncnt(NODE *p, void *arg)
+{
+	(*(int *)arg)++;
+}
+
+/*
+ * Save the initializers of csym in permanent memory, to be printed
+ * out by dinitprt() if it is referenced.  The nodes are kept and
+ * counted as saved.  Return NULL if it cannot be saved.
+ */
+static struct dinit *
+savinit(OFFSZ tbit, int seg)
+{
+	extern int inlnodecnt;
+	struct llist *ll, *nll;
+	struct ilist *il, **pil;
+	struct symtab *sp;
+	struct dinit *di;
+
+	SLIST_FOREACH(ll, &lpole, next) {
+		for (il = ll->il; il; il = il->next) {
+			/* wide strings are in temporary memory */
+			if (il->n->n_op == ICON && (sp = il->n->n_sp) != NULL &&
+			    (sp->sflags & SMASK) == SSTRING &&
+			    sp->stype != CHAR+ARY && sp->stype != UCHAR+ARY)
+				return NULL;
+		}
+	}
+
+	di = permalloc(sizeof(struct dinit));
+	di->tbit = tbit;
+	di->seg = seg;
+	di->nnodes = 0;
+	SLIST_INIT(&di->lpole);
+	SLIST_FOREACH(ll, &lpole, next) {
+		nll = permalloc(sizeof(struct llist));
+		nll->begsz = ll->begsz;
+		pil = &nll->il;
+		for (il = ll->il; il; il = il->next) {
+			*pil = permalloc(sizeof(struct ilist));
+			**pil = *il;
+			walkf(il->n, dncnt, &di->nnodes);
+			pil = &(*pil)->next;
+		}
+		*pil = NULL;
+		SLIST_INSERT_LAST(&di->lpole, nll, next);
+	}
+	inlnodecnt += di->nnodes;
+	return di;
+}
+
+/*
+ * Print out a saved static initializer.
+ */
+void
+dinitprt(struct symtab *sp, struct dinit *di)
+{
+	extern int inlnodecnt;
+	struct llh svpole = lpole;
+
+	lpole = di->lpole;
+	locctr(di->seg ? UDATA : DATA, sp);
+	defloc(sp);
+	prtinit(di->tbit, 0);
+	inlnodecnt -= di->nnodes;
+	lpole = svpole;
+}
+
 /*
  * final step of initialization.
  * print out init nodes and generate copy code (if needed).
@@ -798,10 +1028,12 @@ clearbf(OFFSZ off, OFFSZ fsz)
 void
 endinit(int seg)
 {
+#ifdef PCC_DEBUG
 	struct llist *ll;
 	struct ilist *il;
-	int fsz;
-	OFFSZ lastoff, tbit;
+#endif
+	struct dinit *di;
+	OFFSZ tbit;
 
 #ifdef PCC_DEBUG
 	if (idebug)
@@ -819,71 +1051,48 @@ endinit(int seg)
 	} else
 		tbit = tsize(csym->stype, csym->sdf, csym->sap);
 
-	/* Setup symbols */
-	if (csym->sclass != AUTO) {
-		locctr(seg ? UDATA : DATA, csym);
-		defloc(csym);
-	}
-
-	/* Traverse all entries and print'em out */
-	lastoff = 0;
-	SLIST_FOREACH(ll, &lpole, next) {
-		for (il = ll->il; il; il = il->next) {
 #ifdef PCC_DEBUG
-			if (idebug > 1) {
+	if (idebug > 1) {
+		SLIST_FOREACH(ll, &lpole, next) {
+			for (il = ll->il; il; il = il->next) {
 				printf("off " CONFMT " size %d val " CONFMT " type ",
 				    ll->begsz+il->off, il->fsz, il->n->n_lval);
 				tprint(il->n->n_type, 0);
 				printf("\n");
 			}
+		}
+	}
 #endif
-			fsz = il->fsz;
-			if (csym->sclass == AUTO) {
-				struct symtab sym;
-				NODE *p, *r, *n;
-
-				if (ll->begsz + il->off > lastoff)
-					clearbf(lastoff,
-					    (ll->begsz + il->off) - lastoff);
-
-				/* Fake a struct reference */
-				p = buildtree(ADDROF, nametree(csym), NIL);
-				n = il->n;
-				sym.stype = n->n_type;
-				sym.squal = n->n_qual;
-				sym.sdf = n->n_df;
-				sym.sap = n->n_ap;
-				sym.soffset = (int)(ll->begsz + il->off);
-				sym.sclass = (char)(fsz < 0 ? FIELD | -fsz : 0);
-				r = xbcon(0, &sym, INT);
-				p = block(STREF, p, r, INT, 0, 0);
-				ecomp(buildtree(ASSIGN, stref(p), il->n));
-				if (fsz < 0)
-					fsz = -fsz;
 
-			} else {
-				if (ll->begsz + il->off > lastoff)
-					zbits(lastoff,
-					    (ll->begsz + il->off) - lastoff);
-				if (fsz < 0) {
-					fsz = -fsz;
-					infld(il->off, fsz, il->n->n_lval);
-				} else
-					inval(il->off, fsz, il->n);
-				tfree(il->n);
-			}
-			lastoff = ll->begsz + il->off + fsz;
+	/* Traverse all entries and print'em out */
+	if (csym->sclass == AUTO) {
+		if (nerrors == 0 && usetmpl(tbit)) {
+			tmplinit(tbit);
+			autoinit(tbit, 0);
+		} else
+			autoinit(tbit, 1);
+	} else {
+		inline_owner(NULL);
+		di = NULL;
+		if (inline_isdead(csym) && nerrors == 0 && nodefer == 0)
+			di = savinit(tbit, seg);
+		if (di == NULL) {
+			locctr(seg ? UDATA : DATA, csym);
+			defloc(csym);
+			prtinit(tbit, 0);
 		}
+		if (inline_static(csym))
+			inline_dinit(csym, di);
 	}
-	if (csym->sclass == AUTO) {
-		clearbf(lastoff, tbit-lastoff);
-	} else
-		zbits(lastoff, tbit-lastoff);
 	
 	doing_init--;
 	if (csym->sclass == STATIC || csym->sclass == EXTDEF)
 		statinit--;
 	endictx();
+	if (doing_init)
+		inline_owner(csym);
+	else
+		nodefer = 0;
 }
 
 void
@@ -1185,6 +1394,18 @@ simpleinit(struct symtab *sp, NODE *p)
 		return;
 	}
 
+	/* Keep unreferenced static scalars until referenced */
+	if (inline_isdead(sp) && (ISPTR(sp->stype) || ISINTEGER(sp->stype))
+#ifdef TARGET_TIMODE
+	    && attr_find(sp->sap, GCC_ATYP_MODE) == NULL
+#endif
+	    ) {
+		beginit(sp);
+		scalinit(p);
+		endinit(0);
+		return;
+	}
+
 	nt = nametree(sp);
 	switch (sp->sclass) {
 	case STATIC:
@@ -36,6 +36,20 @@
  * If it has the keyword "static" it will be written out if it is referenced.
  * inlining will only be done if -xinline is given, and only if it is 
  * possible to inline the function.
+ *
+ * With -xautoinline also static functions without the keyword are saved,
+ * and both kinds are inlined if their node count is within a budget
+ * that grows with the loop depth of the call site.
+ *
+ * With -xdelstatic static functions and file-scope static data are
+ * saved too and only written out if they are referenced, directly or
+ * through other written out objects.  References found while saving a
+ * function or an initializer are recorded as IP_REF entries and
+ * followed when the object is written out.
+ *
+ * The body is not emitted when the call is found, instead it is put on
+ * a pending list and emitted when the goto to its entry label is reached.
+ * This way no jumps are needed around the inlined code.
  */
 static void printip(struct interpass *pole);
 
@@ -56,15 +70,38 @@ static struct istat {
 #define	CANINL	1	/* function is possible to inline */
 #define	WRITTEN	2	/* function is written out */
 #define	REFD	4	/* Referenced but not yet written out */
+#define	AUTOINL	8	/* Saved only for automatic inlining */
+#define	ISDATA	16	/* static data, not a function */
 	struct ntds *nt;/* Array of arg temp type data */
+	struct dinit *di;/* saved initializer of static data */
+	int nnodes;	/* number of saved nodes */
 	int nargs;	/* number of args in array */
 	int retval;	/* number of return temporary, if any */
 	struct interpass shead;
-} *cifun;
+} *cifun, *cidata;
 
 static SLIST_HEAD(, istat) ipole = { NULL, &ipole.q_forw };
 static int nlabs, svclass;
 
+/*
+ * Inlined bodies waiting for their entry goto.
+ */
+static struct ipend {
+	struct ipend *next;
+	struct istat *is;
+	int lbl;	/* entry label */
+	int lmin;	/* label offset */
+	int toff;	/* temp offset */
+} *ipend;
+
+/*
+ * Node budget for automatic inlining, scaled by loop depth.
+ */
+#ifndef INLBUDGET
+#define	INLBUDGET	40
+#endif
+#define	MAXINLLVL	3
+
 #define	IP_REF	(MAXIP+1)
 #ifdef PCC_DEBUG
 #define	SDEBUG(x)	if (sdebug) printf x
@@ -97,10 +134,13 @@ getprol(struct istat *is, int type)
 static void
 tcnt(NODE *p, void *arg)
 {
+	struct istat *is = arg;
+
 	inlnodecnt++;
+	is->nnodes++;
 	if (nlabs > 1 && (p->n_op == REG || p->n_op == OREG) &&
 	    regno(p) == FPREG)
-		SLIST_FIRST(&ipole)->flags &= ~CANINL; /* no stack refs */
+		is->flags &= ~CANINL; /* no stack refs */
 	if (p->n_op == NAME || p->n_op == ICON)
 		p->n_sp = NULL; /* let symtabs be freed for inline funcs */
 	if (ndebug)
@@ -141,7 +181,7 @@ inline_addarg(struct interpass *ip)
 	if (ip->type == IP_DEFLAB)
 		nlabs++;
 	if (ip->type == IP_NODE)
-		walkf(ip->ip_node, tcnt, 0); /* Count as saved */
+		walkf(ip->ip_node, tcnt, cifun); /* Count as saved */
 	if (cftnod)
 		cifun->retval = regno(cftnod);
 }
@@ -169,6 +209,11 @@ inline_start(struct symtab *sp, int class)
 		SLIST_INSERT_FIRST(&ipole, is, link);
 		DLIST_INIT(&is->shead, qelem);
 	}
+	if ((sp->sflags & SINLINE) == 0) {
+		/* Not declared inline, saved for inlining or until referenced */
+		sp->sflags |= SINLINE;
+		is->flags |= AUTOINL;
+	}
 	cifun = is;
 	nlabs = 0;
 	isinlining++;
@@ -209,6 +254,13 @@ inline_end(void)
 	if (xgnu89 && svclass == SNULL)
 		sp->sclass = EXTERN;
 
+	/*
+	 * Calls before the definition of an automatically inlined
+	 * function are real, so write it out unless refs are tracked.
+	 */
+	if ((cifun->flags & AUTOINL) && !inline_static(sp))
+		cifun->flags |= REFD;
+
 #ifdef GCC_COMPAT
 	if (sp->sclass != STATIC &&
 	    (attr_find(sp->sap, GCC_ATYP_GNU_INLINE) || xgnu89)) {
@@ -233,6 +285,7 @@ inline_end(void)
 void
 inline_ref(struct symtab *sp)
 {
+	struct interpass *ip;
 	struct istat *w;
 
 	SDEBUG(("inline_ref(\"%s\")\n", sp->sname));
@@ -240,6 +293,13 @@ inline_ref(struct symtab *sp)
 		return; /* only inline, no references */
 	if (isinlining) {
 		refnode(sp);
+	} else if (cidata) {
+		if (cidata->sp == sp)
+			return;
+		ip = permalloc(sizeof(*ip));
+		ip->type = IP_REF;
+		ip->ip_name = (char *)sp;
+		DLIST_INSERT_BEFORE(&cidata->shead, ip, qelem);
 	} else {
 		SLIST_FOREACH(w,&ipole, link) {
 			if (w->sp != sp)
@@ -318,11 +378,20 @@ puto(struct istat *w)
 void
 inline_prtout(void)
 {
+	struct interpass *ip;
 	struct istat *w;
 	int gotone = 0;
 
+	ipend = NULL; /* pending bodies are gone with the function */
 	SLIST_FOREACH(w, &ipole, link) {
-		if ((w->flags & (REFD|WRITTEN)) == REFD &&
+		if ((w->flags & (REFD|WRITTEN|ISDATA)) == (REFD|ISDATA) &&
+		    w->di != NULL) {
+			DLIST_FOREACH(ip, &w->shead, qelem)
+				inline_ref((struct symtab *)ip->ip_name);
+			dinitprt(w->sp, w->di);
+			w->flags |= WRITTEN;
+			gotone++;
+		} else if ((w->flags & (REFD|WRITTEN|ISDATA)) == REFD &&
 		    !DLIST_ISEMPTY(&w->shead, qelem)) {
 			locctr(PROG, w->sp);
 			defloc(w->sp);
@@ -335,6 +404,117 @@ inline_prtout(void)
 		inline_prtout();
 }
 
+/*
+ * Names used as alias targets.  They are referenced from the
+ * assembler only, so the objects must always be written out.
+ */
+static struct alref {
+	struct alref *next;
+	char *name;
+} *alrefs;
+
+/*
+ * Called when a symbol is declared as an alias of name.
+ */
+void
+inline_alias(char *name)
+{
+	struct alref *ar;
+	struct symtab *sp;
+
+	ar = permalloc(sizeof(struct alref));
+	ar->name = name;
+	ar->next = alrefs;
+	alrefs = ar;
+	/* already saved, write it out */
+	if ((sp = lookup(addname(name), SNOCREAT)) != NULL)
+		inline_ref(sp);
+}
+
+/*
+ * Return 1 if references to sp are tracked, so that it is only written
+ * out if referenced.  Only static functions and file-scope static data,
+ * and not if it may be referenced in ways not seen here.
+ */
+int
+inline_static(struct symtab *sp)
+{
+	struct alref *ar;
+
+	if (xdelstatic == 0 || gflag || sp->slevel != 0 ||
+	    (sp->sflags & (STEMP|SSTRING)))
+		return 0;
+	if (sp->sclass != STATIC && sp->sclass != USTATIC)
+		return 0;
+#ifdef GCC_COMPAT
+	if (attr_find(sp->sap, GCC_ATYP_USED) ||
+	    attr_find(sp->sap, GCC_ATYP_CONSTRUCTOR) ||
+	    attr_find(sp->sap, GCC_ATYP_DESTRUCTOR))
+		return 0;
+#endif
+	for (ar = alrefs; ar; ar = ar->next)
+		if (strcmp(ar->name, sp->soname ? sp->soname : sp->sname) == 0)
+			return 0;
+	return 1;
+}
+
+/*
+ * Return 1 if sp is tracked and not referenced.
+ */
+int
+inline_isdead(struct symtab *sp)
+{
+	struct istat *w;
+
+	if (!inline_static(sp))
+		return 0;
+	w = findfun(sp);
+	return w == NULL || (w->flags & REFD) == 0;
+}
+
+/*
+ * Set the static object whose initializer is being read, or NULL.
+ * References found meanwhile belong to that object.
+ */
+void
+inline_owner(struct symtab *sp)
+{
+	struct istat *w;
+
+	if (sp == NULL || !inline_static(sp)) {
+		cidata = NULL;
+		return;
+	}
+	if ((w = findfun(sp)) == NULL) {
+		w = ialloc();
+		w->sp = sp;
+		SLIST_INSERT_FIRST(&ipole, w, link);
+		DLIST_INIT(&w->shead, qelem);
+	}
+	w->flags |= ISDATA;
+	cidata = w;
+}
+
+/*
+ * Save the initializer of static data until referenced.
+ * If di is NULL the data is already written out.
+ */
+void
+inline_dinit(struct symtab *sp, struct dinit *di)
+{
+	struct interpass *ip;
+	struct istat *w;
+
+	if ((w = findfun(sp)) == NULL)
+		cerror("inline_dinit: %s not found", sp->sname);
+	w->di = di;
+	if (di == NULL) {
+		w->flags |= REFD|WRITTEN;
+		DLIST_FOREACH(ip, &w->shead, qelem)
+			inline_ref((struct symtab *)ip->ip_name);
+	}
+}
+
 #if 1
 static void
 printip(struct interpass *pole)
@@ -408,6 +588,118 @@ rtmps(NODE *p, void *arg)
 		regno(p) += toff;
 }
 
+/*
+ * Check whether a function should be inlined at this call site.
+ */
+static int
+inlok(struct istat *is)
+{
+	int lvl = looplvl > MAXINLLVL ? MAXINLLVL : looplvl;
+
+	if (xinline && (is->flags & AUTOINL) == 0)
+		return 1;
+	if (xautoinline == 0)
+		return 0;
+	return is->nnodes <= INLBUDGET * (1 + lvl);
+}
+
+/*
+ * Emit the body of a pending inline function at its entry goto.
+ * Returns 0 if the label do not belong to an inlined function.
+ */
+int
+inline_goto(int lbl)
+{
+	struct ipend *pe, **ppe;
+	struct interpass *ip, *ipf, *ipl, *ipx;
+	struct istat *is;
+	int n, lmin;
+	NODE *p;
+
+	for (ppe = &ipend; (pe = *ppe) != NULL; ppe = &pe->next)
+		if (pe->lbl == lbl)
+			break;
+	if (pe == NULL)
+		return 0;
+	*ppe = pe->next;
+	is = pe->is;
+	lmin = pe->lmin;
+	toff = pe->toff;
+
+	/* traverse until first real label */
+	n = 0;
+	DLIST_FOREACH(ipf, &is->shead, qelem)
+		if (ipf->type == IP_DEFLAB && n++ == 1)
+			break;
+
+	/* traverse backwards to last label */
+	DLIST_FOREACH_REVERSE(ipl, &is->shead, qelem)
+		if (ipl->type == IP_DEFLAB)
+			break;
+
+	/* a jump to the return label just before it is not needed */
+	ipx = DLIST_PREV(ipl, qelem);
+	if (ipx->type != IP_NODE || ipx->ip_node->n_op != GOTO ||
+	    ipx->ip_node->n_left->n_lval != ipl->ip_lbl)
+		ipx = NULL;
+
+	/* count the other exits */
+	n = 0;
+	for (ip = ipf; ip != ipl; ip = DLIST_NEXT(ip, qelem)) {
+		if (ip == ipx || ip->type != IP_NODE)
+			continue;
+		p = ip->ip_node;
+		if ((p->n_op == GOTO && p->n_left->n_lval == ipl->ip_lbl) ||
+		    (p->n_op == CBRANCH && p->n_right->n_lval == ipl->ip_lbl))
+			n++;
+	}
+
+	/* So, walk over all statements and emit them */
+	for (ip = ipf; ip != ipl; ip = DLIST_NEXT(ip, qelem)) {
+		if (ip == ipx)
+			continue;
+		switch (ip->type) {
+		case IP_NODE:
+			p = ccopy(ip->ip_node);
+			if (p->n_op == GOTO)
+				p->n_left->n_lval += lmin;
+			else if (p->n_op == CBRANCH)
+				p->n_right->n_lval += lmin;
+			walkf(p, rtmps, 0);
+#ifdef PCC_DEBUG
+			if (sdebug) {
+				printf("converted node\n");
+				fwalk(ip->ip_node, eprint, 0);
+				fwalk(p, eprint, 0);
+			}
+#endif
+			send_passt(IP_NODE, p);
+			break;
+
+		case IP_DEFLAB:
+			SDEBUG(("converted label %d to %d\n",
+			    ip->ip_lbl, ip->ip_lbl + lmin));
+			send_passt(IP_DEFLAB, ip->ip_lbl + lmin);
+			break;
+
+		case IP_ASM:
+			send_passt(IP_ASM, ip->ip_asm);
+			break;
+
+		case IP_REF:
+			inline_ref((struct symtab *)ip->ip_name);
+			break;
+
+		default:
+			cerror("bad inline stmt %d", ip->type);
+		}
+	}
+	SDEBUG(("last label %d to %d\n", ip->ip_lbl, ip->ip_lbl + lmin));
+	if (n)
+		send_passt(IP_DEFLAB, ip->ip_lbl + lmin);
+	return 1;
+}
+
 /*
  * Inline a function. Returns the return value.
  * There are two major things that must be converted when 
@@ -421,9 +713,10 @@ inlinetree(struct symtab *sp, NODE *f, NODE *ap)
 {
 	extern int crslab, tvaloff;
 	struct istat *is = findfun(sp);
-	struct interpass *ip, *ipf, *ipl;
+	struct interpass *ip;
 	struct interpass_prolog *ipp, *ipe;
-	int lmin, l0, l1, l2, gainl, n;
+	struct ipend *pe;
+	int l1, gainl, n;
 	NODE *p, *rp;
 
 	if (is == NULL || nerrors) {
@@ -444,7 +737,7 @@ inlinetree(struct symtab *sp, NODE *f, NODE *ap)
 		werror("cannot inline but always_inline");
 	nerrors = n;
 
-	if ((is->flags & CANINL) == 0 || (xinline == 0 && gainl == 0)) {
+	if ((is->flags & CANINL) == 0 || (gainl == 0 && !inlok(is))) {
 		if (is->sp->sclass == STATIC || is->sp->sclass == USTATIC)
 			inline_ref(sp);
 		return NIL;
@@ -463,11 +756,10 @@ inlinetree(struct symtab *sp, NODE *f, NODE *ap)
 	}
 #endif
 
-	/* emit jumps to surround inline function */
-	branch(l0 = getlab());
-	plabel(l1 = getlab());
-	l2 = getlab();
-	SDEBUG(("branch labels %d,%d,%d\n", l0, l1, l2));
+	/* the body is emitted when the goto to l1 is found */
+	l1 = getlab();
+	(void)getlab(); /* l1+1, continuation label set by comops() */
+	SDEBUG(("entry label %d\n", l1));
 
 	ipp = getprol(is, IP_PROLOG);
 	ipe = getprol(is, IP_EPILOG);
@@ -475,73 +767,21 @@ inlinetree(struct symtab *sp, NODE *f, NODE *ap)
 	/* Fix label & temp offsets */
 
 	SDEBUG(("pre-offsets crslab %d tvaloff %d\n", crslab, tvaloff));
-	lmin = crslab - ipp->ip_lblnum;
+	pe = tmpalloc(sizeof(struct ipend));
+	pe->is = is;
+	pe->lbl = l1;
+	pe->lmin = crslab - ipp->ip_lblnum;
 	crslab += (ipe->ip_lblnum - ipp->ip_lblnum) + 1;
-	toff = tvaloff - ipp->ip_tmpnum;
+	pe->toff = toff = tvaloff - ipp->ip_tmpnum;
 	tvaloff += (ipe->ip_tmpnum - ipp->ip_tmpnum) + 1;
 	SDEBUG(("offsets crslab %d lmin %d tvaloff %d toff %d\n",
-	    crslab, lmin, tvaloff, toff));
-
-	/* traverse until first real label */
-	n = 0;
-	DLIST_FOREACH(ipf, &is->shead, qelem) {
-		if (ipf->type == IP_REF)
-			inline_ref((struct symtab *)ipf->ip_name);
-		if (ipf->type == IP_DEFLAB && n++ == 1)
-			break;
-	}
-
-	/* traverse backwards to last label */
-	DLIST_FOREACH_REVERSE(ipl, &is->shead, qelem) {
-		if (ipl->type == IP_REF)
-			inline_ref((struct symtab *)ipl->ip_name);
-		if (ipl->type == IP_DEFLAB)
-			break;
-	}
-		
-	/* So, walk over all statements and emit them */
-	for (ip = ipf; ip != ipl; ip = DLIST_NEXT(ip, qelem)) {
-		switch (ip->type) {
-		case IP_NODE:
-			p = ccopy(ip->ip_node);
-			if (p->n_op == GOTO)
-				p->n_left->n_lval += lmin;
-			else if (p->n_op == CBRANCH)
-				p->n_right->n_lval += lmin;
-			walkf(p, rtmps, 0);
-#ifdef PCC_DEBUG
-			if (sdebug) {
-				printf("converted node\n");
-				fwalk(ip->ip_node, eprint, 0);
-				fwalk(p, eprint, 0);
-			}
-#endif
-			send_passt(IP_NODE, p);
-			break;
-
-		case IP_DEFLAB:
-			SDEBUG(("converted label %d to %d\n",
-			    ip->ip_lbl, ip->ip_lbl + lmin));
-			send_passt(IP_DEFLAB, ip->ip_lbl + lmin);
-			break;
-
-		case IP_ASM:
-			send_passt(IP_ASM, ip->ip_asm);
-			break;
+	    crslab, pe->lmin, tvaloff, toff));
+	pe->next = ipend;
+	ipend = pe;
 
-		case IP_REF:
+	DLIST_FOREACH(ip, &is->shead, qelem)
+		if (ip->type == IP_REF)
 			inline_ref((struct symtab *)ip->ip_name);
-			break;
-
-		default:
-			cerror("bad inline stmt %d", ip->type);
-		}
-	}
-	SDEBUG(("last label %d to %d\n", ip->ip_lbl, ip->ip_lbl + lmin));
-	send_passt(IP_DEFLAB, ip->ip_lbl + lmin);
-
-	branch(l2);
-	plabel(l0);
 
 	rp = block(GOTO, bcon(l1), NIL, INT, 0, 0);
 	if (is->retval)
@@ -34,6 +34,15 @@
 #include <signal.h>
 #include <string.h>
 #include <stdlib.h>
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <errno.h>
+#include <poll.h>
+#define	CCSERVER	/* -xserver= compile server */
+#endif
 
 #include "pass1.h"
 #include "pass2.h"
@@ -46,11 +55,21 @@ int gflag, kflag;
 int pflag, sflag;
 int sspflag;
 int xssa, xtailcall, xtemps, xdeljumps, xdce, xinline, xccp, xgnu89, xgnu99;
+int xautoinline, xdelstatic, xvector, xjobs;
+int xlinscan = -1;	/* linear-scan regalloc, default if not -xtemps */
 int xuchar;
+int xdwarf;	/* -g writes DWARF rather than stabs */
 int freestanding;
 char *prgname;
+static char *objfile;
 
 static void prtstats(void);
+#ifdef CCSERVER
+static char *srvpath;
+static char **ccserve(char **flags, int nflags);
+static char **srvflags;
+static int nsrvflags;
+#endif
 
 static void
 usage(void)
@@ -86,6 +105,18 @@ xopt(char *str)
 		xdce++;
 	else if (strcmp(str, "inline") == 0)
 		xinline++;
+	else if (strcmp(str, "autoinline") == 0)
+		xautoinline++;
+	else if (strcmp(str, "delstatic") == 0)
+		xdelstatic++;
+	else if (strcmp(str, "vector") == 0)
+		xvector++;
+	else if (strncmp(str, "jobs=", 5) == 0)
+		xjobs = atoi(str + 5);
+	else if (strcmp(str, "regalloc=linear") == 0)
+		xlinscan = 1;
+	else if (strcmp(str, "regalloc=color") == 0)
+		xlinscan = 0;
 	else if (strcmp(str, "ccp") == 0)
 		xccp++;
 	else if (strcmp(str, "gnu89") == 0)
@@ -94,6 +125,12 @@ xopt(char *str)
 		xgnu99++;
 	else if (strcmp(str, "uchar") == 0)
 		xuchar++;
+	else if (strcmp(str, "dwarf") == 0)
+		xdwarf++;
+#ifdef CCSERVER
+	else if (strncmp(str, "server=", 7) == 0)
+		srvpath = str + 7;
+#endif
 	else {
 		fprintf(stderr, "unknown -x option '%s'\n", str);
 		usage();
@@ -124,6 +161,240 @@ fflags(char *str)
 	}
 }
 
+/*
+ * Redirect stdin/stdout to the named input and output files.
+ */
+static void
+openfiles(int argc, char *argv[])
+{
+	if (argc > 0 && strcmp(argv[0], "-") != 0) {
+		if (freopen(argv[0], "r", stdin) == NULL) {
+			fprintf(stderr, "open input file '%s':",
+			    argv[0]);
+			perror(NULL);
+			exit(1);
+		}
+	}
+	if (argc > 1 && strcmp(argv[1], "-") != 0) {
+		if (freopen(argv[1], "w", stdout) == NULL) {
+			fprintf(stderr, "open output file '%s':",
+			    argv[1]);
+			perror(NULL);
+			exit(1);
+		}
+	}
+}
+
+#ifdef CCSERVER
+/*
+ * Compile server.  ccom is started once with -xserver=path and the
+ * compiler flags, does all setup that does not depend on the input
+ * and then forks a fresh copy of itself for each job that arrives on
+ * the Unix socket at path, so per-file state never has to be reset.
+ *
+ * A job is a count followed by that many 0-terminated strings: the
+ * working directory, the object file (or empty), the input and output
+ * files and then the flags, which must be the ones the server runs
+ * with.  The reply is the compiler's stderr text, a 0 byte and the
+ * exit status; status 255 means the job was refused.  The server
+ * exits after SRVIDLE seconds without jobs.
+ *
+ * Anyone who may connect can have files compiled and written as us,
+ * so the socket must be in a directory of ours that nobody else may
+ * write to, and each connection must come from our own uid.
+ */
+#define	SRVIDLE	300
+#define	SRVMAXJ	16384	/* max size of a job */
+#define	SRVMAXV	256	/* max strings in a job */
+
+static char srvbuf[SRVMAXJ];
+
+static void
+srvreply(int fd, int st)
+{
+	char b[2];
+
+	b[0] = 0;
+	b[1] = (char)st;
+	(void)write(fd, b, 2);
+}
+
+/*
+ * Read a job.  Return the number of strings, stored in v[], or -1.
+ */
+static int
+srvread(int fd, char **v, int nv)
+{
+	char *p, *e;
+	int n, i, cnt;
+
+	p = srvbuf, e = srvbuf, cnt = -1;
+	for (i = 0; cnt < 0 || i < cnt; ) {
+		if (p == e) {
+			if (e == srvbuf + SRVMAXJ)
+				return -1;
+			if ((n = read(fd, e, srvbuf + SRVMAXJ - e)) <= 0)
+				return -1;
+			e += n;
+		}
+		while (p < e && *p)
+			p++;
+		if (p == e)
+			continue;
+		if (cnt < 0) {
+			if ((cnt = atoi(srvbuf)) < 4 || cnt > nv)
+				return -1;
+			v[0] = ++p;
+		} else {
+			if (++i < cnt)
+				v[i] = ++p;
+		}
+	}
+	return cnt;
+}
+
+/*
+ * Is the peer on fd running as us?  Without a way to ask, only the
+ * directory protects the socket.
+ */
+static int
+srvpeerok(int fd)
+{
+#if defined(os_linux) && defined(SO_PEERCRED)
+	/* struct ucred, which needs _GNU_SOURCE */
+	struct { pid_t pid; uid_t uid; gid_t gid; } uc;
+	socklen_t l = sizeof(uc);
+
+	return getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &uc, &l) == 0 &&
+	    uc.uid == geteuid();
+#elif defined(HAVE_GETPEEREID)
+	uid_t u;
+	gid_t g;
+
+	return getpeereid(fd, &u, &g) == 0 && u == geteuid();
+#else
+	return 1;
+#endif
+}
+
+static int
+srvlisten(char *path)
+{
+	struct sockaddr_un su;
+	struct stat sb;
+	mode_t um;
+	char *e;
+	int fd, rv;
+
+	memset(&su, 0, sizeof(su));
+	su.sun_family = AF_UNIX;
+	if (strlen(path) >= sizeof(su.sun_path))
+		return -1;
+	strcpy(su.sun_path, path);
+
+	/* the directory must be ours and not writable by others */
+	if ((e = strrchr(su.sun_path, '/')) != NULL)
+		*e = 0;
+	rv = lstat(e == NULL ? "." : e == su.sun_path ? "/" : su.sun_path,
+	    &sb);
+	if (rv < 0 || !S_ISDIR(sb.st_mode) || sb.st_uid != geteuid() ||
+	    (sb.st_mode & (S_IWGRP|S_IWOTH)) != 0)
+		return -1;
+	strcpy(su.sun_path, path);
+
+	if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+		return -1;
+	um = umask(077);
+	if ((rv = bind(fd, (struct sockaddr *)&su, sizeof(su))) < 0) {
+		/* stale socket if nobody answers */
+		if (errno == EADDRINUSE &&
+		    connect(fd, (struct sockaddr *)&su, sizeof(su)) < 0 &&
+		    unlink(path) == 0)
+			rv = bind(fd, (struct sockaddr *)&su, sizeof(su));
+	}
+	(void)umask(um);
+	if (rv < 0) {
+		close(fd);
+		return -1;
+	}
+	if (listen(fd, 64) < 0) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+static char **
+ccserve(char **flags, int nflags)
+{
+	static char *v[SRVMAXV];
+	struct pollfd pfd;
+	pid_t pid;
+	int lfd, fd, n, i, j, st;
+
+	/* the flags jobs must match; all but -xserver= */
+	for (i = j = 0; i < nflags; i++)
+		if (strncmp(flags[i], "-xserver=", 9) != 0)
+			flags[j++] = flags[i];
+	nflags = j;
+
+	if ((lfd = srvlisten(srvpath)) < 0) {
+		fprintf(stderr, "cannot listen on %s\n", srvpath);
+		exit(1);
+	}
+	(void)fflush(stdout);
+	signal(SIGCHLD, SIG_IGN);	/* no zombies */
+	pfd.fd = lfd;
+	pfd.events = POLLIN;
+	for (;;) {
+		if ((n = poll(&pfd, 1, SRVIDLE * 1000)) == 0)
+			break;
+		if (n < 0 || (fd = accept(lfd, NULL, NULL)) < 0) {
+			if (n < 0 && errno != EINTR)
+				break;
+			continue;
+		}
+		if (!srvpeerok(fd)) {
+			close(fd);
+			continue;
+		}
+		if (fork() != 0) {
+			close(fd);
+			continue;
+		}
+
+		/* job handler */
+		close(lfd);
+		signal(SIGCHLD, SIG_DFL);
+		n = srvread(fd, v, SRVMAXV);
+		for (i = 0; i < nflags && i + 4 < n; i++)
+			if (strcmp(v[i + 4], flags[i]) != 0)
+				break;
+		if (n != nflags + 4 || i != nflags || chdir(v[0]) < 0) {
+			srvreply(fd, 255);
+			_exit(0);
+		}
+		if ((pid = fork()) == 0) {
+			/* the compiler proper */
+			if (fd != STDERR_FILENO) {
+				dup2(fd, STDERR_FILENO);
+				close(fd);
+			}
+			objfile = *v[1] ? v[1] : NULL;
+			openfiles(2, &v[2]);
+			return &v[2];
+		}
+		st = 1;
+		if (pid > 0 && waitpid(pid, &st, 0) == pid)
+			st = WIFEXITED(st) ? WEXITSTATUS(st) : 1;
+		srvreply(fd, st);
+		_exit(0);
+	}
+	unlink(srvpath);
+	exit(0);
+}
+#endif
+
 /* control multiple files */
 int
 main(int argc, char *argv[])
@@ -139,7 +410,7 @@ main(int argc, char *argv[])
 
 	prgname = argv[0];
 
-	while ((ch = getopt(argc, argv, "OT:VW:X:Z:f:gkm:psvwx:")) != -1) {
+	while ((ch = getopt(argc, argv, "OT:VW:X:Z:f:gkm:o:psvwx:")) != -1) {
 		switch (ch) {
 #if !defined(MULTIPASS) || defined(PASS1)
 		case 'X':	/* pass1 debugging */
@@ -225,6 +496,10 @@ main(int argc, char *argv[])
 			mflags(optarg);
 			break;
 
+		case 'o': /* Object file, if the target can write one */
+			objfile = optarg;
+			break;
+
 		case 'p': /* Profiling */
 			++pflag;
 			break;
@@ -254,30 +529,45 @@ main(int argc, char *argv[])
 			usage();
 		}
 	}
+#ifdef CCSERVER
+	srvflags = argv + 1;
+	nsrvflags = optind - 1;
+#endif
 	argc -= optind;
 	argv += optind;
 
-	if (argc > 0 && strcmp(argv[0], "-") != 0) {
-		if (freopen(argv[0], "r", stdin) == NULL) {
-			fprintf(stderr, "open input file '%s':",
-			    argv[0]);
-			perror(NULL);
-			exit(1);
-		}
-	}
-	if (argc > 1 && strcmp(argv[1], "-") != 0) {
-		if (freopen(argv[1], "w", stdout) == NULL) {
-			fprintf(stderr, "open output file '%s':",
-			    argv[1]);
-			perror(NULL);
-			exit(1);
-		}
-	}
+	if (xlinscan < 0)
+		xlinscan = !xtemps;
+
+#ifdef CCSERVER
+	if (srvpath == NULL)
+#endif
+		openfiles(argc, argv);
 
 	mkdope();
+#ifdef SA_ONSTACK
+	{
+		/* run segvcatch on its own stack, to catch stack overflow */
+		static char sigstk[65536];
+		struct sigaction sa;
+		stack_t ss;
+
+		ss.ss_sp = sigstk;
+		ss.ss_size = sizeof(sigstk);
+		ss.ss_flags = 0;
+		memset(&sa, 0, sizeof(sa));
+		sa.sa_handler = segvcatch;
+		sa.sa_flags = sigaltstack(&ss, NULL) == 0 ? SA_ONSTACK : 0;
+		sigaction(SIGSEGV, &sa, NULL);
+#ifdef SIGBUS
+		sigaction(SIGBUS, &sa, NULL);
+#endif
+	}
+#else
 	signal(SIGSEGV, segvcatch);
 #ifdef SIGBUS
 	signal(SIGBUS, segvcatch);
+#endif
 #endif
 	fregs = FREGS;	/* number of free registers */
 	lineno = 1;
@@ -303,6 +593,17 @@ main(int argc, char *argv[])
 	builtin_init();
 #endif
 
+	if (sspflag)
+		sspinit();
+
+#ifdef CCSERVER
+	if (srvpath) {
+		/* only returns in a child, set up for one compile job */
+		argv = ccserve(srvflags, nsrvflags);
+		argc = 2;
+	}
+#endif
+
 #ifdef STABS
 	if (gflag) {
 		stabs_file(argc ? argv[0] : "");
@@ -310,14 +611,13 @@ main(int argc, char *argv[])
 	}
 #endif
 
-	if (sspflag)
-		sspinit();
-
 	(void) yyparse();
 	yyaccpt();
 
-	if (!nerrors)
+	if (!nerrors) {
+		inline_prtout();
 		lcommprint();
+	}
 
 #ifdef STABS
 	if (gflag)
@@ -325,6 +625,14 @@ main(int argc, char *argv[])
 #endif
 
 	ejobcode( nerrors ? 1 : 0 );
+	pass2_done();
+
+#ifdef TARGET_OBJWRITE
+	/* On failure no object is written and the driver runs as(1) */
+	if (objfile && !nerrors && argc > 1 && strcmp(argv[1], "-") != 0 &&
+	    fflush(stdout) == 0)
+		(void)elfasm(argv[1], objfile);
+#endif
 
 #ifdef TIMING
 	(void)gettimeofday(&t2, NULL);
@@ -349,13 +657,18 @@ prtstats(void)
 {
 	extern int nametabs, namestrlen;
 	extern int arglistcnt, dimfuncnt, inlnodecnt, inlstatcnt;
-	extern int symtabcnt, suedefcnt;
-	extern size_t permallocsize, tmpallocsize, lostmem;
+	extern int symtabcnt, suedefcnt, tmpreused;
+	extern int usednodes, maxnodes, narenas, narenasfreed;
+	extern size_t permallocsize, tmpallocsize, tmphiwat, lostmem;
+	extern int rafuncs, rarounds, ramaxrounds, rafull, raincr;
+	extern long rafulltime, raincrtime;
 
 	fprintf(stderr, "Name table entries:		%d pcs\n", nametabs);
 	fprintf(stderr, "Name string size:		%d B\n", namestrlen);
 	fprintf(stderr, "Permanent allocated memory:	%zu B\n", permallocsize);
 	fprintf(stderr, "Temporary allocated memory:	%zu B\n", tmpallocsize);
+	fprintf(stderr, "Temporary memory high-water:	%zu B\n", tmphiwat);
+	fprintf(stderr, "Temporary blocks reused:	%d pcs\n", tmpreused);
 	fprintf(stderr, "Lost memory:			%zu B\n", lostmem);
 	fprintf(stderr, "Argument list unions:		%d pcs\n", arglistcnt);
 	fprintf(stderr, "Dimension/function unions:	%d pcs\n", dimfuncnt);
@@ -363,4 +676,15 @@ prtstats(void)
 	fprintf(stderr, "Inline node count:		%d pcs\n", inlnodecnt);
 	fprintf(stderr, "Inline control blocks:		%d pcs\n", inlstatcnt);
 	fprintf(stderr, "Permanent symtab entries:	%d pcs\n", symtabcnt);
+	fprintf(stderr, "Tree nodes in use:		%d pcs, peak %d pcs\n",
+	    usednodes, maxnodes);
+	fprintf(stderr, "Node arenas:			%d allocated, %d freed\n",
+	    narenas, narenasfreed);
+	fprintf(stderr, "Register allocation rounds:	%d in %d functions\n",
+	    rarounds, rafuncs);
+	fprintf(stderr, "Most rounds in one function:	%d pcs\n", ramaxrounds);
+	fprintf(stderr, "Full graph build rounds:	%d pcs, %ld us/round\n",
+	    rafull, rafull ? rafulltime / rafull : 0L);
+	fprintf(stderr, "Incremental graph rounds:	%d pcs, %ld us/round\n",
+	    raincr, raincr ? raincrtime / raincr : 0L);
 }
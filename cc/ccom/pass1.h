@@ -108,6 +108,7 @@ extern	char *scnames(int);
 
 struct rstack;
 struct symtab;
+struct dinit;
 union arglist;
 #ifdef GCC_COMPAT
 struct gcc_attr_pack;
@@ -179,7 +180,9 @@ extern	OFFSZ inoff;
 
 extern	int reached;
 extern	int isinlining;
-extern	int xinline, xgnu89, xgnu99;
+extern	int xinline, xautoinline, xdelstatic, xgnu89, xgnu99;
+extern	int xdwarf;
+extern	int looplvl;
 extern	int bdebug, ddebug, edebug, idebug, ndebug;
 extern	int odebug, pdebug, sdebug, tdebug, xdebug;
 
@@ -283,6 +286,13 @@ void inline_ref(struct symtab *);
 void inline_prtout(void);
 void inline_args(struct symtab **, int);
 NODE *inlinetree(struct symtab *, NODE *, NODE *);
+int inline_goto(int);
+int inline_static(struct symtab *);
+void inline_alias(char *);
+int inline_isdead(struct symtab *);
+void inline_owner(struct symtab *);
+void inline_dinit(struct symtab *, struct dinit *);
+void dinitprt(struct symtab *, struct dinit *);
 void ftnarg(NODE *);
 struct rstack *bstruct(char *, int, NODE *);
 void moedef(char *);
@@ -348,6 +358,9 @@ int nncon(NODE *);
 void cunput(char);
 NODE *nametree(struct symtab *sp);
 void *inlalloc(int size);
+struct attr *tattr_new(int, int);
+struct attr *tattr_dup(struct attr *, int);
+extern struct interpass_aggr *aggrblks;
 void *blkalloc(int size);
 void pass1_lastchance(struct interpass *);
 void fldty(struct symtab *p);
@@ -581,6 +594,10 @@ void stabs_func(struct symtab *);
 void stabs_newsym(struct symtab *);
 void stabs_chgsym(struct symtab *);
 void stabs_struct(struct symtab *, struct attr *);
+void stabs_args(struct symtab **, int);
+void stabs_common(struct symtab *);
+void stabs_efunc(void);
+void stabs_loc(void);
 #endif
 
 #ifndef CHARCAST
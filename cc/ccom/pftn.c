@@ -130,6 +130,7 @@ static void alprint(union arglist *al, int in);
 static void lcommadd(struct symtab *sp);
 static NODE *mkcmplx(NODE *p, TWORD dt);
 static void cxargfixup(NODE *arg, TWORD dt, struct attr *ap);
+static union dimfun *dfperm(TWORD t, union dimfun *df);
 extern int fun_inline;
 
 void
@@ -184,6 +185,8 @@ defid2(NODE *q, int class, char *astr)
 	fixtype(q, class);
 
 	type = q->n_type;
+	if (blevel > 1 && p->slevel == 0 && !isinlining)
+		q->n_df = dfperm(type, q->n_df); /* may outlive the block */
 	qual = q->n_qual;
 	class = fixclass(class, type);
 
@@ -470,6 +473,16 @@ defid2(NODE *q, int class, char *astr)
 
 done:
 	fixdef(p);	/* Leave last word to target */
+#ifdef GCC_COMPAT
+	{
+		struct attr *at;
+
+		/* the alias target is referenced */
+		if ((at = attr_find(p->sap, GCC_ATYP_ALIAS)) &&
+		    at->sarg(0) != NULL)
+			inline_alias(at->sarg(0));
+	}
+#endif
 #ifndef HAVE_WEAKREF
 	{
 		struct attr *at;
@@ -528,10 +541,15 @@ ftnend(void)
 		send_passt(IP_EPILOG, maxautooff/SZCHAR, c,
 		    cftnsp->stype, cftnsp->sclass == EXTDEF,
 		    retlab, tvaloff, mkclabs());
+#ifdef STABS
+		if (gflag)
+			stabs_efunc();
+#endif
 	}
 
 	cftnod = NIL;
 	tcheck();
+	tslabfree();
 	brklab = contlab = retlab = NOLAB;
 	flostat = 0;
 	if (nerrors == 0) {
@@ -662,7 +680,11 @@ done:	autooff = AUTOINIT;
 	plabel(prolab); /* after prolog, used in optimization */
 	retlab = getlab();
 	bfcode(parr, nparams);
-	if (fun_inline && (xinline
+#ifdef STABS
+	if (gflag)
+		stabs_args(parr, nparams);
+#endif
+	if (isinlining && (xinline || xautoinline
 #ifdef GCC_COMPAT
  || attr_find(cftnsp->sap, GCC_ATYP_ALW_INL)
 #endif
@@ -1001,7 +1023,8 @@ soumemb(NODE *n, char *name, int class)
 	sp->squal = n->n_qual;
 	sp->slevel = blevel;
 	sp->sap = n->n_ap;
-	sp->sdf = n->n_df;
+	sp->sdf = blevel > 1 && !isinlining ? dfperm(sp->stype, n->n_df) :
+	    n->n_df;
 
 	if (class & FIELD) {
 		sp->sclass = (char)class;
@@ -1360,6 +1383,41 @@ upoff(int size, int alignment, int *poff)
 	return (off);
 }
 
+struct interpass_aggr *aggrblks;
+
+/*
+ * Tell pass2 about an automatic on stack.  Small structs with only
+ * scalar members may be split into temporaries if never used as a whole.
+ */
+static void
+aggrblk(struct symtab *p)
+{
+	struct interpass_aggr *ag;
+	struct symtab *m;
+	int n;
+
+	ag = inlalloc(sizeof(struct interpass_aggr));
+	ag->off = p->soffset/SZCHAR;
+	ag->sz = (int)tsize(p->stype, p->sdf, p->sap)/SZCHAR;
+	ag->nmemb = 0;
+	ag->next = aggrblks;
+	aggrblks = ag;
+
+	if (p->stype != STRTY || (cqual(p->stype, p->squal) & VOL))
+		return;
+	n = 0;
+	for (m = strmemb(p->sap); m; m = m->snext, n++) {
+		if (n == NAGGRMEMB || (m->sclass & FIELD) ||
+		    (m->stype >= STRTY && !ISPTR(m->stype)) ||
+		    (cqual(m->stype, m->squal) & VOL) || !cisreg(m->stype))
+			return;
+		ag->moff[n] = ag->off + m->soffset/SZCHAR;
+		ag->mtype[n] = m->stype;
+	}
+	if (n >= 2)
+		ag->nmemb = n;
+}
+
 /*
  * allocate p with offset *poff, and update *poff
  */
@@ -1415,6 +1473,8 @@ oalloc(struct symtab *p, int *poff )
 	}
 
 	*poff = noff;
+	if (xtemps && p->sclass == AUTO && gflag == 0)
+		aggrblk(p);
 	return(0);
 }
 
@@ -1716,8 +1776,13 @@ lcommprint(void)
 	struct lcd *lc;
 
 	SLIST_FOREACH(lc, &lhead, next) {
-		if (lc->sp != NULL)
+		if (lc->sp != NULL && !inline_isdead(lc->sp)) {
 			commchk(lc->sp);
+#ifdef STABS
+			if (gflag)
+				stabs_common(lc->sp);
+#endif
+		}
 	}
 }
 
@@ -2005,7 +2070,7 @@ arglist(NODE *n)
 
 	/* Second: Create list to work on */
 	ap = tmpalloc(sizeof(NODE *) * cnt);
-	al = permalloc(sizeof(union arglist) * num);
+	al = blkalloc(sizeof(union arglist) * num);
 	arglistcnt += num;
 
 	for (w = n, i = 0; w->n_op == CM; w = w->n_left)
@@ -2176,7 +2241,7 @@ tymerge(NODE *typ, NODE *idp)
 			tylkadd(*j++, &tylkp, &ntdim);
 
 	if (ntdim) {
-		union dimfun *a = permalloc(sizeof(union dimfun) * ntdim);
+		union dimfun *a = blkalloc(sizeof(union dimfun) * ntdim);
 		dimfuncnt += ntdim;
 		for (i = 0, base = tylnk.next; base; base = base->next, i++)
 			a[i] = base->df;
@@ -2537,7 +2602,9 @@ out:		al++;
 	if (apole != NULL)
 		uerror("too many arguments to function");
 
-build:	if (sp != NULL && (sp->sflags & SINLINE) && (w = inlinetree(sp, f, a)))
+build:	if (sp != NULL && (sp->sflags & SINLINE) == 0 && inline_static(sp))
+		inline_ref(sp);
+	if (sp != NULL && (sp->sflags & SINLINE) && (w = inlinetree(sp, f, a)))
 		return w;
 	return buildtree(a == NIL ? UCALL : CALL, f, a);
 }
@@ -2955,6 +3022,74 @@ sspend(void)
 	plabel(lab);
 }
 
+/*
+ * Copy a prototype list built by blkalloc() to the permanent heap.
+ */
+static union arglist *
+alperm(union arglist *al)
+{
+	union arglist *n;
+	TWORD t;
+	int k;
+
+	if (al == NULL)
+		return NULL;
+	for (k = 0; al[k].type != TNULL; k++) {
+		if (al[k].type == TELLIPSIS)
+			continue;
+		t = al[k].type;
+		if (BTYPE(t) == STRTY || BTYPE(t) == UNIONTY)
+			k++;
+		while (!ISFTN(t) && !ISARY(t) && t > BTMASK)
+			t = DECREF(t);
+		if (t > BTMASK)
+			k++;
+	}
+	n = permalloc(sizeof(union arglist) * (k+1));
+	arglistcnt += k+1;
+	for (k = 0; al[k].type != TNULL; k++) {
+		n[k] = al[k];
+		if (al[k].type == TELLIPSIS)
+			continue;
+		t = al[k].type;
+		if (BTYPE(t) == STRTY || BTYPE(t) == UNIONTY)
+			k++, n[k] = al[k];
+		while (!ISFTN(t) && !ISARY(t) && t > BTMASK)
+			t = DECREF(t);
+		if (t > BTMASK)
+			k++, n[k].df = dfperm(t, al[k].df);
+	}
+	n[k].type = TNULL;
+	return n;
+}
+
+/*
+ * Copy the dimension/prototype array of type t to the permanent heap,
+ * for declarations inside a function that must survive tmpfree().
+ */
+static union dimfun *
+dfperm(TWORD t, union dimfun *df)
+{
+	union dimfun *d;
+	TWORD w;
+	int n;
+
+	for (n = 0, w = t; w > BTMASK; w = DECREF(w))
+		if (ISARY(w) || ISFTN(w))
+			n++;
+	if (n == 0 || df == NULL)
+		return df;
+	d = permalloc(sizeof(union dimfun) * n);
+	dimfuncnt += n;
+	for (n = 0, w = t; w > BTMASK; w = DECREF(w)) {
+		if (ISARY(w))
+			d[n] = df[n], n++;
+		else if (ISFTN(w))
+			d[n].dfun = alperm(df[n].dfun), n++;
+	}
+	return d;
+}
+
 /*
  * Allocate on the permanent heap for inlines, otherwise temporary heap.
  */
@@ -2973,6 +3108,32 @@ inlalloc(int size)
 	return isinlining ?  permalloc(size) : tmpalloc(size);
 }
 
+/*
+ * As attr_new() and attr_dup(), but for attributes that only live on
+ * trees and can go away with the rest of the function.
+ */
+struct attr *
+tattr_new(int type, int nelem)
+{
+	struct attr *ap;
+	int sz;
+
+	sz = sizeof(struct attr) + nelem * sizeof(union aarg);
+	ap = memset(inlalloc(sz), 0, sz);
+	ap->atype = type;
+	return ap;
+}
+
+struct attr *
+tattr_dup(struct attr *ap, int n)
+{
+	int sz = sizeof(struct attr) + n * sizeof(union aarg);
+
+	ap = memcpy(inlalloc(sz), ap, sz);
+	ap->next = NULL;
+	return ap;
+}
+
 /*
  * Fetch pointer to first member in a struct list.
  */
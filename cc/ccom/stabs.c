@@ -32,6 +32,8 @@
  * Not complete but at least makes it possible to set breakpoints,
  * examine simple variables and do stack traces.
  * Based on the stabs documentation that follows gdb.
+ *
+ * With -xdwarf, DWARF is written instead; see the end of this file.
  */
 
 #include "pass1.h"
@@ -40,7 +42,9 @@
 
 #include <sys/types.h>
 #include <stdarg.h>
+#include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #define	STABHASH	256
 #define	INTNUM		1	/* internal number of type "int" */
@@ -76,6 +80,7 @@ static struct stabtype {
 	union dimfun *df;	/* dimension of arrays */
 	struct attr *ap;	/* struct/union/enum declarations */
 	int num;		/* local type number */
+	struct stabtype *dnext;	/* DWARF output order */
 } *stabhash[STABHASH];
 static int ntypes;
 static char *curfun;
@@ -88,6 +93,14 @@ struct stabtype *findtype(TWORD t, union dimfun *df, struct attr *sue);
 void printtype(struct symtab *s, char *str, int len);
 void cprint(int p2, char *fmt, ...);
 
+static void dwfile(char *);
+static void dwfunc(struct symtab *);
+static void dwsym(struct symtab *);
+static void dwlbrac(void);
+static void dwrbrac(void);
+static void dwstruct(struct symtab *, struct attr *);
+static void dwend(void);
+
 #define	MAXPSTR	100
 
 extern int isinlining;
@@ -101,6 +114,9 @@ stabs_init(void)
 {
 	struct stabtype *st;
 
+	if (xdwarf)
+		return; /* types are written when used */
+
 #define	ADDTYPE(y) addtype(y, NULL, 0)
 
 	ptype("int", ADDTYPE(INT)->num, INTNUM, MIN_INT, MAX_INT);
@@ -145,12 +161,24 @@ struct stabtype *
 addtype(TWORD t, union dimfun *df, struct attr *ap)
 {
 	struct stabtype *st;
+	union dimfun *d;
+	TWORD w;
+	int n;
 
+	/* df may be on the temporary heap; keep a copy */
+	for (n = 0, w = t; w > BTMASK; w = DECREF(w))
+		if (ISARY(w) || ISFTN(w))
+			n++;
+	if (n && df) {
+		d = permalloc(sizeof(union dimfun) * n);
+		df = memcpy(d, df, sizeof(union dimfun) * n);
+	}
 	st = permalloc(sizeof(struct stabtype));
 	st->type = t;
 	st->df = df;
 	st->ap = ap;
 	st->num = ++ntypes;
+	st->dnext = NULL;
 	st->next = stabhash[t & (STABHASH-1)];
 	stabhash[t & (STABHASH-1)] = st;
 	return st;
@@ -182,7 +210,8 @@ findtype(TWORD t, union dimfun *df, struct attr *ap)
 					dw++, dx++;
 				else
 					break;
-			}
+			} else if (ISFTN(tw))
+				dw++, dx++;
 		}
 		if (tw <= BTMASK)
 			return st;
@@ -196,7 +225,7 @@ findtype(TWORD t, union dimfun *df, struct attr *ap)
 void
 stabs_line(int line)
 {
-	if (inftn == 0)
+	if (inftn == 0 || xdwarf)
 		return; /* ignore */
 #ifdef STAB_LINE_ABSOLUTE
 	cprint(1, "\t.stabn %d,0,%d," STABLBL "\n" STABLBL ":\n",
@@ -214,6 +243,10 @@ stabs_line(int line)
 void
 stabs_lbrac(int blklvl)
 {
+	if (xdwarf) {
+		dwlbrac();
+		return;
+	}
 #ifdef STAB_LINE_ABSOLUTE
 	cprint(1, "\t.stabn %d,0,%d," STABLBL "\n" STABLBL ":\n",
 	    N_LBRAC, blklvl, stablbl, stablbl);
@@ -230,6 +263,10 @@ stabs_lbrac(int blklvl)
 void
 stabs_rbrac(int blklvl)
 {
+	if (xdwarf) {
+		dwrbrac();
+		return;
+	}
 #ifdef STAB_LINE_ABSOLUTE
 	cprint(1, "\t.stabn %d,0,%d," STABLBL "\n" STABLBL ":\n",
 	    N_RBRAC, blklvl, stablbl, stablbl);
@@ -248,6 +285,10 @@ static char *mainfile;
 void
 stabs_file(char *fname)
 {
+	if (xdwarf) {
+		dwfile(fname);
+		return;
+	}
 	if (mainfile == NULL)
 		mainfile = fname; /* first call */
 	cprint(inftn, "\t.stabs	\"%s\",%d,0,0," STABLBL "\n" STABLBL ":\n",
@@ -261,6 +302,10 @@ stabs_file(char *fname)
 void
 stabs_efile(char *fname)
 {
+	if (xdwarf) {
+		dwend();
+		return;
+	}
 	cprint(inftn, "\t.stabs	\"\",%d,0,0," STABLBL "\n" STABLBL ":\n",
 	    fname == mainfile ? N_SO : N_SOL, stablbl, stablbl);
 	stablbl++;
@@ -276,6 +321,10 @@ stabs_func(struct symtab *s)
 
 	if ((curfun = s->soname) == NULL)
 		curfun = addname(exname(s->sname));
+	if (xdwarf) {
+		dwfunc(s);
+		return;
+	}
 	printtype(s, str, sizeof(str));
 	cprint(1, "\t.stabs	\"%s:%c%s\",%d,0,%d,%s\n",
 	    curfun, s->sclass == STATIC ? 'f' : 'F', str,
@@ -298,7 +347,7 @@ printtype(struct symtab *s, char *ostr, int len)
 
 	/* Print out not-yet-found types */
 	if (ISFTN(t))
-		t = DECREF(t);
+		t = DECREF(t), df++;
 	st = findtype(t, df, ap);
 	while (st == NULL && t > BTMASK) {
 		st = addtype(t, df, ap);
@@ -311,7 +360,7 @@ printtype(struct symtab *s, char *ostr, int len)
 			op+=snprintf(ostr+op, len - op, "ar%d;0;%d;", INTNUM, df->ddim-1);
 		} else
 			cerror("printtype: notype");
-		if (ISARY(t))
+		if (ISARY(t) || ISFTN(t))
 			df++;
 		t = DECREF(t);
 		st = findtype(t, df, ap);
@@ -333,6 +382,11 @@ stabs_newsym(struct symtab *s)
 
 	if (ISFTN(s->stype))
 		return; /* functions are handled separate */
+	if (xdwarf) {
+		if (s->sclass != PARAM)
+			dwsym(s);
+		return;
+	}
 
 	if (s->sclass == STNAME || s->sclass == UNAME || s->sclass == MOS ||
 	    s->sclass == ENAME || s->sclass == MOU || s->sclass == MOE ||
@@ -400,6 +454,8 @@ stabs_chgsym(struct symtab *s)
 void
 stabs_struct(struct symtab *p, struct attr *ap)
 {
+	if (xdwarf)
+		dwstruct(p, ap);
 }
 
 struct stabsv {
@@ -457,4 +513,602 @@ cprint(int p2, char *fmt, ...)
 	va_end(ap);
 }
 
+/*
+ * DWARF output.
+ *
+ * Line numbers are handed to the assembler as .file/.loc directives
+ * and it builds the line program from them.  A .loc is only written
+ * in front of a statement that generates code, and only when the
+ * line has changed.  The .debug_info entries are collected in memory
+ * and written out at the end of the file, followed by the types they
+ * refer to.  Types are kept in the same cache as for stabs, so each
+ * is written once.
+ */
+#define	DW_TAG_array_type	0x01
+#define	DW_TAG_formal_parameter	0x05
+#define	DW_TAG_lexical_block	0x0b
+#define	DW_TAG_member		0x0d
+#define	DW_TAG_pointer_type	0x0f
+#define	DW_TAG_compile_unit	0x11
+#define	DW_TAG_structure_type	0x13
+#define	DW_TAG_subroutine_type	0x15
+#define	DW_TAG_union_type	0x17
+#define	DW_TAG_subrange_type	0x21
+#define	DW_TAG_base_type	0x24
+#define	DW_TAG_subprogram	0x2e
+#define	DW_TAG_variable		0x34
+
+#define	DW_AT_location		0x02
+#define	DW_AT_name		0x03
+#define	DW_AT_byte_size		0x0b
+#define	DW_AT_bit_size		0x0d
+#define	DW_AT_stmt_list		0x10
+#define	DW_AT_low_pc		0x11
+#define	DW_AT_high_pc		0x12
+#define	DW_AT_language		0x13
+#define	DW_AT_comp_dir		0x1b
+#define	DW_AT_producer		0x25
+#define	DW_AT_upper_bound	0x2f
+#define	DW_AT_data_member_location 0x38
+#define	DW_AT_decl_file		0x3a
+#define	DW_AT_decl_line		0x3b
+#define	DW_AT_declaration	0x3c
+#define	DW_AT_encoding		0x3e
+#define	DW_AT_external		0x3f
+#define	DW_AT_type		0x49
+#define	DW_AT_data_bit_offset	0x6b
+
+#define	DW_FORM_addr		0x01
+#define	DW_FORM_string		0x08
+#define	DW_FORM_data1		0x0b
+#define	DW_FORM_flag		0x0c
+#define	DW_FORM_udata		0x0f
+#define	DW_FORM_ref4		0x13
+#define	DW_FORM_sec_offset	0x17
+#define	DW_FORM_exprloc		0x18
+#define	DW_FORM_flag_present	0x19
+
+#define	DW_ATE_boolean		0x02
+#define	DW_ATE_float		0x04
+#define	DW_ATE_signed		0x05
+#define	DW_ATE_signed_char	0x06
+#define	DW_ATE_unsigned		0x08
+#define	DW_ATE_unsigned_char	0x08
+
+#define	DW_OP_addr		0x03
+#define	DW_OP_breg0		0x70
+
+#define	DW_LANG_C99		0x0c
+
+/*
+ * Abbreviations, in code order.  Each is a tag, a children flag
+ * and a zero-terminated list of attribute/form pairs.
+ */
+enum { A_CU = 1, A_BASE, A_PTR, A_VPTR, A_ARRAY, A_SUBR, A_XSUBR,
+	A_FTN, A_VFTN, A_STRUCT, A_XSTRUCT, A_UNION, A_XUNION, A_DSTRUCT,
+	A_DUNION, A_MEMBER, A_XMEMBER, A_BMEMBER, A_FUNC, A_VFUNC,
+	A_PARAM, A_XPARAM, A_VAR, A_XVAR, A_BLOCK, A_MAX };
+
+static unsigned char dwabbrev[A_MAX-1][18] = {
+	{ DW_TAG_compile_unit, 1, DW_AT_producer, DW_FORM_string,
+	  DW_AT_language, DW_FORM_data1, DW_AT_name, DW_FORM_string,
+	  DW_AT_comp_dir, DW_FORM_string,
+	  DW_AT_stmt_list, DW_FORM_sec_offset },
+	{ DW_TAG_base_type, 0, DW_AT_name, DW_FORM_string,
+	  DW_AT_encoding, DW_FORM_data1, DW_AT_byte_size, DW_FORM_data1 },
+	{ DW_TAG_pointer_type, 0, DW_AT_byte_size, DW_FORM_data1,
+	  DW_AT_type, DW_FORM_ref4 },
+	{ DW_TAG_pointer_type, 0, DW_AT_byte_size, DW_FORM_data1 },
+	{ DW_TAG_array_type, 1, DW_AT_type, DW_FORM_ref4 },
+	{ DW_TAG_subrange_type, 0, DW_AT_upper_bound, DW_FORM_udata },
+	{ DW_TAG_subrange_type, 0 },
+	{ DW_TAG_subroutine_type, 0, DW_AT_type, DW_FORM_ref4 },
+	{ DW_TAG_subroutine_type, 0 },
+	{ DW_TAG_structure_type, 1, DW_AT_name, DW_FORM_string,
+	  DW_AT_byte_size, DW_FORM_udata },
+	{ DW_TAG_structure_type, 1, DW_AT_byte_size, DW_FORM_udata },
+	{ DW_TAG_union_type, 1, DW_AT_name, DW_FORM_string,
+	  DW_AT_byte_size, DW_FORM_udata },
+	{ DW_TAG_union_type, 1, DW_AT_byte_size, DW_FORM_udata },
+	{ DW_TAG_structure_type, 0, DW_AT_declaration, DW_FORM_flag_present },
+	{ DW_TAG_union_type, 0, DW_AT_declaration, DW_FORM_flag_present },
+	{ DW_TAG_member, 0, DW_AT_name, DW_FORM_string,
+	  DW_AT_type, DW_FORM_ref4,
+	  DW_AT_data_member_location, DW_FORM_udata },
+	{ DW_TAG_member, 0, DW_AT_type, DW_FORM_ref4,
+	  DW_AT_data_member_location, DW_FORM_udata },
+	{ DW_TAG_member, 0, DW_AT_name, DW_FORM_string,
+	  DW_AT_type, DW_FORM_ref4, DW_AT_bit_size, DW_FORM_udata,
+	  DW_AT_data_bit_offset, DW_FORM_udata },
+	{ DW_TAG_subprogram, 1, DW_AT_name, DW_FORM_string,
+	  DW_AT_decl_file, DW_FORM_udata, DW_AT_decl_line, DW_FORM_udata,
+	  DW_AT_external, DW_FORM_flag, DW_AT_type, DW_FORM_ref4,
+	  DW_AT_low_pc, DW_FORM_addr, DW_AT_high_pc, DW_FORM_addr },
+	{ DW_TAG_subprogram, 1, DW_AT_name, DW_FORM_string,
+	  DW_AT_decl_file, DW_FORM_udata, DW_AT_decl_line, DW_FORM_udata,
+	  DW_AT_external, DW_FORM_flag,
+	  DW_AT_low_pc, DW_FORM_addr, DW_AT_high_pc, DW_FORM_addr },
+	{ DW_TAG_formal_parameter, 0, DW_AT_name, DW_FORM_string,
+	  DW_AT_type, DW_FORM_ref4, DW_AT_location, DW_FORM_exprloc },
+	{ DW_TAG_formal_parameter, 0, DW_AT_name, DW_FORM_string,
+	  DW_AT_type, DW_FORM_ref4 },
+	{ DW_TAG_variable, 0, DW_AT_name, DW_FORM_string,
+	  DW_AT_type, DW_FORM_ref4, DW_AT_external, DW_FORM_flag,
+	  DW_AT_location, DW_FORM_exprloc },
+	{ DW_TAG_variable, 0, DW_AT_name, DW_FORM_string,
+	  DW_AT_type, DW_FORM_ref4 },
+	{ DW_TAG_lexical_block, 1, DW_AT_low_pc, DW_FORM_addr,
+	  DW_AT_high_pc, DW_FORM_addr },
+};
+
+static struct dwbase {
+	TWORD type;
+	char *name;
+	int enc;
+} dwbase[] = {
+	{ INT, "int", DW_ATE_signed },	/* first, used for unknown types */
+	{ BOOL, "_Bool", DW_ATE_boolean },
+	{ CHAR, "char", DW_ATE_signed_char },
+	{ UCHAR, "unsigned char", DW_ATE_unsigned_char },
+	{ SHORT, "short", DW_ATE_signed },
+	{ USHORT, "unsigned short", DW_ATE_unsigned },
+	{ UNSIGNED, "unsigned int", DW_ATE_unsigned },
+	{ LONG, "long", DW_ATE_signed },
+	{ ULONG, "unsigned long", DW_ATE_unsigned },
+	{ LONGLONG, "long long", DW_ATE_signed },
+	{ ULONGLONG, "unsigned long long", DW_ATE_unsigned },
+	{ FLOAT, "float", DW_ATE_float },
+	{ DOUBLE, "double", DW_ATE_float },
+	{ LDOUBLE, "long double", DW_ATE_float },
+	{ 0 },
+};
+
+#define	DWADDR	(SZPOINT(CHAR) > 32 ? "\t.8byte " : "\t.4byte ")
+
+static char *dwbuf;		/* .debug_info entries */
+static int dwlen, dwsize;
+static char *dwname;		/* compilation unit name */
+static int dwncalls;
+static struct dwfile {
+	struct dwfile *next;
+	char *name;
+	int num;
+} *dwfiles, *dwlfile;		/* line table files, last used */
+static int dwnfiles;
+static int dwline;		/* line of last .loc */
+static int dwfn;		/* in a function with entries */
+static int dwfend;		/* label at end of function */
+static struct dwblk {
+	struct dwblk *next;
+	int lbl;
+} *dwblks;			/* labels at end of open blocks */
+static struct dwtag {
+	struct dwtag *next;
+	struct attr *ap;
+	char *name;
+} *dwtags[STABHASH];		/* struct tag names */
+static struct stabtype *dwtypes, **dwtlast = &dwtypes;
+
+#define	DWTHASH(ap)	(((size_t)(ap) >> 4) & (STABHASH-1))
+
+/*
+ * Append to the .debug_info text.
+ */
+static void
+dwout(char *fmt, ...)
+{
+	va_list ap;
+	int n;
+
+	for (;;) {
+		va_start(ap, fmt);
+		n = vsnprintf(dwbuf + dwlen, dwsize - dwlen, fmt, ap);
+		va_end(ap);
+		if (n < dwsize - dwlen)
+			break;
+		dwsize = dwsize * 2 + n + 4096;
+		if ((dwbuf = realloc(dwbuf, dwsize)) == NULL)
+			cerror("out of memory");
+	}
+	dwlen += n;
+}
+
+/*
+ * Find the cached type for (t, df, ap), adding it if it is new.
+ * Of the attributes only the struct member list matters.
+ */
+static struct stabtype *
+dwtype(TWORD t, union dimfun *df, struct attr *ap)
+{
+	struct stabtype *st;
+
+	ap = ISSOU(BTYPE(t)) ? strattr(ap) : NULL;
+	if ((st = findtype(t, df, ap)) == NULL) {
+		st = addtype(t, df, ap);
+		*dwtlast = st;
+		dwtlast = &st->dnext;
+	}
+	return st;
+}
+
+static void
+dwref(TWORD t, union dimfun *df, struct attr *ap)
+{
+	dwout("\t.4byte .Ldt%d-.Ldebug_info0\n", dwtype(t, df, ap)->num);
+}
+
+/*
+ * Return the line table number of a file, declaring it if new.
+ * The .file is printed at once, so it precedes any .loc using it.
+ */
+static int
+dwfileno(char *name)
+{
+	struct dwfile *f;
+
+	if (dwlfile != NULL && dwlfile->name == name)
+		return dwlfile->num;
+	for (f = dwfiles; f; f = f->next)
+		if (f->name == name)
+			break;
+	if (f == NULL) {
+		f = permalloc(sizeof(struct dwfile));
+		f->name = name;
+		f->num = ++dwnfiles;
+		f->next = dwfiles;
+		dwfiles = f;
+		printf("\t.file %d \"%s\"\n", f->num, name);
+	}
+	dwlfile = f;
+	return f->num;
+}
+
+static void
+dwfile(char *fname)
+{
+	/* first the input file, then the name from cpp */
+	if (dwncalls++ < 2)
+		dwname = fname;
+}
+
+static void
+dwfunc(struct symtab *s)
+{
+	TWORD t = DECREF(s->stype);
+	int n;
+
+	if ((dwfn = !isinlining) == 0)
+		return;
+
+	/* for the prologue, the function code follows later */
+	n = dwfileno(ftitle);
+	printf("\t.loc %d %d\n", n, lineno);
+	dwline = lineno;
+
+	dwfend = stablbl++;
+	dwout("\t.uleb128 %d\n\t.string \"%s\"\n\t.uleb128 %d,%d\n"
+	    "\t.byte %d\n", t == VOID ? A_VFUNC : A_FUNC, s->sname,
+	    n, lineno, s->sclass != STATIC);
+	if (t != VOID)
+		dwref(t, s->sdf + 1, s->sap);
+	dwout("%s%s\n%s" STABLBL "\n", DWADDR, curfun, DWADDR, dwfend);
+}
+
+/*
+ * Write a variable or parameter.  Those in temporaries may be
+ * anywhere, so they get no location.
+ */
+static void
+dwvar(struct symtab *s)
+{
+	char *name = NULL;
+	int loc = 0, n;
+#ifdef DWARF_FPREG
+	int off, v;
+#endif
+
+	switch (s->sclass) {
+	case PARAM:
+	case AUTO:
+#ifdef DWARF_FPREG
+		if ((s->sflags & (STNODE|SDYNARRAY)) == 0)
+			loc = 'f';
+#endif
+		break;
+	case STATIC:
+		if (blevel) {
+			loc = 'l';
+			break;
+		}
+		/* FALLTHROUGH */
+	case EXTERN:
+	case EXTDEF:
+		if ((name = s->soname) == NULL)
+			name = exname(s->sname);
+		loc = 'n';
+		break;
+	}
+
+	if (s->sclass == PARAM)
+		n = loc ? A_PARAM : A_XPARAM;
+	else
+		n = loc ? A_VAR : A_XVAR;
+	dwout("\t.uleb128 %d\n\t.string \"%s\"\n", n, s->sname);
+	dwref(s->stype, s->sdf, s->sap);
+	if (n == A_VAR)
+		dwout("\t.byte %d\n",
+		    s->sclass == EXTDEF || s->sclass == EXTERN);
+
+	switch (loc) {
+#ifdef DWARF_FPREG
+	case 'f': /* DW_OP_bregN off, from the frame pointer */
+		off = BIT2BYTE(s->soffset);
+		for (n = 2, v = off; v < -64 || v > 63; v >>= 7)
+			n++;
+		dwout("\t.uleb128 %d\n\t.byte %d\n\t.sleb128 %d\n",
+		    n, DW_OP_breg0 + DWARF_FPREG, off);
+		break;
+#endif
+	case 'l':
+		dwout("\t.uleb128 %d\n\t.byte %d\n%s" LABFMT "\n",
+		    1 + SZPOINT(CHAR)/SZCHAR, DW_OP_addr, DWADDR, s->soffset);
+		break;
+	case 'n':
+		dwout("\t.uleb128 %d\n\t.byte %d\n%s%s\n",
+		    1 + SZPOINT(CHAR)/SZCHAR, DW_OP_addr, DWADDR, name);
+		break;
+	}
+}
+
+static void
+dwsym(struct symtab *s)
+{
+	if (isinlining || (blevel && !dwfn))
+		return;
+	switch (s->sclass) {
+	case AUTO:
+	case REGISTER:
+	case STATIC:
+	case EXTDEF:
+		dwvar(s);
+		break;
+	default:
+		break; /* declarations, types and members */
+	}
+}
+
+static void
+dwlbrac(void)
+{
+	struct dwblk *b;
+	int lbl;
+
+	if (!dwfn)
+		return;
+	b = tmpalloc(sizeof(struct dwblk));
+	lbl = stablbl++;
+	b->lbl = stablbl++;
+	b->next = dwblks;
+	dwblks = b;
+	cprint(1, STABLBL ":\n", lbl);
+	dwout("\t.uleb128 %d\n%s" STABLBL "\n%s" STABLBL "\n",
+	    A_BLOCK, DWADDR, lbl, DWADDR, b->lbl);
+}
+
+static void
+dwrbrac(void)
+{
+	if (!dwfn || dwblks == NULL)
+		return;
+	cprint(1, STABLBL ":\n", dwblks->lbl);
+	dwout("\t.byte 0\n");
+	dwblks = dwblks->next;
+}
+
+/*
+ * Remember struct tag names; the members are found through ap.
+ */
+static void
+dwstruct(struct symtab *p, struct attr *ap)
+{
+	struct dwtag *t;
+
+	if (p == NULL || (ap = strattr(ap)) == NULL)
+		return;
+	t = permalloc(sizeof(struct dwtag));
+	t->ap = ap;
+	t->name = p->sname;
+	t->next = dwtags[DWTHASH(ap)];
+	dwtags[DWTHASH(ap)] = t;
+}
+
+static char *
+dwtagname(struct attr *ap)
+{
+	struct dwtag *t;
+
+	for (t = dwtags[DWTHASH(ap)]; t; t = t->next)
+		if (t->ap == ap)
+			return t->name;
+	return NULL;
+}
+
+/*
+ * Write a type.  The types it refers to are added to the list.
+ */
+static void
+dwtdie(struct stabtype *st)
+{
+	struct attr *ap = st->ap;
+	union dimfun *df = st->df;
+	struct symtab *sp;
+	struct dwbase *b;
+	TWORD t = st->type;
+	char *name;
+
+	dwout(".Ldt%d:\n", st->num);
+	if (ISPTR(t)) {
+		dwout("\t.uleb128 %d\n\t.byte %d\n",
+		    DECREF(t) == VOID ? A_VPTR : A_PTR, SZPOINT(t)/SZCHAR);
+		if (DECREF(t) != VOID)
+			dwref(DECREF(t), df, ap);
+	} else if (ISARY(t)) {
+		dwout("\t.uleb128 %d\n", A_ARRAY);
+		dwref(DECREF(t), df + 1, ap);
+		if (df->ddim > 0)
+			dwout("\t.uleb128 %d,%d\n", A_SUBR, df->ddim - 1);
+		else
+			dwout("\t.uleb128 %d\n", A_XSUBR);
+		dwout("\t.byte 0\n");
+	} else if (ISFTN(t)) {
+		dwout("\t.uleb128 %d\n", DECREF(t) == VOID ? A_VFTN : A_FTN);
+		if (DECREF(t) != VOID)
+			dwref(DECREF(t), df + 1, ap);
+	} else if (ISSOU(t)) {
+		if (ap == NULL || ap->amlist == NULL) {
+			/* incomplete */
+			dwout("\t.uleb128 %d\n",
+			    t == STRTY ? A_DSTRUCT : A_DUNION);
+			return;
+		}
+		if ((name = dwtagname(ap)) != NULL)
+			dwout("\t.uleb128 %d\n\t.string \"%s\"\n",
+			    t == STRTY ? A_STRUCT : A_UNION, name);
+		else
+			dwout("\t.uleb128 %d\n",
+			    t == STRTY ? A_XSTRUCT : A_XUNION);
+		dwout("\t.uleb128 %d\n", ap->amsize/SZCHAR);
+		for (sp = ap->amlist; sp != NULL; sp = sp->snext) {
+			if (sp->sclass & FIELD) {
+				dwout("\t.uleb128 %d\n\t.string \"%s\"\n",
+				    A_BMEMBER, sp->sname);
+				dwref(sp->stype, sp->sdf, sp->sap);
+				dwout("\t.uleb128 %d,%d\n",
+				    sp->sclass & FLDSIZ, (int)sp->soffset);
+				continue;
+			}
+			if (*sp->sname == '*') /* unnamed member */
+				dwout("\t.uleb128 %d\n", A_XMEMBER);
+			else
+				dwout("\t.uleb128 %d\n\t.string \"%s\"\n",
+				    A_MEMBER, sp->sname);
+			dwref(sp->stype, sp->sdf, sp->sap);
+			dwout("\t.uleb128 %d\n", (int)(sp->soffset/SZCHAR));
+		}
+		dwout("\t.byte 0\n");
+	} else {
+		for (b = dwbase; b->name; b++)
+			if (b->type == t)
+				break;
+		if (b->name == NULL)
+			b = dwbase;
+		dwout("\t.uleb128 %d\n\t.string \"%s\"\n\t.byte %d,%d\n",
+		    A_BASE, b->name, b->enc,
+		    (int)(tsize(b->type, NULL, NULL)/SZCHAR));
+	}
+}
+
+/*
+ * End of file; write the abbreviations and the collected entries.
+ */
+static void
+dwend(void)
+{
+	struct stabtype *st;
+	unsigned char *a;
+	char cwd[1024];
+	int i;
+
+	for (st = dwtypes; st; st = st->dnext)
+		dwtdie(st);
+
+	printf("\t.pushsection .debug_abbrev\n.Ldebug_abbrev0:\n");
+	for (i = 0; i < A_MAX-1; i++) {
+		a = dwabbrev[i];
+		printf("\t.uleb128 %d,%d\n\t.byte %d\n", i + 1, a[0], a[1]);
+		for (a += 2; *a; a += 2)
+			printf("\t.uleb128 %d,%d\n", a[0], a[1]);
+		printf("\t.byte 0,0\n");
+	}
+	printf("\t.byte 0\n\t.popsection\n");
+
+	/* the assembler puts the line program here */
+	printf("\t.pushsection .debug_line\n.Ldebug_line0:\n\t.popsection\n");
+
+	if (getcwd(cwd, sizeof(cwd)) == NULL)
+		cwd[0] = 0;
+	printf("\t.pushsection .debug_info\n.Ldebug_info0:\n"
+	    "\t.4byte .Ldebug_info1-.Ldebug_info0-4\n\t.2byte 4\n"
+	    "\t.4byte .Ldebug_abbrev0\n\t.byte %d\n",
+	    (int)(SZPOINT(CHAR)/SZCHAR));
+	printf("\t.uleb128 %d\n\t.string \"PCC: %s\"\n\t.byte %d\n"
+	    "\t.string \"%s\"\n\t.string \"%s\"\n\t.4byte .Ldebug_line0\n",
+	    A_CU, VERSSTR, DW_LANG_C99, dwname ? dwname : "", cwd);
+	if (dwlen)
+		fwrite(dwbuf, 1, dwlen, stdout);
+	printf("\t.byte 0\n.Ldebug_info1:\n\t.popsection\n");
+	free(dwbuf);
+	dwbuf = NULL;
+	dwlen = dwsize = 0;
+}
+
+/*
+ * Function parameters, once bfcode() has put them in place.
+ * Only used for DWARF, stabs writes them at declaration.
+ */
+void
+stabs_args(struct symtab **sp, int cnt)
+{
+	int i;
+
+	if (!xdwarf || !dwfn || sp == NULL)
+		return;
+	for (i = 0; i < cnt; i++)
+		if (sp[i] != NULL)
+			dwvar(sp[i]);
+}
+
+/*
+ * A tentative definition written out as common at end of file.
+ * Stabs has it already, DWARF skips extern declarations until now.
+ */
+void
+stabs_common(struct symtab *s)
+{
+	if (xdwarf && s->sclass == EXTERN)
+		dwvar(s);
+}
+
+/*
+ * End of function, after the epilog has been written.
+ */
+void
+stabs_efunc(void)
+{
+	if (!xdwarf || !dwfn)
+		return;
+	printf(STABLBL ":\n", dwfend);
+	dwout("\t.byte 0\n");
+	dwblks = NULL;
+	dwfn = 0;
+}
+
+/*
+ * A statement is about to be sent to pass2; tell the assembler
+ * where it came from if that is a new line.
+ */
+void
+stabs_loc(void)
+{
+	int n;
+
+	if (!xdwarf || !dwfn || inftn == 0 || blevel == 0)
+		return; /* blevel 0 is the epilog, sent at once */
+	if (lineno == dwline && dwlfile != NULL && dwlfile->name == ftitle)
+		return;
+	n = dwfileno(ftitle);
+	dwline = lineno;
+	cprint(1, "\t.loc %d %d\n", n, lineno);
+}
+
 #endif
@@ -70,6 +70,7 @@
 # include "pass2.h"
 
 # include <stdarg.h>
+# include <stdlib.h>
 # include <string.h>
 
 static void chkpun(NODE *p);
@@ -1996,7 +1997,10 @@ comops(NODE *p)
 		/* XXX hack for GCC ({ }) ops */
 		if (p->n_left->n_op == GOTO) {
 			int v = (int)p->n_left->n_left->n_lval;
-			ecomp(p->n_left);
+			if (inline_goto(v))
+				tfree(p->n_left);
+			else
+				ecomp(p->n_left);
 			plabel(v+1);
 		} else
 			ecomp(p->n_left); /* will recurse if more COMOPs */
@@ -2775,7 +2779,7 @@ p2tree(NODE *p)
 	p->n_ap = NULL;
 	for (ap = oap; ap; ap = ap->next)
 		if (ap->atype < ATTR_MI_MAX)
-			p->n_ap = attr_add(p->n_ap, attr_dup(ap, 3));
+			p->n_ap = attr_add(p->n_ap, tattr_dup(ap, 3));
 	/* XXX store size of attr in itself */
 
 	ty = coptype(p->n_op);
@@ -2801,7 +2805,7 @@ p2tree(NODE *p)
 	case STARG:
 	case STCALL:
 	case USTCALL:
-		ap = attr_new(ATTR_P2STRUCT, 2);
+		ap = tattr_new(ATTR_P2STRUCT, 2);
 		p->n_ap = attr_add(p->n_ap, ap);
 		/* STASG used for stack array init */
 		if (p->n_op == STASG && ISARY(p->n_type)) {
@@ -3096,6 +3100,10 @@ send_passt(int type, ...)
 			tfree(va_arg(ap, NODE *));
 		return;
 	}
+#ifdef STABS
+	if (gflag && type == IP_NODE)
+		stabs_loc();
+#endif
 	if (type == IP_PROLOG || type == IP_EPILOG)
 		sz = sizeof(struct interpass_prolog);
 	else
@@ -3133,8 +3141,11 @@ send_passt(int type, ...)
 		ipp->ip_tmpnum = va_arg(ap, int);
 		ipp->ip_lblnum = crslab;
 		ipp->ip_labels = va_arg(ap, int *);;
+		ipp->ip_aggrs = NULL;
 		if (type == IP_PROLOG)
 			ipp->ip_lblnum--;
+		else
+			ipp->ip_aggrs = aggrblks, aggrblks = NULL;
 		break;
 	case IP_DEFLAB:
 		ip->ip_lbl = va_arg(ap, int);
@@ -3276,20 +3287,35 @@ cdope(int op)
 NODE *
 ccopy(NODE *p) 
 {  
-	NODE *q;
+	NODE *lstk[WSTKSZ], **stk = lstk;
+	NODE *q, *rv;
+	int sp = 0, sz = WSTKSZ;
 
-	q = talloc();
+	rv = q = talloc();
 	*q = *p;
-
-	switch (coptype(q->n_op)) {
-	case BITYPE:
-		q->n_right = ccopy(p->n_right);
-		/* FALLTHROUGH */
-	case UTYPE: 
-		q->n_left = ccopy(p->n_left);
+	for (;;) {
+		switch (coptype(q->n_op)) {
+		case BITYPE:
+			p = talloc();
+			*p = *q->n_right;
+			q->n_right = p;
+			if (sp == sz)
+				stk = wstkgrow(stk, lstk, &sz, sizeof(NODE *));
+			stk[sp++] = p;
+			/* FALLTHROUGH */
+		case UTYPE: 
+			p = talloc();
+			*p = *q->n_left;
+			q = q->n_left = p;
+			continue;
+		}
+		if (sp == 0)
+			break;
+		q = stk[--sp];
 	}
-
-	return(q);
+	if (stk != lstk)
+		free(stk);
+	return(rv);
 }
 
 NODE *
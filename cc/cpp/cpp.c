@@ -39,6 +39,9 @@
 #ifdef HAVE_UNISTD_H
 #include <unistd.h>
 #endif
+#ifdef HAVE_MMAP
+#include <sys/mman.h>
+#endif
 #include <stdio.h>
 #include <stdarg.h>
 #include <stdlib.h>
@@ -52,9 +55,26 @@
 #define S_ISDIR(m)	(((m) & S_IFMT) == S_IFDIR)
 #endif
 
+/*
+ * The string heap.  Macro bodies, names and expansion scratch are
+ * built in place at stringbuf and scratch is reclaimed by resetting
+ * stringbuf, so the heap must be contiguous and never move.  Address
+ * space for it is reserved at startup and made usable SBCHUNK bytes
+ * at a time as it fills up.  If mmap is missing or no reservation of
+ * at least SBSIZE can be had it is one SBSIZE malloc.
+ */
 #define	SBSIZE	1000000
+#define	SBCHUNK	65536
+#define	SBMAX	(sizeof(void *) > 4 ? 1024L*1024*1024 : 64L*1024*1024)
 
-static usch	sbf[SBSIZE];
+static usch	*sbf, *sbend, *sbtop, *sbmax;
+static int	sbchunks;
+#ifdef HAVE_MMAP
+static int	sbmapped;
+#endif
+static void	sbinit(void);
+static void	sbgrow(size_t n);
+static void	nlflush(void);
 /* C command */
 
 int tflag;	/* traditional cpp syntax */
@@ -95,7 +115,7 @@ int	trulvl;
 int	flslvl;
 int	elflvl;
 int	elslvl;
-usch *stringbuf = sbf;
+usch *stringbuf;
 
 /*
  * Macro replacement list syntax:
@@ -156,6 +176,7 @@ main(int argc, char **argv)
 	(void)gettimeofday(&t1, NULL);
 #endif
 
+	sbinit();
 	while ((ch = getopt(argc, argv, "ACD:d:EI:i:MPS:tU:Vvx:")) != -1) {
 		switch (ch) {
 		case 'A': /* assembler input */
@@ -333,6 +354,7 @@ main(int argc, char **argv)
 	if (pushfile(fn1, fn2, 0, NULL))
 		error("cannot open %s", argv[0]);
 
+	nlflush();
 	fclose(of);
 #ifdef TIMING
 	(void)gettimeofday(&t2, NULL);
@@ -344,6 +366,12 @@ main(int argc, char **argv)
 	}
 	fprintf(stderr, "cpp total time: %ld s %ld us\n",
 	     (long)t2.tv_sec, (long)t2.tv_usec);
+#endif
+#ifdef PCC_DEBUG
+	if (dflag)
+		fprintf(stderr, "string heap: %ld bytes in use, "
+		    "%ld bytes in %d chunks\n", (long)(stringbuf - sbf),
+		    (long)(sbtop - sbf), sbchunks);
 #endif
 	if (Eflag && warnings > 0)
 		return 2;
@@ -412,11 +440,11 @@ line(void)
 	p[c - 1] = '\0';
 	if (llen < c) {
 		/* XXX may lose heap space */
+		if (stringbuf + c >= sbend)
+			sbgrow(c);
 		lbuf = stringbuf;
 		stringbuf += c;
 		llen = c;
-		if (stringbuf >= &sbf[SBSIZE])
-			error("#line filename exceeds buffer size");
 	}
 	memcpy(lbuf, p, c);
 	ifiles->fname = lbuf;
@@ -1152,12 +1180,70 @@ donex(void)
 void
 savch(int c)
 {
-	if (stringbuf >= &sbf[SBSIZE])
-		error("out of macro space!");
+	if (stringbuf >= sbend)
+		sbgrow(1);
 
 	*stringbuf++ = (usch)c;
 }
 
+/*
+ * Set up the string heap.
+ */
+static void
+sbinit(void)
+{
+#ifdef HAVE_MMAP
+	size_t sz;
+	void *p;
+
+	/* a smaller reservation may fit where the address space is limited */
+	for (sz = SBMAX; sz >= SBSIZE; sz /= 2) {
+		p = mmap(NULL, sz, PROT_NONE, MAP_PRIVATE|MAP_ANON, -1, 0);
+		if (p == MAP_FAILED)
+			continue;
+		stringbuf = sbf = sbend = sbtop = p;
+		sbmax = sbf + sz;
+		sbmapped = 1;
+		sbgrow(1);
+		return;
+	}
+#endif
+	if ((sbf = malloc(SBSIZE)) == NULL)
+		error("out of memory");
+	stringbuf = sbf;
+	sbtop = sbmax = sbf + SBSIZE;
+	sbend = sbtop - 1;
+	sbchunks = 1;
+}
+
+/*
+ * Make room for n more characters at stringbuf.  sbend is kept one
+ * below the usable end so a terminating 0 may always be stored.
+ */
+static void
+sbgrow(size_t n)
+{
+#ifdef HAVE_MMAP
+	size_t sz;
+
+	if (sbmapped) {
+		if (stringbuf + n < sbend)
+			return;
+		sz = ((stringbuf + n + 1 - sbtop) + SBCHUNK - 1) /
+		    SBCHUNK * SBCHUNK;
+		if (sz > (size_t)(sbmax - sbtop) ||
+		    mprotect(sbtop, sz, PROT_READ|PROT_WRITE) == -1)
+			error("out of macro space!");
+		sbchunks += sz / SBCHUNK;
+		sbtop += sz;
+		sbend = sbtop - 1;
+		return;
+	}
+#endif
+	if (stringbuf + n >= sbend)
+		error("out of macro space!");
+}
+
 /*
  * convert _Pragma() to #pragma for output.
  * Syntax is already correct.
@@ -1540,9 +1626,9 @@ isdir(void)
 	usch ch;
 
 	while ((ch = cinput()) == ' ' || ch == '\t')
-		*stringbuf++ = ch;
-	*stringbuf++ = ch;
-	*stringbuf++ = 0;
+		savch(ch);
+	savch(ch);
+	savch(0);
 	stringbuf = bp;
 	if (ch == '#')
 		return 1;
@@ -1978,8 +2064,8 @@ savstr(const usch *str)
 	usch *rv = stringbuf;
 
 	do {
-		if (stringbuf >= &sbf[SBSIZE])
-			error("out of macro space!");
+		if (stringbuf >= sbend)
+			sbgrow(1);
 	} while ((*stringbuf++ = *str++));
 	stringbuf--;
 	return rv;
@@ -2007,16 +2093,63 @@ unpstr(const usch *c)
 	}
 }
 
+/*
+ * Newlines ending input lines are held back by putnl() until something
+ * else is written.  A run longer than NLMAX, as from skipped #if parts
+ * or headers full of #defines, is then replaced by a line marker.
+ */
+int nlpend;		/* newlines held back */
+static int nlline;	/* input line after them */
+
+static void
+nlflush(void)
+{
+	if (nlpend > NLMAX && !Pflag && ifiles != NULL) {
+		printf("\n# %d \"%s\"%s\n", nlline, ifiles->fname,
+		    ifiles->idx == SYSINC ? " 3" : "");
+	} else {
+		if (nlpend > NLMAX)
+			nlpend = 1;
+		while (nlpend-- > 0)
+			fputc('\n', stdout);
+	}
+	nlpend = 0;
+}
+
+void
+putnl(void)
+{
+	if (Mflag == 0) {
+		nlpend++;
+		nlline = ifiles->lineno;
+	}
+}
+
 void
 putch(int ch)
 {
-	if (Mflag == 0)
+	if (Mflag == 0) {
+		if (nlpend)
+			nlflush();
 		fputc(ch, stdout);
+	}
+}
+
+void
+putbuf(const usch *s, int n)
+{
+	if (Mflag == 0 && n > 0) {
+		if (nlpend)
+			nlflush();
+		fwrite(s, 1, n, stdout);
+	}
 }
 
 void
 putstr(const usch *s)
 {
+	if (nlpend && *s)
+		nlflush();
 	for (; *s; s++) {
 		if (*s == PHOLD)
 			continue;
@@ -41,6 +41,9 @@ extern	int	Mflag, dMflag, MPflag, MMDflag;
 extern	usch	*Mfile, *MPfile;
 extern	int	defining;
 extern	FILE	*of;
+extern	int	nlpend;
+
+#define	NLMAX	8	/* newlines written before using a line marker */
 
 /* args for lookup() */
 #define FIND    0
@@ -176,7 +179,9 @@ int yyparse(void);
 void unpstr(const usch *);
 usch *savstr(const usch *str);
 void savch(int c);
+void putnl(void);
 void putch(int);
+void putbuf(const usch *, int);
 void putstr(const usch *s);
 usch *sheap(const char *fmt, ...);
 void warning(const char *fmt, ...);
@@ -47,6 +47,10 @@
 #include <unistd.h>
 #endif
 #include <fcntl.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#include <strings.h>
+#endif
 
 #include "compat.h"
 #include "cpp.h"
@@ -69,8 +73,10 @@ static int inpch(void);
 static int chktg(void);
 static int chkucn(void);
 static void unch(int c);
+static usch *skipspan(usch *p, usch *e, int k);
 
-#define	PUTCH(ch) if (!flslvl) putch(ch)
+#define	PUTCH(ch) if (!flslvl && !Mflag) putch(ch)
+#define	PUTBUF(s, n) if (!flslvl && !Mflag) putbuf(s, n)
 /* protection against recursion in #include */
 #define MAX_INCLEVEL	100
 static int inclevel;
@@ -221,6 +227,86 @@ unch(int c)
 	*ifiles->curptr = (usch)c;
 }
 
+/*
+ * Character runs that the scanners may pass over without looking at
+ * each character.  Trigraphs and escaped newlines always end a run,
+ * so inch() still sees them.
+ */
+#define	SK_ID	0	/* identifier characters */
+#define	SK_WS	1	/* blanks and tabs */
+#define	SK_CMNT	2	/* all but '*' '\n' '\\' '?' */
+#define	SK_LINE	3	/* all but '\n' '\\' '?' */
+#define	SK_STR	4	/* all but '"' '\n' '\\' '?' */
+
+static int
+skipchr(int c, int k)
+{
+	switch (k) {
+	case SK_ID:
+		return spechr[c] & C_ID;
+	case SK_WS:
+		return c == ' ' || c == '\t';
+	case SK_CMNT:
+		return c != '*' && c != '\n' && c != '\\' && c != '?';
+	case SK_LINE:
+		return c != '\n' && c != '\\' && c != '?';
+	default:
+		return c != '"' && c != '\n' && c != '\\' && c != '?';
+	}
+}
+
+/*
+ * Return the first character in [p, e) that ends a run of kind k.
+ * Looks at 16 characters at a time where SSE2 is available.
+ */
+static usch *
+skipspan(usch *p, usch *e, int k)
+{
+#ifdef __SSE2__
+	__m128i v, m, nl, bs, qm, c1;
+	int bits;
+
+	nl = _mm_set1_epi8('\n');
+	bs = _mm_set1_epi8('\\');
+	qm = _mm_set1_epi8('?');
+	c1 = _mm_set1_epi8(k == SK_CMNT ? '*' : k == SK_STR ? '"' : '\n');
+	for (; e - p >= 16; p += 16) {
+		v = _mm_loadu_si128((__m128i *)p);
+		switch (k) {
+		case SK_ID:
+			/* letters, digits, '_' and utf-8 */
+			m = _mm_or_si128(v, _mm_set1_epi8(0x20));
+			m = _mm_and_si128(_mm_cmpgt_epi8(m, _mm_set1_epi8('a'-1)),
+			    _mm_cmplt_epi8(m, _mm_set1_epi8('z'+1)));
+			m = _mm_or_si128(m,
+			    _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('0'-1)),
+			    _mm_cmplt_epi8(v, _mm_set1_epi8('9'+1))));
+			m = _mm_or_si128(m,
+			    _mm_cmpeq_epi8(v, _mm_set1_epi8('_')));
+			bits = ~(_mm_movemask_epi8(m) | _mm_movemask_epi8(v));
+			break;
+		case SK_WS:
+			m = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')),
+			    _mm_cmpeq_epi8(v, _mm_set1_epi8('\t')));
+			bits = ~_mm_movemask_epi8(m);
+			break;
+		default:
+			m = _mm_or_si128(_mm_cmpeq_epi8(v, nl),
+			    _mm_cmpeq_epi8(v, bs));
+			m = _mm_or_si128(m, _mm_cmpeq_epi8(v, qm));
+			m = _mm_or_si128(m, _mm_cmpeq_epi8(v, c1));
+			bits = _mm_movemask_epi8(m);
+			break;
+		}
+		if ((bits &= 0xffff) != 0)
+			return p + ffs(bits) - 1;
+	}
+#endif
+	while (p < e && skipchr(*p, k))
+		p++;
+	return p;
+}
+
 /*
  * Check for (and convert) trigraphs.
  */
@@ -354,11 +440,15 @@ fastcmnt(int ps)
 	int ch;
 
 	if ((ch = inch()) == '/') { /* C++ comment */
-		while ((ch = inch()) != '\n')
-			;
+		do {
+			ifiles->curptr = skipspan(ifiles->curptr,
+			    ifiles->maxread, SK_LINE);
+		} while ((ch = inch()) != '\n');
 		unch(ch);
 	} else if (ch == '*') {
 		for (;;) {
+			ifiles->curptr = skipspan(ifiles->curptr,
+			    ifiles->maxread, SK_CMNT);
 			ch = inch();
 			if (ch == '*') {
 				if ((ch = inch()) == '/') {
@@ -367,7 +457,7 @@ fastcmnt(int ps)
 					unch(ch);
 			} else if (ch == '\n') {
 				ifiles->lineno++;
-				putch('\n');
+				putnl();
 			}
 		}
 	} else {
@@ -394,7 +484,7 @@ Ccmnt(int ps)
 		unch(ch);
 		return 1;
 	} else if (ch == '*') {
-		printf("/*");
+		putch('/'); putch('*');
 		for (;;) {
 			ch = inch();
 			PUTCH(ch);
@@ -419,16 +509,24 @@ Ccmnt(int ps)
 static int
 eatcmnt(void)
 {
+	usch *p;
 	int ch;
 
 	if (Cflag) {
 		PUTCH('/'); PUTCH('*');
 	}
 	for (;;) {
+		p = ifiles->curptr;
+		ifiles->curptr = skipspan(p, ifiles->maxread, SK_CMNT);
+		if (Cflag)
+			PUTBUF(p, ifiles->curptr - p);
 		ch = inch();
 		if (ch == '\n') {
 			ifiles->lineno++;
-			putch('\n');
+			if (Cflag)
+				putch('\n');
+			else
+				putnl();
 			continue;
 		}
 		if (ch == -1)
@@ -460,7 +558,11 @@ fastspc(int pre)
 {
 	int ch;
 
-	while ((ch = inch()) == ' ' || ch == '\t' || ch == '/') {
+	for (;;) {
+		ifiles->curptr = skipspan(ifiles->curptr,
+		    ifiles->maxread, SK_WS);
+		if ((ch = inch()) != ' ' && ch != '\t' && ch != '/')
+			break;
 		if (ch == '/')
 			if (pre && Cflag ? Ccmnt(0) : fastcmnt(0) == 0)
 				break;
@@ -475,10 +577,16 @@ fastspc(int pre)
 static void
 fastid(int ch)
 {
+	usch *p, *q;
 	int i = 0;
 
 	do {
 		yytext[i++] = ch;
+		p = ifiles->curptr;
+		q = skipspan(p, ifiles->maxread, SK_ID);
+		memcpy(yytext+i, p, q - p);
+		i += q - p;
+		ifiles->curptr = q;
 	} while (spechr[ch = inch()] & C_ID);
 	yytext[i] = 0;
 	unch(ch);
@@ -500,7 +608,7 @@ fastscan(void)
 {
 	struct symtab *nl;
 	int ch, i;
-	usch *cp;
+	usch *cp, *p;
 
 	goto run;
 	for (;;) {
@@ -529,6 +637,11 @@ cppcmt:					putch(Cflag ? ch : ' ');
 				}
 				do {
 					if (Cflag && !flslvl) putch(ch);
+					p = ifiles->curptr;
+					ifiles->curptr = skipspan(p,
+					    ifiles->maxread, SK_LINE);
+					if (Cflag)
+						PUTBUF(p, ifiles->curptr - p);
 					ch = inch();
 					if (ch == -1)
 						goto eof;
@@ -548,8 +661,12 @@ cppcmt:					putch(Cflag ? ch : ' ');
 			ifiles->lineno += i;
 			ifiles->escln = 0;
 			while (i-- > 0)
-				putch('\n');
+				putnl();
 run:			for(;;) {
+				p = ifiles->curptr;
+				ifiles->curptr = skipspan(p,
+				    ifiles->maxread, SK_WS);
+				PUTBUF(p, ifiles->curptr - p);
 				ch = inch();
 				if (ch == '/') {
 					ch = inch();
@@ -583,7 +700,13 @@ run:			for(;;) {
 
 		case '\"': /* strings */
 str:			PUTCH(ch);
-			while ((ch = inch()) != '\"') {
+			for (;;) {
+				p = ifiles->curptr;
+				ifiles->curptr = skipspan(p,
+				    ifiles->maxread, SK_STR);
+				PUTBUF(p, ifiles->curptr - p);
+				if ((ch = inch()) == '\"')
+					break;
 				if (ch == '\\') {
 					if (chkucn())
 						continue;
@@ -669,7 +792,8 @@ con:			PUTCH(ch);
 #endif
 		ident:
 			fastid(ch);
-			if (flslvl == 0) {
+			/* with -M only directives matter; do not expand text */
+			if (flslvl == 0 && Mflag == 0) {
 				cp = stringbuf;
 				if ((nl = lookup(yytext, FIND)) && kfind(nl))
 					putstr(stringbuf);
@@ -1152,6 +1276,8 @@ prtline(void)
 				printf("%s:\n", ifiles->fname);
 		}
 	} else if (!Pflag) {
+		if (nlpend > NLMAX)
+			nlpend = 0;	/* the marker replaces them */
 		sheap("\n# %d \"%s\"", ifiles->lineno, ifiles->fname);
 		if (ifiles->idx == SYSINC)
 			sheap(" 3");
@@ -1555,7 +1681,7 @@ flscan(void)
 			return;
 		case '\n':
 			ifiles->lineno++;
-			putch('\n');
+			putnl();
 			if ((ch = fastspc(0)) == '#')
 				return;
 			unch(ch);
@@ -1595,8 +1721,8 @@ redo:	while ((ch = inch()) == ' ' || ch == '\t')
 						goto redo;
 					unch(ch);
 				} else if (ch == '\n') {
-					putch('\n');
 					ifiles->lineno++;
+					putnl();
 				}
 			}
 		}
@@ -26,13 +26,15 @@
 
 # include "pass1.h"
 
+#include <stdlib.h>
+#include <string.h>
 
 struct symtab spole0 = { 0, 0, 0, 0, 0, 0, 0, "base", "base", };
 struct symtab *spole = &spole0;
 struct symtab *nscur = &spole0;
 int elnk, nsptr;
 
-static struct symtab *sfind(char *n, struct symtab *sp);
+static void sidxclr(void);
 /*
  * Declare a namespace.
  */
@@ -53,7 +55,7 @@ dclns(NODE *attr, char *n)
 	while (sp != NULL) {
 		if (sp->sname == n && sp->sclass == NSPACE)
 			break;
-		sp = sfind(n, sp->snext);
+		sp = snxt(n, sp);
 	}
 	if (sp == NULL) {
 		/* New namespace */
@@ -228,9 +230,54 @@ typch(int typ)
 	return chmap[c];
 }
 
+/* hash on a pointer, sz a power of two */
+#define	SHASH(n, sz) ((unsigned)(((size_t)(n) >> 3) * 2654435761U) >> 8 & ((sz)-1))
+
 #define	MAXNM	255	/* max length of mangled name */
 static char nmblk[MAXNM];
-static int nmptr, subptr;
+static int nmptr;
+
+/*
+  <substitution> ::= S_			# first candidate
+		 ::= S <seq-id> _	# candidate seq-id + 1, base 36
+		 ::= St			# ::std::
+  Candidates are each prefix of a nested name and each pointer,
+  qualified or class type, numbered in the order they are first mangled.
+*/
+#define	MAXSUB	64
+static struct subst {
+	struct symtab *sp;	/* scope, class or pointed-to class */
+	TWORD t;		/* pointer or qualified type, 0 for a name */
+	TWORD q;		/* qualifiers of t */
+} subst[MAXSUB];
+static int nsubst;
+
+/* q without the qualifiers of t itself */
+#define	UNQUAL(t, q)	((q) & ~((t) > BTMASK ? CON|VOL : (CON|VOL) >> TSHIFT))
+
+/*
+ * Argument lists are compared by type only and do not keep the
+ * qualifiers, which are needed for mangling.  arglist() saves them
+ * here for the lists where there are any.
+ */
+#define	ALQSZ	256
+static struct alqual {
+	struct alqual *next;
+	union arglist *al;
+	TWORD *q;		/* one for each argument */
+} *alqtab[ALQSZ];
+
+/* cached prefix of names in a scope, as mangled first in a name */
+#define	PFXSZ	64
+static struct pfxmemo {
+	struct pfxmemo *next;
+	struct symtab *sp;
+	char *str;
+	int len;
+} *pfxtab[PFXSZ];
+
+#define	ISSTD(sp) ((sp)->sclass == NSPACE && (sp)->sdown == spole && \
+	strcmp((sp)->sname, "std") == 0)
 
 /* push character */
 static void
@@ -257,42 +304,212 @@ pshsln(char *c)
 		nmch(*c);
 }
 
+void
+alqsave(union arglist *al, TWORD *q)
+{
+	struct alqual *aq = permalloc(sizeof(struct alqual));
+
+	aq->al = al;
+	aq->q = q;
+	aq->next = alqtab[SHASH(al, ALQSZ)];
+	alqtab[SHASH(al, ALQSZ)] = aq;
+}
+
+static TWORD *
+alqfind(union arglist *al)
+{
+	struct alqual *aq;
+
+	for (aq = alqtab[SHASH(al, ALQSZ)]; aq; aq = aq->next)
+		if (aq->al == al)
+			return aq->q;
+	return NULL;
+}
+
+static int
+subfind(struct symtab *sp, TWORD t, TWORD q)
+{
+	int i;
+
+	for (i = 0; i < nsubst; i++)
+		if (subst[i].sp == sp && subst[i].t == t && subst[i].q == q)
+			return i;
+	return -1;
+}
+
+static void
+subadd(struct symtab *sp, TWORD t, TWORD q)
+{
+	if (nsubst == MAXSUB)
+		return; /* just not substituted */
+	subst[nsubst].sp = sp;
+	subst[nsubst].t = t;
+	subst[nsubst++].q = q;
+}
+
+/* Push a substitution */
+static void
+pshsub(int i)
+{
+	char buf[8];
+	int n = 0;
+
+	nmch('S');
+	if (i--) {
+		do {
+			buf[n++] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ"[i % 36];
+		} while ((i /= 36) > 0);
+		while (n > 0)
+			nmch(buf[--n]);
+	}
+	nmch('_');
+}
+
+/* Add the scopes down to sp as candidates, outermost first */
+static void
+subpath(struct symtab *sp)
+{
+	if (sp->sdown != NULL && sp->sdown != spole)
+		subpath(sp->sdown);
+	if (!ISSTD(sp))
+		subadd(sp, 0, 0);
+}
+
 /* Recurse to push namespace names */
 static void
 recnpsh(struct symtab *sp)
 {
+	struct pfxmemo *pm;
+	int i, first, ptr;
+
 	if (sp == spole)
 		return;
 	if (sp == sp->sdown)
 		cerror("sp == sp->sdown");
+	if ((i = subfind(sp, 0, 0)) >= 0) {
+		pshsub(i);
+		return;
+	}
+	/* a prefix first in the name is always mangled the same way */
+	if ((first = (nsubst == 0))) {
+		for (pm = pfxtab[SHASH(sp, PFXSZ)]; pm; pm = pm->next)
+			if (pm->sp == sp) {
+				if (nmptr + pm->len >= MAXNM)
+					cerror("Too long mangled name");
+				memcpy(&nmblk[nmptr], pm->str, pm->len);
+				nmptr += pm->len;
+				subpath(sp);
+				return;
+			}
+	}
+	ptr = nmptr;
 	if (sp->sdown)
 		recnpsh(sp->sdown);
-	pshsln(sp->sname);
+	if (ISSTD(sp)) {
+		nmch('S'); nmch('t');
+	} else {
+		pshsln(sp->sname);
+		subadd(sp, 0, 0);
+	}
+	if (first && sp->slevel == 0) {
+		pm = permalloc(sizeof(struct pfxmemo));
+		pm->sp = sp;
+		pm->len = nmptr - ptr;
+		pm->str = permalloc(pm->len);
+		memcpy(pm->str, &nmblk[ptr], pm->len);
+		pm->next = pfxtab[SHASH(sp, PFXSZ)];
+		pfxtab[SHASH(sp, PFXSZ)] = pm;
+	}
+}
+
+/*
+ * Push the name of sp, nested if it is inside a namespace or class.
+ */
+static void
+pshname(struct symtab *sp)
+{
+	struct symtab *ns = sp->sdown;
+
+	if (ns == NULL || ns == spole) {
+		pshsln(sp->sname);
+	} else if (ISSTD(ns)) {
+		nmch('S'); nmch('t');
+		pshsln(sp->sname);
+	} else {
+		nmch('N');
+		recnpsh(ns);
+		pshsln(sp->sname);
+		nmch('E');
+	}
+}
+
+/* Push a (pointer to) builtin or class type with qualifiers q */
+static void
+pshtype(TWORD t, TWORD q, struct symtab *cl)
+{
+	int i, cv = cqual(t, q);
+
+	if (t > BTMASK || cl != NULL || cv) {
+		if ((i = subfind(cl, t > BTMASK || cv ? t : 0, q)) >= 0) {
+			pshsub(i);
+			return;
+		}
+	}
+	if (cv) {
+		if (cv & VOL)
+			nmch('V');
+		if (cv & CON)
+			nmch('K');
+		pshtype(t, UNQUAL(t, q), cl);
+		subadd(cl, t, q);
+	} else if (t > BTMASK) {
+		if (ISPTR(t))
+			nmch('P');
+		else
+			uerror("pshargs2: %lx\n", t);
+		pshtype(DECREF(t), DECQAL(q), cl);
+		subadd(cl, t, q);
+	} else if (cl != NULL) {
+		pshname(cl);
+		subadd(cl, 0, 0);
+	} else {
+		if (t > LDOUBLE && t != VOID)
+			uerror("pshargs: %lx\n", t);
+		nmch(typch(t));
+	}
 }
 
 static void
 pshargs(union arglist *al)
 {
-	TWORD t;
-	
+	struct symtab *cl;
+	struct attr *ap;
+	TWORD t, *qv;
+	int n;
 
-	for (; al->type != TNULL; al++) {
+	qv = alqfind(al);
+	for (n = 0; al->type != TNULL; al++, n++) {
 		t = al->type;
 		if (t == TELLIPSIS) {
 			nmch('z');
 			continue;
 		}
-		while (t > BTMASK) {
-			if (ISPTR(t))
-				nmch('P');
-			else
-				uerror("pshargs2: %lx\n", t);
-			t = DECREF(t);
+		cl = NULL;
+		if (ISSOU(BTYPE(t))) {
+			/* only the name is needed, it may be incomplete */
+			al++;
+			if ((ap = strattr(al->sap)) == NULL ||
+			    (cl = ap->amtag) == NULL) {
+				uerror("pshargs: unknown class");
+				continue;
+			}
 		}
-		if (t > LDOUBLE)
-			uerror("pshargs: %lx\n", t);
-		/* XXX - cannot emit const/volatile */
-		nmch(typch(t));
+		/* the qualifiers of the argument itself are ignored */
+		pshtype(t, qv ? UNQUAL(t, qv[n]) : 0, cl);
+		while (!ISFTN(t) && !ISARY(t) && t > BTMASK)
+			t = DECREF(t);
+		if (t > BTMASK)
+			al++;
 	}
 }
 
@@ -332,15 +549,9 @@ decoratename(struct symtab *sp, int type)
 	}
 	/* Compute the mangled name for other symbols */
 	nmptr = 0;
-	subptr = 0;
+	nsubst = 0;
 	nmch('_'); nmch('Z');
-	if (sp->sdown != NULL) {
-		nmch('N');
-		recnpsh(sp->sdown);
-	}
-	pshsln(sp->sname);
-	if (sp->sdown != NULL)
-		nmch('E');
+	pshname(sp);
 	if (ISFTN(sp->stype) && sp->sdf->dfun)
 		pshargs(sp->sdf->dfun);
 	nmch(0);
@@ -348,20 +559,330 @@ decoratename(struct symtab *sp, int type)
 }
 
 /*
- * find a symtab entry in the given link.
+ * Scope chains are searched from a given start symbol along snext.
+ * Chains longer than SIDXMIN get a hash index on the (unique) name
+ * pointer, built on first use.  Indexes are kept up to date when
+ * symbols are put in front of a chain (inssym) or at its end
+ * (scopeadd); anything else throws them all away.
+ */
+#define	SIDXMIN	16	/* shorter chains are just walked */
+#define	SIDXTAB	256	/* start symbol hash size */
+
+struct sent {
+	struct sent *next;
+	struct symtab *sp;
+};
+
+struct sidx {
+	struct sidx *next;	/* same start hash */
+	struct sidx *alnext;	/* all indexes */
+	struct symtab *start;	/* chain searched from here */
+	struct symtab *last;	/* end of chain */
+	struct sent **bkt;	/* name hash, entries in chain order */
+	struct sent *ent;
+	int nbkt, nent;
+	int gen;		/* valid if sidxgen */
+};
+
+static struct sidx *sidxtab[SIDXTAB], *sidxall;
+static struct sidx *lastix;	/* for snxt() */
+static struct sent *lastent;
+static struct symtab *laststart, *lastsp;
+static int sidxgen, symgen;
+
+int sfindcnt, sprobecnt, sidxcnt, slchits;	/* statistics */
+
+static void *
+sxalloc(void *p, size_t sz)
+{
+	if ((p = realloc(p, sz)) == NULL)
+		cerror("out of memory");
+	return p;
+}
+
+/*
+ * (Re)build the index for the chain starting at ix->start.
+ */
+static void
+sidxmk(struct sidx *ix)
+{
+	struct symtab *sp;
+	struct sent *e, **b;
+	int n;
+
+	for (n = 0, sp = ix->start; sp; sp = sp->snext)
+		n++;
+	if (n >= ix->nbkt) {
+		for (ix->nbkt = 64; ix->nbkt <= n; ix->nbkt <<= 1)
+			;
+		ix->bkt = sxalloc(ix->bkt, ix->nbkt * sizeof(struct sent *));
+		ix->ent = sxalloc(ix->ent, ix->nbkt * sizeof(struct sent));
+	}
+	memset(ix->bkt, 0, ix->nbkt * sizeof(struct sent *));
+	for (e = ix->ent, sp = ix->start; sp; sp = sp->snext)
+		(e++)->sp = ix->last = sp;
+	ix->nent = n;
+	/* in reverse, so buckets get chain order */
+	while (e > ix->ent) {
+		e--;
+		b = &ix->bkt[SHASH(e->sp->sname, ix->nbkt)];
+		e->next = *b;
+		*b = e;
+	}
+	ix->gen = sidxgen;
+	lastent = NULL;
+	sidxcnt++;
+}
+
+static struct sidx *
+sidxfind(struct symtab *sp)
+{
+	struct sidx *ix;
+
+	for (ix = sidxtab[SHASH(sp, SIDXTAB)]; ix; ix = ix->next)
+		if (ix->start == sp)
+			break;
+	if (ix && ix->gen != sidxgen)
+		sidxmk(ix);
+	return ix;
+}
+
+static void
+sidxlink(struct sidx *ix)
+{
+	struct sidx **h = &sidxtab[SHASH(ix->start, SIDXTAB)];
+
+	ix->next = *h;
+	*h = ix;
+}
+
+static void
+sidxunlink(struct sidx *ix)
+{
+	struct sidx **h = &sidxtab[SHASH(ix->start, SIDXTAB)];
+
+	while (*h != ix)
+		h = &(*h)->next;
+	*h = ix->next;
+}
+
+/*
+ * Add sp to index ix, first in chain or after ix->last.
+ */
+static void
+sidxins(struct sidx *ix, struct symtab *sp, int first)
+{
+	struct sent *e, **b;
+
+	if (ix->nent == ix->nbkt) {
+		sidxmk(ix);	/* grows it, sp is in the chain already */
+		return;
+	}
+	e = &ix->ent[ix->nent++];
+	e->sp = sp;
+	b = &ix->bkt[SHASH(sp->sname, ix->nbkt)];
+	if (!first)
+		while (*b)
+			b = &(*b)->next;
+	e->next = *b;
+	*b = e;
+	lastent = NULL;
+}
+
+/*
+ * Throw away all indexes, the chains have changed.
+ */
+static void
+sidxclr(void)
+{
+	sidxgen++;
+	symgen++;
+	lastent = NULL;
+}
+
+/*
+ * Put sp first in the current scope.
+ */
+void
+inssym(struct symtab *sp)
+{
+	struct sidx *ix = NULL;
+
+	if (nscur->sup && (ix = sidxfind(nscur->sup)) != NULL)
+		sidxunlink(ix);
+	sp->snext = nscur->sup;
+	nscur->sup = sp;
+	sp->sdown = nscur;
+	if (ix) {
+		ix->start = sp;
+		sidxlink(ix);
+		sidxins(ix, sp, 1);
+	}
+	symgen++;
+}
+
+/*
+ * sp has been linked in after last at the end of a scope.
+ */
+void
+scopeadd(struct symtab *last, struct symtab *sp)
+{
+	struct sidx *ix;
+
+	for (ix = sidxall; ix; ix = ix->alnext)
+		if (ix->gen == sidxgen && ix->last == last) {
+			sidxins(ix, sp, 0);
+			ix->last = sp;
+		}
+	symgen++;
+}
+
+/*
+ * Get the index for the chain starting at sp.
+ */
+static struct sidx *
+sidxget(struct symtab *sp)
+{
+	struct sidx *ix;
+
+	if ((ix = sidxfind(sp)) == NULL) {
+		ix = sxalloc(NULL, sizeof(struct sidx));
+		memset(ix, 0, sizeof(struct sidx));
+		ix->start = sp;
+		ix->alnext = sidxall;
+		sidxall = ix;
+		sidxlink(ix);
+		sidxmk(ix);
+	}
+	return ix;
+}
+
+/*
+ * Search the bucket list from e for n.
  */
 static struct symtab *
-sfind(char *n, struct symtab *sp)
+sbkt(char *n, struct sidx *ix, struct sent *e)
 {
-	while (sp) {
+	for (; e; e = e->next) {
+		sprobecnt++;
+		if (e->sp->sname == n)
+			break;
+	}
+	lastix = ix;
+	lastent = e;
+	lastsp = NULL;
+	return e ? e->sp : NULL;
+}
+
+/*
+ * Walk at most SIDXMIN entries from sp looking for n.
+ * Returns the entry, or NULL with *ep set where the walk stopped.
+ */
+static struct symtab *
+swalk(char *n, struct symtab *sp, struct symtab **ep)
+{
+	int i;
+
+	for (i = 0; sp && i < SIDXMIN; sp = sp->snext, i++) {
 	if (cppdebug)printf("sfind: checking %s against %s\n", n, sp->sname);
-		if (sp->sname == n)
+		sprobecnt++;
+		if (sp->sname == n) {
+			lastent = NULL;
+			lastsp = sp;
 			return sp;
-		sp = sp->snext;
+		}
 	}
+	*ep = sp;
 	return NULL;
 }
 
+/*
+ * find a symtab entry in the given link.
+ */
+struct symtab *
+sfind(char *n, struct symtab *sp)
+{
+	struct symtab *s, *e;
+	struct sidx *ix;
+
+	sfindcnt++;
+	if (sp == NULL)
+		return NULL;
+	if ((ix = sidxfind(sp)) == NULL) {
+		laststart = sp;
+		if ((s = swalk(n, sp, &e)) != NULL || e == NULL)
+			return s;
+		ix = sidxget(sp);	/* long chain, index it */
+	}
+	return sbkt(n, ix, ix->bkt[SHASH(n, ix->nbkt)]);
+}
+
+/*
+ * find the next symtab entry named n after sp, which sfind() or
+ * snxt() just returned.
+ */
+struct symtab *
+snxt(char *n, struct symtab *sp)
+{
+	struct symtab *s, *e;
+	struct sent *en;
+	struct sidx *ix;
+
+	sfindcnt++;
+	if (lastent && lastent->sp == sp && lastix->gen == sidxgen)
+		return sbkt(n, lastix, lastent->next);
+	if (sp != lastsp)
+		laststart = NULL;
+	if ((s = swalk(n, sp->snext, &e)) != NULL || e == NULL)
+		return s;
+	if (laststart != NULL) {
+		/* long chain after a short walk, find sp in its index */
+		ix = sidxget(laststart);
+		for (en = ix->bkt[SHASH(n, ix->nbkt)]; en; en = en->next)
+			if (en->sp == sp)
+				return sbkt(n, ix, en->next);
+	}
+	for (; e; e = e->snext) {
+		sprobecnt++;
+		if (e->sname == n)
+			break;
+	}
+	return e;
+}
+
+/*
+ * Search the current scope and all enclosing ones for n.
+ * The result is cached until the scopes change.
+ */
+static struct symtab *
+nsfind(char *n)
+{
+	static struct lcache {
+		char *n;
+		struct symtab *ns, *sp;
+		int gen;
+	} lcache[SIDXTAB];
+	struct lcache *lc;
+	struct symtab *sp, *ns;
+
+	lc = &lcache[SHASH(n, SIDXTAB) ^ SHASH(nscur, SIDXTAB)];
+	if (lc->n == n && lc->ns == nscur && lc->gen == symgen + 1) {
+		slchits++;
+		return lc->sp;
+	}
+	sp = NULL;
+	for (ns = nscur; ns != spole; ns = ns->sdown)
+		if ((sp = sfind(n, ns->sup)))
+			break;
+	if (sp == NULL)
+		sp = sfind(n, spole->sup);
+	lc->n = n;
+	lc->ns = nscur;
+	lc->sp = sp;
+	lc->gen = symgen + 1;
+	return sp;
+}
+
 /* class or namespace? */
 #define	CLORNS(sp) (sp->sclass == STNAME || sp->sclass == CLNAME || \
 	sp->sclass == UNAME || sp->sclass == NSPACE)
@@ -385,7 +906,7 @@ pfind(NODE *p, struct symtab *sp)
 			return NULL;
 	if (cppdebug)printf("pfind: NAME class %d name %s\n", sp->sclass, sp->sname);
 		while (!CLORNS(sp)) {
-			if ((sp = sfind(n, sp->snext)) == NULL)
+			if ((sp = snxt(n, sp)) == NULL)
 				return NULL;
 		}
 	if (cppdebug)printf("pfind: FOUND %s\n", sp->sname);
@@ -396,7 +917,7 @@ pfind(NODE *p, struct symtab *sp)
 			return NULL;
 	if (cppdebug)printf("pfind: NMLIST class %d name %s\n", sp->sclass, sp->sname);
 		while (!CLORNS(sp)) {
-			if ((sp = sfind(n, sp->snext)) == NULL)
+			if ((sp = snxt(n, sp)) == NULL)
 				return NULL;
 		}
 		sp = pfind(p->n_left, sp->sup);
@@ -456,11 +977,7 @@ cxxlookup(NODE *p, int flags)
 			sp = lookup(s, SNOCREAT); /* check if auto var */
 			if (sp == NULL) {
 				/* check if in classes */
-				for (ns = nscur; ns != spole; ns = ns->sdown)
-					if ((sp = sfind(s, ns->sup)))
-						break;
-				if (sp == NULL)
-					sp = sfind(s, spole->sup);
+				sp = nsfind(s);
 			}
 			if (sp == NULL)
 				sp = lookup(s, 0); /* fallback */
@@ -470,7 +987,7 @@ cxxlookup(NODE *p, int flags)
 			while (sp != NULL) {
 				if ((sp->sflags & SMASK) == ftyp)
 					break;
-				sp = sfind(s, sp->snext);
+				sp = snxt(s, sp);
 			}
 			if (sp == NULL) {
 				sp = getsymtab(s, ftyp);
@@ -496,6 +1013,7 @@ cxxlookup(NODE *p, int flags)
 			if ((flags & SNOCREAT) == 0) {
 				sp->snext = ns->snext;
 				ns->snext = sp;
+				sidxclr();
 			}
 		}
 	}
@@ -551,7 +1069,7 @@ cxxdclstr(char *n)
 
 	sp = sfind(n, nscur->sup);
 	while (sp && !CLORNS(sp))
-		sp = sfind(n, sp->snext);
+		sp = snxt(n, sp);
 	if (sp == 0)
 		sp = getsymtab(n, STAGNAME);
 //	else
@@ -680,7 +1198,7 @@ cxxftnfind(NODE *p, int flags)
 				} else
 					break;
 			}
-			sp = sfind(s, sp->snext);
+			sp = snxt(s, sp);
 		}
 		if (sp == NULL) {
 			sp = getsymtab(s, SNORMAL);
@@ -717,7 +1235,7 @@ cxxftnfind(NODE *p, int flags)
 					break;
 				}
 			}
-			sp = sfind(s, sp->snext);
+			sp = snxt(s, sp);
 		}
 		if (sp == NULL) {
 			uerror("%s undeclared", s);
@@ -748,7 +1266,7 @@ cxxrstruct(int soru, NODE *attr, NODE *t, char *n)
 	while (sp != NULL) {
 		if (sp->sclass == soru)
 			return mkty(sp->stype, 0, sp->sap);
-		sp = sfind(n, sp->snext);
+		sp = snxt(n, sp);
 	}
 undecl:
 	uerror("%s undeclared", n);
@@ -780,7 +1298,7 @@ cxxmatchftn(NODE *f, NODE *a)
 	while (sp != NULL) {
 		if (ISFTN(sp->stype) && cxxptreecmp(sp, a) == 0)
 			break;
-		sp = sfind(n, sp->snext);
+		sp = snxt(n, sp);
 	}
 	if (sp == NULL)
 		uerror("undefined class member");
@@ -824,7 +1342,7 @@ cxxstructref(NODE *p, int f, char *n)
 			}
 			break;
 		}
-		sp = sfind(n, sp->snext);
+		sp = snxt(n, sp);
 	}
 	return structref(p, f, n);
 }
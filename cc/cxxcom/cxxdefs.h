@@ -12,7 +12,7 @@ extern int cppdebug;
 extern struct symtab *spole, *nscur;
 
 /* insert a symbol into this something */
-#define	INSSYM(sp) (sp->snext = nscur->sup, nscur->sup = sp, sp->sdown = nscur)
+#define	INSSYM(sp) inssym(sp)
 #define	POPSYM()   (nscur = nscur->sdown)
 
 /* C++-specific node types */
@@ -29,6 +29,7 @@ extern struct symtab *spole, *nscur;
 #define	NSPACE	(MAXSTCL+2)	/* symtab entry is namespace */
  
 char *decoratename(struct symtab *sp, int type);
+void alqsave(union arglist *al, TWORD *q);
 NODE *cxx_new(NODE *p);
 NODE *cxx_delete(NODE *p, int del);
 void dclns(NODE *attr, char *n);
@@ -39,6 +40,10 @@ struct symtab *cxxstrvar(struct symtab *so);
 struct symtab *cxxdclstr(char *n);
 struct symtab *cxxftnfind(NODE *p, int flags);
 struct symtab *cxxdeclvar(NODE *p);
+struct symtab *sfind(char *n, struct symtab *sp);
+struct symtab *snxt(char *n, struct symtab *sp);
+void inssym(struct symtab *sp);
+void scopeadd(struct symtab *last, struct symtab *sp);
 void symtree(void);
 NODE *cxxrstruct(int soru, NODE *attr, NODE *t, char *tag);
 NODE *cxxmatchftn(NODE *, NODE *);
@@ -45,6 +45,8 @@ int r2debug, s2debug, t2debug, u2debug, x2debug;
 int gflag, kflag, pflag, sflag;
 int sspflag;
 int xssa, xtailcall, xtemps, xdeljumps, xdce, xinline, xccp, xgnu89, xgnu99;
+int xvector, xjobs;
+int xlinscan = -1;	/* linear-scan regalloc, default if not -xtemps */
 int xuchar;
 int freestanding;
 char *prgname;
@@ -85,6 +87,14 @@ xopt(char *str)
 		xdce++;
 	else if (strcmp(str, "inline") == 0)
 		xinline++;
+	else if (strcmp(str, "vector") == 0)
+		xvector++;
+	else if (strncmp(str, "jobs=", 5) == 0)
+		xjobs = atoi(str + 5);
+	else if (strcmp(str, "regalloc=linear") == 0)
+		xlinscan = 1;
+	else if (strcmp(str, "regalloc=color") == 0)
+		xlinscan = 0;
 	else if (strcmp(str, "ccp") == 0)
 		xccp++;
 	else if (strcmp(str, "gnu89") == 0)
@@ -252,6 +262,9 @@ main(int argc, char *argv[])
 	argc -= optind;
 	argv += optind;
 
+	if (xlinscan < 0)
+		xlinscan = !xtemps;
+
 	if (argc > 0 && strcmp(argv[0], "-") != 0) {
 		if (freopen(argv[0], "r", stdin) == NULL) {
 			fprintf(stderr, "open input file '%s':",
@@ -270,9 +283,29 @@ main(int argc, char *argv[])
 	}
 
 	mkdope();
+#ifdef SA_ONSTACK
+	{
+		/* run segvcatch on its own stack, to catch stack overflow */
+		static char sigstk[65536];
+		struct sigaction sa;
+		stack_t ss;
+
+		ss.ss_sp = sigstk;
+		ss.ss_size = sizeof(sigstk);
+		ss.ss_flags = 0;
+		memset(&sa, 0, sizeof(sa));
+		sa.sa_handler = segvcatch;
+		sa.sa_flags = sigaltstack(&ss, NULL) == 0 ? SA_ONSTACK : 0;
+		sigaction(SIGSEGV, &sa, NULL);
+#ifdef SIGBUS
+		sigaction(SIGBUS, &sa, NULL);
+#endif
+	}
+#else
 	signal(SIGSEGV, segvcatch);
 #ifdef SIGBUS
 	signal(SIGBUS, segvcatch);
+#endif
 #endif
 	fregs = FREGS;	/* number of free registers */
 	lineno = 1;
@@ -317,6 +350,7 @@ main(int argc, char *argv[])
 #endif
 
 	ejobcode( nerrors ? 1 : 0 );
+	pass2_done();
 
 #ifdef TIMING
 	(void)gettimeofday(&t2, NULL);
@@ -339,19 +373,41 @@ main(int argc, char *argv[])
 void
 prtstats(void)
 {
-	extern int nametabs, namestrlen, tmpallocsize, permallocsize;
-	extern int lostmem, arglistcnt, dimfuncnt, inlnodecnt, inlstatcnt;
-	extern int symtabcnt, suedefcnt;
+	extern int nametabs, namestrlen;
+	extern int arglistcnt, dimfuncnt, inlnodecnt, inlstatcnt;
+	extern int symtabcnt, suedefcnt, tmpreused;
+	extern int usednodes, maxnodes, narenas, narenasfreed;
+	extern size_t permallocsize, tmpallocsize, tmphiwat, lostmem;
+	extern int rafuncs, rarounds, ramaxrounds, rafull, raincr;
+	extern int sfindcnt, sprobecnt, sidxcnt, slchits;
+	extern long rafulltime, raincrtime;
 
 	fprintf(stderr, "Name table entries:		%d pcs\n", nametabs);
 	fprintf(stderr, "Name string size:		%d B\n", namestrlen);
-	fprintf(stderr, "Permanent allocated memory:	%d B\n", permallocsize);
-	fprintf(stderr, "Temporary allocated memory:	%d B\n", tmpallocsize);
-	fprintf(stderr, "Lost memory:			%d B\n", lostmem);
+	fprintf(stderr, "Permanent allocated memory:	%zu B\n", permallocsize);
+	fprintf(stderr, "Temporary allocated memory:	%zu B\n", tmpallocsize);
+	fprintf(stderr, "Temporary memory high-water:	%zu B\n", tmphiwat);
+	fprintf(stderr, "Temporary blocks reused:	%d pcs\n", tmpreused);
+	fprintf(stderr, "Lost memory:			%zu B\n", lostmem);
 	fprintf(stderr, "Argument list unions:		%d pcs\n", arglistcnt);
 	fprintf(stderr, "Dimension/function unions:	%d pcs\n", dimfuncnt);
 	fprintf(stderr, "Struct/union/enum blocks:	%d pcs\n", suedefcnt);
 	fprintf(stderr, "Inline node count:		%d pcs\n", inlnodecnt);
 	fprintf(stderr, "Inline control blocks:		%d pcs\n", inlstatcnt);
 	fprintf(stderr, "Permanent symtab entries:	%d pcs\n", symtabcnt);
+	fprintf(stderr, "Scope lookups:			%d pcs, %d probes\n",
+	    sfindcnt, sprobecnt);
+	fprintf(stderr, "Scope index builds:		%d pcs\n", sidxcnt);
+	fprintf(stderr, "Scope lookup cache hits:	%d pcs\n", slchits);
+	fprintf(stderr, "Tree nodes in use:		%d pcs, peak %d pcs\n",
+	    usednodes, maxnodes);
+	fprintf(stderr, "Node arenas:			%d allocated, %d freed\n",
+	    narenas, narenasfreed);
+	fprintf(stderr, "Register allocation rounds:	%d in %d functions\n",
+	    rarounds, rafuncs);
+	fprintf(stderr, "Most rounds in one function:	%d pcs\n", ramaxrounds);
+	fprintf(stderr, "Full graph build rounds:	%d pcs, %ld us/round\n",
+	    rafull, rafull ? rafulltime / rafull : 0L);
+	fprintf(stderr, "Incremental graph rounds:	%d pcs, %ld us/round\n",
+	    raincr, raincr ? raincrtime / raincr : 0L);
 }
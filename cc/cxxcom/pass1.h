@@ -354,6 +354,8 @@ int nncon(NODE *);
 void cunput(char);
 NODE *nametree(struct symtab *sp);
 void *inlalloc(int size);
+struct attr *tattr_new(int, int);
+struct attr *tattr_dup(struct attr *, int);
 void *blkalloc(int size);
 void pass1_lastchance(struct interpass *);
 void fldty(struct symtab *p);
@@ -526,10 +528,11 @@ enum {	ATTR_FIRST = ATTR_MI_MAX + 1,
 #endif
 
 /*
- * ATTR_STRUCT member list.
+ * ATTR_STRUCT member list, size and tag (for name mangling).
  */
 #define amlist  aa[0].varg
 #define amsize  aa[1].iarg
+#define amtag   aa[2].varg
 #define	strattr(x)	(attr_find(x, ATTR_STRUCT))
 
 #define	iarg(x)	aa[x].iarg
@@ -94,6 +94,7 @@ struct rstack {
 	int	rstr;
 	struct	symtab *rsym;
 //	struct	symtab *rb;
+	struct	symtab *rlast;	/* last member */
 	struct	attr *ap;
 	int	flags;
 #define	LASTELM	1
@@ -518,6 +519,7 @@ ftnend(void)
 
 	cftnod = NIL;
 	tcheck();
+	tslabfree();
 	brklab = contlab = retlab = NOLAB;
 	flostat = 0;
 	if (nerrors == 0) {
@@ -673,9 +675,12 @@ done:	autooff = AUTOINIT;
  * basic attributes for structs and enums
  */
 static struct attr *
-seattr(void)
+seattr(struct symtab *sp)
 {
-	return attr_add(attr_new(ATTR_ALIGNED, 4), attr_new(ATTR_STRUCT, 2));
+	struct attr *ap = attr_new(ATTR_STRUCT, 3);
+
+	ap->amtag = sp;
+	return attr_add(attr_new(ATTR_ALIGNED, 4), ap);
 }
 
 /*
@@ -716,11 +721,20 @@ deftag(char *name, int class)
 NODE *
 rstruct(char *tag, int soru)
 {
-	struct symtab *sp;
+	struct symtab *sp, *ns;
 
-	sp = deftag(tag, soru);
+	/* a tag in an enclosing scope, also the class being defined */
+	for (ns = nscur; ; ns = ns->sdown) {
+		for (sp = sfind(tag, ns->sup); sp; sp = snxt(tag, sp))
+			if (sp->sclass == soru)
+				break;
+		if (sp != NULL || ns == spole)
+			break;
+	}
+	if (sp == NULL)
+		sp = deftag(tag, soru);
 	if (sp->sap == NULL)
-		sp->sap = seattr();
+		sp->sap = seattr(sp);
 	return mkty(sp->stype, 0, sp->sap);
 }
 
@@ -868,13 +882,13 @@ bstruct(char *name, int soru, NODE *gp)
 	if (name != NULL) {
 		sp = deftag(name, soru);
 		if (sp->sap == NULL)
-			sp->sap = seattr();
+			sp->sap = seattr(sp);
 		ap = attr_find(sp->sap, ATTR_ALIGNED);
 		if (ap->iarg(0) != 0) {
 			if (sp->slevel < blevel) {
 				sp = hide(sp);
 				defstr(sp, soru);
-				sp->sap = seattr();
+				sp->sap = seattr(sp);
 			} else
 				uerror("%s redeclared", name);
 		}
@@ -882,8 +896,8 @@ bstruct(char *name, int soru, NODE *gp)
 		nscur = sp;
 		gap = sp->sap = attr_add(sp->sap, gap);
 	} else {
-		gap = attr_add(seattr(), gap);
 		sp = getsymtab("__%", SNORMAL);
+		gap = attr_add(seattr(sp), gap);
 	}
 
 	r = tmpcalloc(sizeof(struct rstack));
@@ -992,10 +1006,15 @@ soumemb(NODE *n, char *name, int class)
 		cerror("soumemb");
  
 	/* check if tag name exists */
-	lsp = NULL;
-	for (sp = /* rpole->rb */ nscur->sup; sp != NULL; lsp = sp, sp = sp->snext)
-		if (*name != '*' && sp->sname == name && class == sp->sclass)
-			uerror("redeclaration of %s", name);
+	if (*name != '*')
+		for (sp = sfind(name, nscur->sup); sp; sp = snxt(name, sp))
+			if (class == sp->sclass)
+				uerror("redeclaration of %s", name);
+	if ((lsp = rpole->rlast) == NULL)
+		lsp = nscur->sup;
+	if (lsp != NULL)
+		while (lsp->snext != NULL)
+			lsp = lsp->snext;
 
 	sp = getsymtab(name, SMOSNAME);
 #if 0
@@ -1008,6 +1027,8 @@ soumemb(NODE *n, char *name, int class)
 		nscur->sup = sp;
 	else
 		lsp->snext = sp;
+	scopeadd(lsp, sp);
+	rpole->rlast = sp;
 
 	n->n_sp = sp;
 	sp->stype = n->n_type;
@@ -1954,8 +1975,8 @@ arglist(NODE *n)
 {
 	union arglist *al;
 	NODE *w = n, **ap;
-	int num, cnt, i, j, k;
-	TWORD ty;
+	int num, cnt, i, j, k, m;
+	TWORD ty, *qv;
 
 #ifdef PCC_DEBUG
 	if (pdebug) {
@@ -1997,7 +2018,8 @@ arglist(NODE *n)
 	ap[i] = w;
 
 	/* Third: Create actual arg list */
-	for (k = 0, j = i; j >= 0; j--) {
+	qv = NULL;
+	for (k = m = 0, j = i; j >= 0; j--, m++) {
 		if (ap[j]->n_op == ELLIPSIS) {
 			al[k++].type = TELLIPSIS;
 			ap[j]->n_op = ICON; /* for tfree() */
@@ -2023,6 +2045,14 @@ arglist(NODE *n)
 			ty = ISPTR(sp->stype) ? PTR|VOID : sp->stype;
 		}
 #endif
+		if (ap[j]->n_qual) {
+			/* kept aside for name mangling */
+			if (qv == NULL) {
+				qv = permalloc(sizeof(TWORD) * cnt);
+				memset(qv, 0, sizeof(TWORD) * cnt);
+			}
+			qv[m] = ap[j]->n_qual;
+		}
 		al[k++].type = ty;
 		if (BTYPE(ty) == STRTY || BTYPE(ty) == UNIONTY)
 			al[k++].sap = ap[j]->n_ap;
@@ -2034,6 +2064,8 @@ arglist(NODE *n)
 	al[k++].type = TNULL;
 	if (k > num)
 		cerror("arglist: k%d > num%d", k, num);
+	if (qv != NULL)
+		alqsave(al, qv);
 	tfree(n);
 #ifdef PCC_DEBUG
 	if (pdebug)
@@ -2939,6 +2971,32 @@ inlalloc(int size)
 	return isinlining ?  permalloc(size) : tmpalloc(size);
 }
 
+/*
+ * As attr_new() and attr_dup(), but for attributes that only live on
+ * trees and can go away with the rest of the function.
+ */
+struct attr *
+tattr_new(int type, int nelem)
+{
+	struct attr *ap;
+	int sz;
+
+	sz = sizeof(struct attr) + nelem * sizeof(union aarg);
+	ap = memset(inlalloc(sz), 0, sz);
+	ap->atype = type;
+	return ap;
+}
+
+struct attr *
+tattr_dup(struct attr *ap, int n)
+{
+	int sz = sizeof(struct attr) + n * sizeof(union aarg);
+
+	ap = memcpy(inlalloc(sz), ap, sz);
+	ap->next = NULL;
+	return ap;
+}
+
 /*
  * Fetch pointer to first member in a struct list.
  */
@@ -70,6 +70,7 @@
 # include "pass2.h"
 
 # include <stdarg.h>
+# include <stdlib.h>
 # include <string.h>
 
 static void chkpun(NODE *p);
@@ -2770,7 +2771,7 @@ p2tree(NODE *p)
 	p->n_ap = NULL;
 	for (ap = oap; ap; ap = ap->next)
 		if (ap->atype < ATTR_MI_MAX)
-			p->n_ap = attr_add(p->n_ap, attr_dup(ap, 3));
+			p->n_ap = attr_add(p->n_ap, tattr_dup(ap, 3));
 	/* XXX store size of attr in itself */
 
 	ty = coptype(p->n_op);
@@ -3107,6 +3108,7 @@ send_passt(int type, ...)
 		ip->ip_lbl = va_arg(ap, int);
 		ipp->ip_tmpnum = va_arg(ap, int);
 		ipp->ip_lblnum = crslab;
+		ipp->ip_aggrs = NULL;
 		if (type == IP_PROLOG)
 			ipp->ip_lblnum--;
 		break;
@@ -3250,19 +3252,35 @@ cdope(int op)
 NODE *
 ccopy(NODE *p) 
 {  
-	NODE *q;
+	NODE *lstk[WSTKSZ], **stk = lstk;
+	NODE *q, *rv;
+	int sp = 0, sz = WSTKSZ;
 
-	q = talloc();
+	rv = q = talloc();
 	*q = *p;
-
-	switch (coptype(q->n_op)) {
-	case BITYPE:
-		q->n_right = ccopy(p->n_right);
-	case UTYPE: 
-		q->n_left = ccopy(p->n_left);
+	for (;;) {
+		switch (coptype(q->n_op)) {
+		case BITYPE:
+			p = talloc();
+			*p = *q->n_right;
+			q->n_right = p;
+			if (sp == sz)
+				stk = wstkgrow(stk, lstk, &sz, sizeof(NODE *));
+			stk[sp++] = p;
+			/* FALLTHROUGH */
+		case UTYPE: 
+			p = talloc();
+			*p = *q->n_left;
+			q = q->n_left = p;
+			continue;
+		}
+		if (sp == 0)
+			break;
+		q = stk[--sp];
 	}
-
-	return(q);
+	if (stk != lstk)
+		free(stk);
+	return(rv);
 }
 
 NODE *
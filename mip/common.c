@@ -60,6 +60,7 @@
 
 #include <stdarg.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
@@ -322,33 +323,184 @@ warner(int type, ...)
 #endif /* MKEXT */
 
 #ifndef MKEXT
-static NODE *freelink;
-int usednodes;
+int usednodes, maxnodes;
 
 #ifndef LANG_F77
+/*
+ * Nodes are allocated from slabs of NSLABSZ bytes, aligned on their
+ * size so that the slab of a node is found by masking its address.
+ * Each slab keeps its own free list and count of live nodes.
+ * Nodes are taken from one slab until it is used up, so that trees
+ * built together end up in contiguous memory.  Slabs are carved from
+ * arenas of NARENA slabs; after each function tslabfree() recycles
+ * the slabs that became empty in one step and gives unused arenas
+ * back to the system.
+ */
+#define	NSLABSZ	16384
+#define	NARENA	32
+
+struct narena {
+	struct narena *next;
+	char *mem;
+	int nempty;		/* slabs on the empty list */
+};
+
+/* The nodes come first, so they start on a cache line boundary */
+#define	NPERSLAB	((int)((NSLABSZ-5*sizeof(void *))/sizeof(NODE)))
+struct nslab {
+	NODE n[NPERSLAB];
+	struct nslab *next;	/* on one of the slab lists */
+	struct narena *arena;
+	NODE *free;		/* freed nodes in this slab */
+	int live;		/* nodes in use */
+	int bump;		/* first never used node */
+};
+#define	NTOSLAB(p)	\
+	((struct nslab *)((intptr_t)(p) & ~(intptr_t)(NSLABSZ-1)))
+
+static struct narena *arenas;
+static struct nslab *curslab;	/* allocating from */
+static struct nslab *slabfull;	/* in use, no free nodes when last seen */
+static struct nslab *slabpart;	/* in use, with free nodes */
+static struct nslab *slabempty;	/* unused */
+int narenas, narenasfreed;
+
+static void
+slabinit(struct nslab *s)
+{
+	s->free = NULL;
+	s->live = s->bump = 0;
+	s->next = slabempty;
+	slabempty = s;
+	s->arena->nempty++;
+}
+
+/*
+ * Get a new slab to allocate from.
+ */
+static struct nslab *
+newslab(void)
+{
+	struct narena *a;
+	struct nslab *s;
+	char *m;
+	int i;
+
+	if (curslab != NULL) {
+		curslab->next = slabfull;
+		slabfull = curslab;
+	}
+	if ((s = slabpart) != NULL) {
+		slabpart = s->next;
+		return curslab = s;
+	}
+	if (slabempty == NULL) {
+		if ((a = malloc(sizeof(struct narena))) == NULL ||
+		    (a->mem = malloc((NARENA+1) * NSLABSZ)) == NULL)
+			cerror("out of memory");
+		a->next = arenas;
+		arenas = a;
+		a->nempty = 0;
+		narenas++;
+		m = (char *)NTOSLAB(a->mem + NSLABSZ - 1);
+		for (i = 0; i < NARENA; i++, m += NSLABSZ) {
+			((struct nslab *)m)->arena = a;
+			slabinit((struct nslab *)m);
+		}
+	}
+	s = slabempty;
+	slabempty = s->next;
+	s->arena->nempty--;
+	return curslab = s;
+}
+
 NODE *
 talloc(void)
 {
 	register NODE *p;
+	struct nslab *s;
 
-	usednodes++;
+	if (++usednodes > maxnodes)
+		maxnodes = usednodes;
 
-	if (freelink != NULL) {
-		p = freelink;
-		freelink = p->next;
-		if (p->n_op != FREE)
-			cerror("node not FREE: %p", p);
+	if ((s = curslab) == NULL || (s->bump == NPERSLAB && s->free == NULL))
+		s = newslab();
+	s->live++;
+	if (s->bump < NPERSLAB) {
+		p = &s->n[s->bump++];
+		p->n_op = FREE;
 		if (ndebug)
-			printf("alloc node %p from freelist\n", p);
+			printf("alloc node %p from memory\n", p);
 		return p;
 	}
-
-	p = permalloc(sizeof(NODE));
-	p->n_op = FREE;
+	p = s->free;
+	s->free = p->next;
+	if (p->n_op != FREE)
+		cerror("node not FREE: %p", p);
 	if (ndebug)
-		printf("alloc node %p from memory\n", p);
+		printf("alloc node %p from freelist\n", p);
 	return p;
 }
+
+static void
+slabsort(struct nslab *s)
+{
+	if (s->live == 0) {
+		slabinit(s);
+	} else if (s->free != NULL) {
+		s->next = slabpart;
+		slabpart = s;
+	} else {
+		s->next = slabfull;
+		slabfull = s;
+	}
+}
+
+/*
+ * Recycle the slabs without live nodes, called when a function is
+ * done.  Arenas where all slabs are unused are freed, except one.
+ */
+void
+tslabfree(void)
+{
+	struct nslab *s, *n, *full, *part, **sp;
+	struct narena *a, **ap;
+	int spare = 0;
+
+	full = slabfull, part = slabpart;
+	slabfull = slabpart = NULL;
+	for (s = full; s; s = n) {
+		n = s->next;
+		slabsort(s);
+	}
+	for (s = part; s; s = n) {
+		n = s->next;
+		slabsort(s);
+	}
+	if ((s = curslab) != NULL && s->live == 0) {
+		s->free = NULL;
+		s->bump = 0;
+	}
+
+	for (ap = &arenas; (a = *ap) != NULL; ) {
+		if (a->nempty < NARENA || spare++ == 0) {
+			ap = &a->next;
+			continue;
+		}
+		for (sp = &slabempty; *sp; )
+			if ((*sp)->arena == a)
+				*sp = (*sp)->next;
+			else
+				sp = &(*sp)->next;
+		*ap = a->next;
+		free(a->mem);
+		free(a);
+		narenasfreed++;
+	}
+}
+
+#else
+static NODE *freelink;
 #endif
 
 /*
@@ -357,19 +509,35 @@ talloc(void)
 NODE *
 tcopy(NODE *p)
 {
-	NODE *q;
+	NODE *lstk[WSTKSZ], **stk = lstk;
+	NODE *q, *rv;
+	int sp = 0, sz = WSTKSZ;
 
-	q = talloc();
+	rv = q = talloc();
 	*q = *p;
-
-	switch (optype(q->n_op)) {
-	case BITYPE:
-		q->n_right = tcopy(p->n_right);
-	case UTYPE:
-		q->n_left = tcopy(p->n_left);
+	for (;;) {
+		switch (optype(q->n_op)) {
+		case BITYPE:
+			p = talloc();
+			*p = *q->n_right;
+			q->n_right = p;
+			if (sp == sz)
+				stk = wstkgrow(stk, lstk, &sz, sizeof(NODE *));
+			stk[sp++] = p;
+			/* FALLTHROUGH */
+		case UTYPE:
+			p = talloc();
+			*p = *q->n_left;
+			q = q->n_left = p;
+			continue;
+		}
+		if (sp == 0)
+			break;
+		q = stk[--sp];
 	}
-
-	return(q);
+	if (stk != lstk)
+		free(stk);
+	return(rv);
 }
 
 #ifndef LANG_F77
@@ -406,7 +574,10 @@ tfree(NODE *p)
 NODE *
 nfree(NODE *p)
 {
-	NODE *l;
+	NODE *l, **fl;
+#ifndef LANG_F77
+	struct nslab *s;
+#endif
 #ifdef PCC_DEBUG_NODES
 	NODE *q;
 #endif
@@ -417,8 +588,15 @@ nfree(NODE *p)
 	l = p->n_left;
 	if (p->n_op == FREE)
 		cerror("freeing FREE node", p);
+#ifdef LANG_F77
+	fl = &freelink;
+#else
+	s = NTOSLAB(p);
+	s->live--;
+	fl = &s->free;
+#endif
 #ifdef PCC_DEBUG_NODES
-	q = freelink;
+	q = *fl;
 	while (q != NULL) {
 		if (q == p)
 			cerror("freeing free node %p", p);
@@ -429,8 +607,8 @@ nfree(NODE *p)
 	if (ndebug)
 		printf("freeing node %p\n", p);
 	p->n_op = FREE;
-	p->next = freelink;
-	freelink = p;
+	p->next = *fl;
+	*fl = p;
 	usednodes--;
 	return l;
 }
@@ -449,46 +627,103 @@ int cdope(int);
 #define coptype(o)	(cdope(o)&TYFLG)
 #endif
 
-void
-fwalk(NODE *t, void (*f)(NODE *, int, int *, int *), int down)
+/*
+ * The tree walkers keep their own stack instead of recursing, so that
+ * very deep trees cannot overflow the C stack.  The stack starts out
+ * in the caller's frame and moves to the heap if more is needed.
+ */
+void *
+wstkgrow(void *stk, void *lstk, int *sz, size_t esz)
 {
+	void *n;
+
+	if ((n = malloc(*sz * 2 * esz)) == NULL)
+		cerror("out of memory");
+	memcpy(n, stk, *sz * esz);
+	if (stk != lstk)
+		free(stk);
+	*sz *= 2;
+	return n;
+}
 
-	int down1, down2;
-
-	more:
-	down1 = down2 = 0;
-
-	(*f)(t, down, &down1, &down2);
-
-	switch (OPTYPE( t->n_op )) {
-
-	case BITYPE:
-		fwalk( t->n_left, f, down1 );
-		t = t->n_right;
-		down = down2;
-		goto more;
-
-	case UTYPE:
-		t = t->n_left;
-		down = down1;
-		goto more;
+#ifdef __GNUC__
+#define	PREFETCH(p)	__builtin_prefetch(p)
+#else
+#define	PREFETCH(p)
+#endif
 
+void
+fwalk(NODE *t, void (*f)(NODE *, int, int *, int *), int down)
+{
+	struct fwstk {
+		NODE *t;
+		int down;
+	} lstk[WSTKSZ], *stk = lstk;
+	int down1, down2, sp = 0, sz = WSTKSZ;
+
+	for (;;) {
+		down1 = down2 = 0;
+
+		(*f)(t, down, &down1, &down2);
+
+		switch (OPTYPE( t->n_op )) {
+		case BITYPE:
+			if (sp == sz)
+				stk = wstkgrow(stk, lstk, &sz, sizeof(*stk));
+			stk[sp].t = t->n_right;
+			stk[sp++].down = down2;
+			PREFETCH(t->n_right);
+			/* FALLTHROUGH */
+		case UTYPE:
+			t = t->n_left;
+			down = down1;
+			continue;
+		}
+		if (sp == 0)
+			break;
+		sp--;
+		t = stk[sp].t;
+		down = stk[sp].down;
 	}
+	if (stk != lstk)
+		free(stk);
 }
 
+/*
+ * Postorder walk.  f may free the node it is called with, so nothing
+ * is read from a node after f has seen it.
+ */
 void
 walkf(NODE *t, void (*f)(NODE *, void *), void *arg)
 {
-	int opty;
-
-
-	opty = OPTYPE(t->n_op);
-
-	if (opty != LTYPE)
-		walkf( t->n_left, f, arg );
-	if (opty == BITYPE)
-		walkf( t->n_right, f, arg );
-	(*f)(t, arg);
+	NODE *lstk[WSTKSZ], **stk = lstk, *q;
+	int sp = 0, sz = WSTKSZ;
+
+	for (;;) {
+		while (OPTYPE(t->n_op) != LTYPE) {
+			if (sp == sz)
+				stk = wstkgrow(stk, lstk, &sz, sizeof(NODE *));
+			stk[sp++] = t;
+			if (OPTYPE(t->n_op) == BITYPE)
+				PREFETCH(t->n_right);
+			t = t->n_left;
+		}
+		for (;;) {
+			(*f)(t, arg);
+			if (sp == 0) {
+				if (stk != lstk)
+					free(stk);
+				return;
+			}
+			q = stk[sp-1];
+			if (OPTYPE(q->n_op) == BITYPE && q->n_left == t) {
+				t = q->n_right;
+				break;
+			}
+			sp--;
+			t = q;
+		}
+	}
 }
 
 int dope[DSIZE];
@@ -720,30 +955,120 @@ struct xalloc {
 } *tapole, *tmpole;
 int uselem = NELEM; /* next unused element */
 
+/*
+ * Released chunks are kept for reuse instead of going back to free().
+ * Chunks go on a free list, requests too big for a chunk are kept in
+ * power-of-two size bins of MEMCHUNKSZ << bin bytes; the size class
+ * is stored in the word after the link.  Requests above the biggest
+ * bin are malloc'ed and freed as before.
+ */
+#define	NTMPBIN	12
+#define	XHDRSZ	ROUNDUP(2*sizeof(struct xalloc *))
+#define	XBIN(xp)	(*(size_t *)((char *)(xp) + sizeof(struct xalloc *)))
+static struct xalloc *tafree, *tmbin[NTMPBIN];
+size_t tmpinuse, tmphiwat;
+int tmpreused;
+
+static void *
+tmpget(size_t size)
+{
+	void *rv;
+
+	if ((rv = malloc(size)) == NULL)
+		cerror("out of memory");
+	tmpallocsize += size;
+	return rv;
+}
+
+static void
+tmpuse(size_t size)
+{
+	if ((tmpinuse += size) > tmphiwat)
+		tmphiwat = tmpinuse;
+}
+
+/*
+ * Release the big allocations on tmpole down to (but not including) m.
+ */
+static void
+relbig(struct xalloc *m)
+{
+	struct xalloc *x1;
+	size_t b;
+
+	while (tmpole != m) {
+		x1 = tmpole;
+		tmpole = tmpole->next;
+		b = XBIN(x1);
+		ALLDEBUG(("XMEM! free %p bin %zd\n", x1, b));
+		if (b < NTMPBIN) {
+			tmpinuse -= (size_t)MEMCHUNKSZ << b;
+			x1->next = tmbin[b];
+			tmbin[b] = x1;
+		} else {
+			tmpinuse -= b;
+			tmpallocsize -= b;
+			free(x1);
+		}
+	}
+}
+
+/*
+ * Release the chunks on tapole down to (but not including) m.
+ */
+static void
+relchunks(struct xalloc *m)
+{
+	struct xalloc *x1;
+
+	while (tapole != m) {
+		x1 = tapole;
+		tapole = tapole->next;
+		ALLDEBUG(("MOREMEM! free %p\n", x1));
+		tmpinuse -= sizeof(struct xalloc);
+		x1->next = tafree;
+		tafree = x1;
+	}
+}
+
 void *
 tmpalloc(size_t size)
 {
 	struct xalloc *xp;
 	void *rv;
-	size_t nelem;
+	size_t nelem, b;
 
 	nelem = ROUNDUP(size)/ELEMSZ;
 	ALLDEBUG(("tmpalloc(%ld,%ld) %zd (%zd) ", ELEMSZ, NELEM, size, nelem));
 	if (nelem > NELEM/2) {
-		size += ROUNDUP(sizeof(struct xalloc *));
-		if ((xp = malloc(size)) == NULL)
-			cerror("out of memory");
+		size += XHDRSZ;
+		for (b = 0; b < NTMPBIN && ((size_t)MEMCHUNKSZ << b) < size; b++)
+			;
+		if (b < NTMPBIN && (xp = tmbin[b]) != NULL) {
+			tmbin[b] = xp->next;
+			tmpreused++;
+		} else if (b < NTMPBIN) {
+			xp = tmpget((size_t)MEMCHUNKSZ << b);
+		} else
+			xp = tmpget(b = size);
+		tmpuse(b < NTMPBIN ? (size_t)MEMCHUNKSZ << b : b);
+		XBIN(xp) = b;
 		ALLDEBUG(("XMEM! (%zd,%p) ", size, xp));
 		xp->next = tmpole;
 		tmpole = xp;
-		ALLDEBUG(("rv %p\n", &xp->u.elm[0]));
-		return &xp->u.elm[0];
+		rv = (char *)xp + XHDRSZ;
+		ALLDEBUG(("rv %p\n", rv));
+		return rv;
 	}
 	if (nelem + uselem >= NELEM) {
 		ALLDEBUG(("MOREMEM! "));
 		/* alloc more */
-		if ((xp = malloc(sizeof(struct xalloc))) == NULL)
-			cerror("out of memory");
+		if ((xp = tafree) != NULL) {
+			tafree = xp->next;
+			tmpreused++;
+		} else
+			xp = tmpget(sizeof(struct xalloc));
+		tmpuse(sizeof(struct xalloc));
 		xp->next = tapole;
 		tapole = xp;
 		uselem = 0;
@@ -759,22 +1084,9 @@ tmpalloc(size_t size)
 void
 tmpfree(void)
 {
-	struct xalloc *x1;
-
-	while (tmpole) {
-		x1 = tmpole;
-		tmpole = tmpole->next;
-		ALLDEBUG(("XMEM! free %p\n", x1));
-		free(x1);
-	}
-	while (tapole && tapole->next) {
-		x1 = tapole;
-		tapole = tapole->next;
-		ALLDEBUG(("MOREMEM! free %p\n", x1));
-		free(x1);
-	}
-	if (tapole)
-		uselem = 0;
+	relbig(NULL);
+	relchunks(NULL);
+	uselem = NELEM;
 }
 
 /*
@@ -794,18 +1106,8 @@ markset(struct mark *m)
 void
 markfree(struct mark *m)
 {
-	struct xalloc *x1;
-
-	while (tmpole != m->tmsav) {
-		x1 = tmpole;
-		tmpole = tmpole->next;
-		free(x1);
-	}
-	while (tapole != m->tasav) {
-		x1 = tapole;
-		tapole = tapole->next;
-		free(x1);
-	}
+	relbig(m->tmsav);
+	relchunks(m->tasav);
 	uselem = m->elem;
 }
 
@@ -172,9 +172,10 @@
 /*
  * 
  */
-extern int gflag, kflag, pflag;
+extern int gflag, kflag, pflag, sflag;
 extern int sspflag;
-extern int xssa, xtailcall, xtemps, xdeljumps, xdce;
+extern int xssa, xtailcall, xtemps, xdeljumps, xdce, xvector, xjobs;
+extern int xlinscan;
 extern int xuchar;
 
 int yyparse(void);
@@ -252,6 +253,21 @@ struct interpass {
 	} _un;
 };
 
+/*
+ * Automatic variable on stack.  If it is a small aggregate with only
+ * scalar members (nmemb > 0) pass2 may split it into temporaries.
+ * Offsets are in bytes from FPREG.
+ */
+#define	NAGGRMEMB	4
+struct interpass_aggr {
+	struct interpass_aggr *next;
+	int off;		/* offset of the aggregate */
+	int sz;			/* size of the aggregate */
+	int nmemb;		/* number of members, 0 if not splittable */
+	int moff[NAGGRMEMB];	/* member offsets */
+	TWORD mtype[NAGGRMEMB];	/* member types */
+};
+
 /*
  * Special struct for prologue/epilogue.
  * - ip_lblnum contains the lowest/highest+1 label used
@@ -269,6 +285,7 @@ struct interpass_prolog {
 	int ip_tmpnum;		/* # allocated temp nodes so far */
 	int ip_lblnum;		/* # used labels so far */
 	int *ip_labels;		/* labels used in computed goto */
+	struct interpass_aggr *ip_aggrs; /* automatics on stack (epilog) */
 #ifdef TARGET_IPP_MEMBERS
 	TARGET_IPP_MEMBERS
 #endif
@@ -359,6 +376,7 @@ void topt_compile(struct interpass *);
 
 /* pass 2 communication subroutines */
 void pass2_compile(struct interpass *);
+void pass2_done(void);
 
 /* node routines */
 NODE *nfree(NODE *);
@@ -374,6 +392,9 @@ void werror(const char *s, ...);
 void uerror(const char *s, ...);
 void mkdope(void);
 void tcheck(void);
+void tslabfree(void);
+#define	WSTKSZ	64	/* initial tree walker stack */
+void *wstkgrow(void *, void *, int *, size_t);
 
 extern	int nerrors;		/* number of errors seen so far */
 extern	int warniserr;		/* treat warnings as errors */
@@ -62,6 +62,7 @@
 
 #include "pass2.h"
 
+#include <stdlib.h>
 #ifdef HAVE_STRINGS_H
 #include <strings.h>
 #endif
@@ -1200,53 +1201,74 @@ findmops(NODE *p, int cookie)
 int
 treecmp(NODE *p1, NODE *p2)
 {
-	if (p1->n_op != p2->n_op)
-		return 0;
-
-	switch (p1->n_op) {
-	case SCONV:
-	case UMUL:
-		return treecmp(p1->n_left, p2->n_left);
+	struct tcstk {
+		NODE *p1, *p2;
+	} lstk[WSTKSZ], *stk = lstk;
+	int sp = 0, sz = WSTKSZ, rv = 0;
+
+	for (;;) {
+		if (p1->n_op != p2->n_op)
+			goto out;
+
+		switch (p1->n_op) {
+		case SCONV:
+		case UMUL:
+			p1 = p1->n_left;
+			p2 = p2->n_left;
+			continue;
 
-	case OREG:
-		if (p1->n_lval != p2->n_lval || p1->n_rval != p2->n_rval)
-			return 0;
-		break;
+		case OREG:
+			if (p1->n_lval != p2->n_lval || p1->n_rval != p2->n_rval)
+				goto out;
+			break;
 
-	case NAME:
-	case ICON:
-		if (strcmp(p1->n_name, p2->n_name))
-			return 0;
-		/* FALLTHROUGH */
-		if (p1->n_lval != p2->n_lval)
-			return 0;
-		break;
+		case NAME:
+		case ICON:
+			if (strcmp(p1->n_name, p2->n_name))
+				goto out;
+			/* FALLTHROUGH */
+			if (p1->n_lval != p2->n_lval)
+				goto out;
+			break;
 
-	case TEMP:
+		case TEMP:
 #ifdef notyet
-		/* SSA will put assignment in separate register */
-		/* Help out by accepting different regs here */
-		if (xssa)
-			break;
+			/* SSA will put assignment in separate register */
+			/* Help out by accepting different regs here */
+			if (xssa)
+				break;
 #endif
-	case REG:
-		if (p1->n_rval != p2->n_rval)
-			return 0;
-		break;
-	case LS:
-	case RS:
-	case PLUS:
-	case MINUS:
-	case MUL:
-	case DIV:
-		if (treecmp(p1->n_left, p2->n_left) == 0 ||
-		    treecmp(p1->n_right, p2->n_right) == 0)
-			return 0;
-		break;
+		case REG:
+			if (p1->n_rval != p2->n_rval)
+				goto out;
+			break;
+		case LS:
+		case RS:
+		case PLUS:
+		case MINUS:
+		case MUL:
+		case DIV:
+			if (sp == sz)
+				stk = wstkgrow(stk, lstk, &sz, sizeof(*stk));
+			stk[sp].p1 = p1->n_right;
+			stk[sp++].p2 = p2->n_right;
+			p1 = p1->n_left;
+			p2 = p2->n_left;
+			continue;
 
-	default:
-		return 0;
+		default:
+			goto out;
+		}
+		if (sp == 0)
+			break;
+		sp--;
+		p1 = stk[sp].p1;
+		p2 = stk[sp].p2;
 	}
-	return 1;
+	rv = 1;
+out:
+	if (stk != lstk)
+		free(stk);
+	return rv;
 }
 #endif
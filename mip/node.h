@@ -55,6 +55,10 @@ struct attr {
  *
  * This is rewritten to be a struct instead of a union as it
  * was in the old compiler.
+ *
+ * The int-sized members come first so that no padding is needed
+ * before the pointers; a node is 64 bytes on LP64 hosts, one cache
+ * line.  next is only used on the free list.
  */
 typedef unsigned int TWORD;
 #define NIL (NODE *)0
@@ -64,23 +68,23 @@ struct suedef;
 struct regw;
 
 typedef struct node {
-	struct	node *next;
 	int	n_op;
+	TWORD	n_type;
+	int	n_su;
+	TWORD	n_qual;
 	union {
 		int _reg;
 		struct regw *_regw;
 	} n_3;
 #define	n_reg	n_3._reg
 #define	n_regw	n_3._regw
-	TWORD	n_type;
-	TWORD	n_qual;
-	int	n_su;
 	union {
 		char *	_name;
 		int	_label;
 		union	dimfun *_df;
 	} n_5;
 	struct attr *n_ap;
+	struct	node *next;
 	union {
 		struct {
 			union {
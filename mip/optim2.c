@@ -77,6 +77,9 @@ void renamevar(struct p2env *p2e,struct basicblock *bblock);
 void removephi(struct p2env *p2e);
 void remunreach(struct p2env *);
 static void liveanal(struct p2env *p2e);
+#ifdef MYVECTOR
+static void findloops(struct p2env *p2e);
+#endif
 static void printip2(struct interpass *);
 
 /* create "proper" basic blocks, add labels where needed (so bblocks have labels) */
@@ -224,6 +227,11 @@ optimize(struct p2env *p2e)
 	}
 #endif
 
+#ifdef MYVECTOR
+	if (xvector && xtemps)
+		findloops(p2e);
+#endif
+
 	myoptim(ipole);
 }
 
@@ -619,17 +627,19 @@ iterate(struct p2env *p2e, struct dlnod *dl)
 			}
 		}
 		if (p->op == JBR) {
-			/* Removes dead code */
-			while (p->forw && p->forw->op!=LABEL &&
-			    p->forw->op!=EROU) {
+			/* Removes dead code, asm may define labels; keep it */
+			for (p1 = p->forw; p1 && p1->op!=LABEL &&
+			    p1->op!=EROU; p1 = p1->forw) {
+				if (p1->dlip->type == IP_ASM)
+					continue;
 				nchange++;
-				if (p->forw->ref)
-					decref(p->forw->ref);
+				if (p1->ref)
+					decref(p1->ref);
 
-				iprem(p->forw);
+				iprem(p1);
 
-				p->forw = p->forw->forw;
-				p->forw->back = p;
+				p1->back->forw = p1->forw;
+				p1->forw->back = p1->back;
 			}
 			rp = p->forw;
 			while (rp && rp->op==LABEL) {
@@ -676,6 +686,248 @@ deljumps(struct p2env *p2e)
 	markfree(&mark);
 }
 
+/*
+ * Scalar replacement of small aggregates.
+ * pass1 tells where the automatics are on stack, and which of them are
+ * structs with only scalar members.  If all references into such a
+ * block are accesses of its members, and its address is never taken,
+ * each member is replaced by a temporary so that it can be put in a
+ * register.  Blocks may overlap if they are in different scopes, a
+ * member is only replaced if all blocks it is in can be split.
+ */
+static struct aggrinfo {
+	struct interpass_aggr *ag;
+	int ok;
+	int temp[NAGGRMEMB];
+} *agi;
+static int nagi, agbad;
+static struct p2env *agp2e;
+
+/*
+ * Return 1 and the offset if p is an address FPREG +- constant.
+ */
+static int
+fpaddr(NODE *p, int *off)
+{
+	NODE *r = p->n_right;
+
+	if ((p->n_op != PLUS && p->n_op != MINUS) ||
+	    p->n_left->n_op != REG || regno(p->n_left) != FPREG ||
+	    r->n_op != ICON || r->n_name[0] != '\0')
+		return 0;
+	*off = (int)(p->n_op == PLUS ? r->n_lval : -r->n_lval);
+	return 1;
+}
+
+/*
+ * Scalar access of type t at offset off.  Check it, or if fix is set
+ * replace it with its temporary.
+ */
+static void
+agacc(NODE *p, int off, TWORD t, int fix)
+{
+	struct aggrinfo *a, *f;
+	int i, j, fj, keep;
+
+	f = NULL;
+	fj = keep = 0;
+	for (i = 0; i < nagi; i++) {
+		a = &agi[i];
+		if (off < a->ag->off || off >= a->ag->off + a->ag->sz)
+			continue;
+		for (j = 0; j < a->ag->nmemb; j++)
+			if (a->ag->moff[j] == off && a->ag->mtype[j] == t)
+				break;
+		if (j == a->ag->nmemb)
+			a->ok = 0;
+		if (a->ok == 0)
+			keep = 1;
+		else if (f == NULL)
+			f = a, fj = j;
+	}
+	if (fix == 0 || keep || f == NULL)
+		return;
+
+	if (f->temp[fj] == 0)
+		f->temp[fj] = agp2e->epp->ip_tmpnum++;
+	if (p->n_op == UMUL)
+		tfree(p->n_left);
+	p->n_op = TEMP;
+	p->n_lval = 0;
+	regno(p) = f->temp[fj];
+}
+
+/*
+ * Address into the stack is used, the block cannot be split.
+ */
+static void
+agesc(int off)
+{
+	int i;
+
+	for (i = 0; i < nagi; i++)
+		if (off >= agi[i].ag->off && off < agi[i].ag->off + agi[i].ag->sz)
+			agi[i].ok = 0;
+}
+
+static void
+agscan(NODE *p, int fix)
+{
+	int o = p->n_op, off;
+
+	if (o == UMUL && fpaddr(p->n_left, &off)) {
+		agacc(p, off, p->n_type, fix);
+		return;
+	}
+	if (o == OREG && regno(p) == FPREG) {
+		agacc(p, (int)p->n_lval, p->n_type, fix);
+		return;
+	}
+	if (o == ADDROF && p->n_left->n_op == OREG &&
+	    regno(p->n_left) == FPREG) {
+		agesc((int)p->n_left->n_lval);
+		return;
+	}
+	if (o == ADDROF && p->n_left->n_op == UMUL &&
+	    fpaddr(p->n_left->n_left, &off)) {
+		agesc(off);
+		return;
+	}
+	if (fpaddr(p, &off)) {
+		agesc(off);
+		return;
+	}
+	if ((o == REG && regno(p) == FPREG) || o == XASM) {
+		agbad = 1; /* cannot follow */
+		return;
+	}
+	if (optype(o) != LTYPE) {
+		agscan(p->n_left, fix);
+		if (optype(o) == BITYPE)
+			agscan(p->n_right, fix);
+	}
+}
+
+void
+splitaggr(struct p2env *p2e)
+{
+	struct interpass_aggr *ag;
+	struct interpass *ip;
+	int i;
+
+	nagi = 0;
+	for (ag = p2e->epp->ip_aggrs; ag; ag = ag->next)
+		nagi++;
+	agi = tmpcalloc(sizeof(struct aggrinfo) * nagi);
+	for (i = 0, ag = p2e->epp->ip_aggrs; ag; ag = ag->next, i++) {
+		agi[i].ag = ag;
+		agi[i].ok = ag->nmemb > 0;
+	}
+	agp2e = p2e;
+	agbad = 0;
+
+	DLIST_FOREACH(ip, &p2e->ipole, qelem) {
+		if (ip->type == IP_ASM)
+			agbad = 1;
+		if (ip->type == IP_NODE)
+			agscan(ip->ip_node, 0);
+	}
+	for (i = 0; i < nagi; i++)
+		if (agi[i].ok)
+			break;
+	if (agbad || i == nagi)
+		return;
+
+	DLIST_FOREACH(ip, &p2e->ipole, qelem)
+		if (ip->type == IP_NODE)
+			agscan(ip->ip_node, 1);
+}
+
+#ifdef MYVECTOR
+/*
+ * Find innermost counted loops and let the target vectorize them.
+ * Only loops as pass1 generates them for "for (; i < n; i++)" with
+ * a body of straight-line code are recognized:
+ *
+ *	Lh:	CBRANCH(i >= n, Lx)
+ *		body
+ *		GOTO Lh
+ *
+ * where the loop head is only reached from the block before and from
+ * the back jump.  The block before may end with a jump to the loop
+ * head, as left by removephi().
+ */
+static int
+nparents(struct basicblock *bb)
+{
+	struct cfgnode *cn;
+	int n = 0;
+
+	SLIST_FOREACH(cn, &bb->parents, cfgelem)
+		n++;
+	return n;
+}
+
+static void
+findloops(struct p2env *p2e)
+{
+	struct basicblock *bb, *hb, *pb;
+	struct interpass *ip;
+	struct loopinfo li;
+	NODE *p;
+
+	DLIST_FOREACH(hb, &p2e->bblocks, bbelem) {
+		if (hb->first->type == IP_EPILOG)
+			break;
+		ip = hb->last;
+		if (hb->first->type != IP_DEFLAB ||
+		    DLIST_PREV(ip, qelem) != hb->first || ip->type != IP_NODE)
+			continue;
+		p = ip->ip_node;
+		if (p->n_op != CBRANCH || p->n_left->n_op != GE ||
+		    p->n_left->n_left->n_op != TEMP)
+			continue;
+		pb = DLIST_PREV(hb, bbelem);
+		if (pb->last->type == IP_PROLOG || nparents(hb) != 2)
+			continue;
+		li.at = pb->last;
+		if (li.at->type == IP_NODE && li.at->ip_node->n_op == GOTO) {
+			p = li.at->ip_node;
+			if (p->n_left->n_op != ICON ||
+			    p->n_left->n_lval != hb->first->ip_lbl)
+				continue;
+			li.at = DLIST_PREV(li.at, qelem);
+		}
+
+		/* follow the body until the back jump */
+		for (bb = DLIST_NEXT(hb, bbelem); ; bb = DLIST_NEXT(bb, bbelem)) {
+			if (bb->first->type == IP_EPILOG || nparents(bb) != 1)
+				break;
+			if (bb->last->type != IP_NODE)
+				continue;
+			p = bb->last->ip_node;
+			if (p->n_op == CBRANCH)
+				break;
+			if (p->n_op == GOTO)
+				break;
+		}
+		if (bb->first->type == IP_EPILOG || nparents(bb) != 1 ||
+		    p->n_op != GOTO || p->n_left->n_op != ICON ||
+		    p->n_left->n_lval != hb->first->ip_lbl)
+			continue;
+
+		li.pre = pb;
+		li.first = DLIST_NEXT(hb->last, qelem);
+		li.last = bb->last;
+		li.ind = hb->last->ip_node->n_left->n_left;
+		li.lim = hb->last->ip_node->n_left->n_right;
+		if (myvector(p2e, &li))
+			BDEBUG(("vectorized loop at " LABFMT "\n",
+			    hb->first->ip_lbl));
+	}
+}
+#endif
+
 void
 optdump(struct interpass *ip)
 {
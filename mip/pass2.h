@@ -443,6 +443,7 @@ callop(int o)
 
 void emit(struct interpass *);
 void optimize(struct p2env *);
+void splitaggr(struct p2env *);
 
 struct basicblock {
 	DLIST_ENTRY(basicblock) bbelem;
@@ -530,6 +531,21 @@ struct p2env {
 
 extern struct p2env p2env;
 
+#ifdef MYVECTOR
+/*
+ * Innermost counted loop, as found by the optimizer.
+ */
+struct loopinfo {
+	struct basicblock *pre;		/* block entering the loop test */
+	struct interpass *at;		/* end of pre, before any jump */
+	struct interpass *first;	/* first statement of body */
+	struct interpass *last;		/* back jump */
+	NODE *ind;			/* induction variable, a TEMP */
+	NODE *lim;			/* bound, loops while ind < lim */
+};
+int myvector(struct p2env *, struct loopinfo *);
+#endif
+
 /*
  * C compiler second pass extra defines.
  */
@@ -68,6 +68,11 @@
 #include <string.h>
 #include <stdarg.h>
 #include <stdlib.h>
+#if defined(HAVE_UNISTD_H) && defined(HAVE_SYS_WAIT_H)
+#include <unistd.h>
+#include <sys/wait.h>
+#define	P2JOBS
+#endif
 
 /*	some storage declarations */
 int nrecur;
@@ -102,6 +107,201 @@ getlab2(void)
 	return rv;
 }
 
+#ifdef P2JOBS
+/*
+ * Parallel code generation (-xjobs=N).  A finished function is handed
+ * to a forked worker, which has its own copy of all pass2 state.
+ * Output is kept in a chain of temporary files, one for each function
+ * and one for each stretch of pass1 output in between, and the files
+ * are copied to the real output in order as they are completed.
+ */
+struct p2job {
+	struct p2job *next;
+	FILE *fp;
+	pid_t pid;	/* worker, 0 when done, -1 while being written */
+};
+
+#define	P2MAXOUT	64	/* output files kept open at most */
+
+static struct p2job *jobfirst, **joblast = &jobfirst, *curout;
+static int outfd = -1, njobs, nout, p2worker;
+
+/*
+ * Copy completed output files to the real output.
+ */
+static void
+p2flush(void)
+{
+	struct p2job *j;
+	char buf[8192];
+	ssize_t n;
+
+	while ((j = jobfirst) != NULL && j->pid == 0) {
+		(void)lseek(fileno(j->fp), 0, SEEK_SET);
+		while ((n = read(fileno(j->fp), buf, sizeof buf)) > 0)
+			if (write(outfd, buf, n) != n)
+				cerror("output write error");
+		fclose(j->fp);
+		nout--;
+		if ((jobfirst = j->next) == NULL)
+			joblast = &jobfirst;
+		free(j);
+	}
+}
+
+/*
+ * Reap a worker.  A failed worker counts as an error.
+ */
+static int
+p2wait(int flags)
+{
+	struct p2job *j;
+	pid_t pid;
+	int st;
+
+	if ((pid = waitpid(-1, &st, flags)) <= 0)
+		return 0;
+	for (j = jobfirst; j; j = j->next) {
+		if (j->pid != pid)
+			continue;
+		j->pid = 0;
+		njobs--;
+		if (!WIFEXITED(st) || WEXITSTATUS(st) != 0)
+			nerrors++;
+		break;
+	}
+	p2flush();
+	return 1;
+}
+
+/*
+ * Start a new output file and direct stdout to it.
+ */
+static struct p2job *
+p2newout(void)
+{
+	struct p2job *j;
+
+	fflush(stdout);
+	if ((j = malloc(sizeof(struct p2job))) == NULL ||
+	    (j->fp = tmpfile()) == NULL || dup2(fileno(j->fp), 1) < 0)
+		cerror("cannot create temporary output file");
+	if (curout && curout->pid == -1)
+		curout->pid = 0;
+	j->next = NULL;
+	j->pid = -1;
+	nout++;
+	*joblast = j;
+	joblast = &j->next;
+	return curout = j;
+}
+
+static void
+cntxasm(NODE *p, void *arg)
+{
+	if (p->n_op == XASM)
+		(*(int *)arg)++;
+}
+
+/*
+ * Upper bound of the labels pass2 may take with getlab2().  These are
+ * reserved before the worker starts, so that pass1 does not hand them
+ * out again for later functions.
+ */
+static int
+p2labels(struct p2env *p2e)
+{
+	struct interpass_prolog *epp;
+	struct interpass *ip;
+	NODE *p;
+	int *l, n = 0;
+
+	epp = (struct interpass_prolog *)DLIST_PREV(&p2e->ipole, qelem);
+	DLIST_FOREACH(ip, &p2e->ipole, qelem) {
+		if (xssa)
+			n++; /* fallthrough edge */
+		if (ip->type != IP_NODE)
+			continue;
+		p = ip->ip_node;
+		walkf(p, cntxasm, &n); /* %= */
+		if (!xssa)
+			continue;
+		if (p->n_op == CBRANCH)
+			n += 2; /* branch edge and add_labels() */
+		else if (p->n_op == GOTO && p->n_left->n_op != ICON)
+			for (l = epp->ip_labels; *l; l++)
+				n++;
+	}
+	return n;
+}
+
+/*
+ * Hand the function in p2e to a worker.  Returns 1 in the parent,
+ * which is then done with the function, and 0 in the worker or if
+ * no worker could be started.
+ */
+static int
+p2fork(struct p2env *p2e)
+{
+	extern int getlab(void);
+	struct interpass *ip;
+	struct p2job *j;
+	pid_t pid;
+	int n;
+
+	if (outfd < 0) {
+		fflush(stdout);
+		if ((outfd = dup(1)) < 0)
+			return 0;
+		p2newout();
+	}
+	/* a slow function holds back the output of all after it */
+	while ((njobs >= xjobs || nout >= P2MAXOUT) && p2wait(0))
+		;
+	j = p2newout();
+	if ((pid = fork()) < 0)
+		return 0;
+	if (pid == 0) {
+		p2worker = 1;
+		return 0;
+	}
+	j->pid = pid;
+	njobs++;
+	p2newout();
+
+	for (n = p2labels(p2e); n > 0; n--)
+		(void)getlab();
+	DLIST_FOREACH(ip, &p2e->ipole, qelem)
+		if (ip->type == IP_NODE)
+			tfree(ip->ip_node);
+	while (p2wait(WNOHANG))
+		;
+	return 1;
+}
+#endif
+
+/*
+ * Wait for all workers and write out what remains.
+ */
+void
+pass2_done(void)
+{
+#ifdef P2JOBS
+	if (outfd < 0)
+		return;
+	fflush(stdout);
+	curout->pid = 0;
+	while (njobs > 0 && p2wait(0))
+		;
+	p2flush();
+	if (dup2(outfd, 1) < 0)
+		cerror("cannot restore output");
+	close(outfd);
+	outfd = -1;
+	curout = NULL;
+#endif
+}
+
 #ifdef PCC_DEBUG
 static int *lbldef, *lbluse;
 static void
@@ -318,6 +518,88 @@ deluseless(NODE *p)
 	return NULL;
 }
 
+/*
+ * Expression trees deeper than MAXTDEPTH are cut into pieces that are
+ * evaluated into temporaries first, so that instruction selection and
+ * register allocation, which recurse over the trees, cannot run out
+ * of stack on very long generated expressions.  Only operators that
+ * always yield an rvalue of scalar type are cut.
+ */
+#define	MAXTDEPTH	256
+
+struct sdeep {
+	struct p2env *p2e;
+	struct interpass *ip;
+	int *stk, sp, sz;
+	int lstk[WSTKSZ];
+};
+
+static void
+splitnode(NODE *p, void *arg)
+{
+	struct sdeep *sd = arg;
+	struct interpass *ip;
+	NODE *q;
+	int h, n;
+
+	switch (optype(p->n_op)) {
+	case BITYPE:
+		h = sd->stk[--sd->sp];
+		if (sd->stk[sd->sp-1] > h)
+			h = sd->stk[sd->sp-1];
+		sd->sp--;
+		break;
+	case UTYPE:
+		h = sd->stk[--sd->sp];
+		break;
+	default:
+		h = 0;
+	}
+	if (++h > MAXTDEPTH) {
+		switch (p->n_op) {
+		case PLUS: case MINUS: case MUL: case DIV: case MOD:
+		case AND: case OR: case ER: case LS: case RS:
+			q = talloc();
+			*q = *p;
+			n = sd->p2e->epp->ip_tmpnum++;
+			ip = ipnode(mkbinode(ASSIGN,
+			    mklnode(TEMP, 0, n, p->n_type), q, p->n_type));
+			ip->lineno = sd->ip->lineno;
+			DLIST_INSERT_BEFORE(sd->ip, ip, qelem);
+			p->n_op = TEMP;
+			p->n_lval = 0;
+			p->n_rval = n;
+			p->n_name = "";
+			h = 1;
+			break;
+		}
+	}
+	if (sd->sp == sd->sz)
+		sd->stk = wstkgrow(sd->stk, sd->lstk, &sd->sz, sizeof(int));
+	sd->stk[sd->sp++] = h;
+}
+
+static void
+splitdeep(struct p2env *p2e)
+{
+	struct interpass *ip;
+	struct sdeep sd;
+
+	sd.p2e = p2e;
+	sd.sp = 0;
+	sd.sz = WSTKSZ;
+	sd.stk = sd.lstk;
+	DLIST_FOREACH(ip, &p2e->ipole, qelem) {
+		if (ip->type != IP_NODE)
+			continue;
+		sd.ip = ip;
+		walkf(ip->ip_node, splitnode, &sd);
+		sd.sp = 0;
+	}
+	if (sd.stk != sd.lstk)
+		free(sd.stk);
+}
+
 /*
  * Receives interpass structs from pass1.
  */
@@ -338,6 +620,11 @@ pass2_compile(struct interpass *ip)
 	if (ip->type != IP_EPILOG)
 		return;
 
+#ifdef P2JOBS
+	if (xjobs > 1 && p2fork(p2e))
+		return;
+#endif
+
 #ifdef PCC_DEBUG
 	if (e2debug) {
 		printf("Entering pass2\n");
@@ -354,6 +641,11 @@ pass2_compile(struct interpass *ip)
 #endif
 	myreader(&p2e->ipole); /* local massage of input */
 
+	if (xtemps && p2e->epp->ip_aggrs)
+		splitaggr(p2e); /* put small structs in temporaries */
+
+	splitdeep(p2e); /* bound expression depth */
+
 	/*
 	 * Do initial modification of the trees.  Two loops;
 	 * - first, search for ADDROF of TEMPs, these must be
@@ -412,6 +704,13 @@ pass2_compile(struct interpass *ip)
 
 	DLIST_FOREACH(ip, &p2e->ipole, qelem)
 		emit(ip);
+
+#ifdef P2JOBS
+	if (p2worker) {
+		fflush(stdout);
+		_exit(nerrors ? 1 : 0);
+	}
+#endif
 }
 
 void
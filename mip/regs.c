@@ -35,6 +35,7 @@
 #include <stdint.h>
 #endif
 #include <stdlib.h>
+#include <time.h>
 
 #define	MAXLOOP	20 /* Max number of allocation loops XXX 3 should be enough */
 
@@ -133,6 +134,7 @@ typedef struct regw {
 	struct regw *r_onlist;	/* which work list this node belongs to */
 	MOVL *r_moveList;	/* moves associated with this node */
 	int nodnum;		/* Human-readable node number */
+	int r_start, r_end;	/* live interval, for linear scan */
 } REGW;
 
 /*
@@ -599,8 +601,10 @@ worklistmoveadd(REGW *src, REGW *dst)
 #define	HASHSZ	16384
 struct AdjSet {
 	struct AdjSet *next;
+	struct AdjSet *onext;	/* creation order, see savegraph() */
 	REGW *u, *v;
 } *edgehash[HASHSZ];
+static struct AdjSet *edgelog, **edgelast;
 
 /* Check if a node pair is adjacent */
 static int
@@ -649,9 +653,16 @@ adjSetadd(REGW *u, REGW *v)
 	w->u = u, w->v = v;
 	w->next = edgehash[x];
 	edgehash[x] = w;
+	w->onext = NULL;
+	if (edgelast) {
+		*edgelast = w;
+		edgelast = &w->onext;
+	}
 	return 0;
 }
 
+static int lspos;	/* instruction number while building, 0 if not */
+
 /*
  * Add an interference edge between two nodes.
  */
@@ -674,6 +685,17 @@ AddEdge(REGW *u, REGW *v)
 
 	if (u == v)
 		return;
+	if (lspos) {
+		/* both are live here, stretch their intervals */
+		if (u->r_start == 0 || lspos < u->r_start)
+			u->r_start = lspos;
+		if (lspos > u->r_end)
+			u->r_end = lspos;
+		if (v->r_start == 0 || lspos < v->r_start)
+			v->r_start = lspos;
+		if (lspos > v->r_end)
+			v->r_end = lspos;
+	}
 	if (adjSetadd(u, v))
 		return;
 
@@ -1122,6 +1144,9 @@ insnwalk(NODE *p)
 			case NLEFT:
 				addalledges(&ablock[rc->num]);
 				ONLY(lr, moveadd);
+				if (p->n_regw && (q->rewrite & RRIGHT) &&
+				    rspecial(q, NRES) != rc->num)
+					AddEdge(p->n_regw, &ablock[rc->num]);
 				if (optype(o) != BITYPE)
 					break;
 				/* FALLTHROUGH */
@@ -1131,6 +1156,10 @@ insnwalk(NODE *p)
 			case NRIGHT:
 				addalledges(&ablock[rc->num]);
 				ONLY(rr, moveadd);
+				/* left is moved to result before right is */
+				if (p->n_regw && (q->rewrite & RLEFT) &&
+				    rspecial(q, NRES) != rc->num)
+					AddEdge(p->n_regw, &ablock[rc->num]);
 				/* FALLTHROUGH */
 			case NOLEFT:
 				addedge_r(p->n_left, &ablock[rc->num]);
@@ -1606,7 +1635,7 @@ Build(struct p2env *p2e)
 	struct interpass *ip;
 	struct basicblock *bb;
 	bittype *saved;
-	int i, j, again;
+	int i, j, again, lsend;
 
 	if (xtemps == 0) {
 		/*
@@ -1709,26 +1738,43 @@ livagain:
 		}
 	}
 
+	lspos = 0;
 	DLIST_FOREACH(bb, &p2e->bblocks, bbelem) {
 		RDEBUG(("liveadd bb %d\n", bb->bbnum));
 		i = bb->bbnum;
 		for (j = 0; j < xbits; j += NUMBITS)
 			live[j/NUMBITS] = 0;
 		SETCOPY(live, out[i], j, xbits);
+		if (xlinscan) {
+			/* number instructions in program order */
+			for (ip = bb->first; ; ip = DLIST_NEXT(ip, qelem)) {
+				lspos++;
+				if (ip == bb->last)
+					break;
+			}
+		}
+		lsend = lspos;
 		for (ip = bb->last; ; ip = DLIST_PREV(ip, qelem)) {
 			if (ip->type == IP_NODE) {
 				if (ip->ip_node->n_op == XASM) {
 					flist(ip->ip_node->n_right,
 					    xasmconstr, 0);
 					listf(ip->ip_node->n_left, setxarg);
+					/* inputs may not be clobbered either */
+					flist(ip->ip_node->n_right,
+					    xasmconstr, 0);
 					listf(ip->ip_node->n_left, delcl);
 				} else
 					insnwalk(ip->ip_node);
 			}
 			if (ip == bb->first)
 				break;
+			if (lspos)
+				lspos--;
 		}
+		lspos = lsend;
 	}
+	lspos = 0;
 
 #ifdef PCC_DEBUG
 	if (r2debug) {
@@ -2447,6 +2493,112 @@ AssignColors(struct interpass *ip)
 	}
 }
 
+/*
+ * Linear-scan allocation, used instead of the simplify/coalesce loop
+ * when compile speed matters more than the code.  Nodes are colored
+ * in order of the start of their live intervals as found by Build().
+ * The interference edges are used to find the colors that are in use
+ * by the active intervals, since they also carry the register
+ * constraints of each instruction.  If no color is left, the active
+ * long-lived temporary that ends last is spilled if that frees one,
+ * otherwise the node itself.
+ */
+#define	LSTART(w)	((w) >= &nblock[tempmin] && (w) < &nblock[basetemp] ? \
+	0 : (w)->r_start)	/* register variables are live on entry */
+
+static void
+LinearScan(void)
+{
+	REGW **ord, *w, *o, *v;
+	ADJL *x;
+	int *cnt, i, n, maxpos, okColors, c;
+
+	RDEBUG(("LinearScan\n"));
+	n = maxpos = 0;
+	DLIST_FOREACH(w, &simplifyWorklist, link)
+		n++, maxpos = MAX(maxpos, LSTART(w));
+	DLIST_FOREACH(w, &freezeWorklist, link)
+		n++, maxpos = MAX(maxpos, LSTART(w));
+	DLIST_FOREACH(w, &spillWorklist, link)
+		n++, maxpos = MAX(maxpos, LSTART(w));
+
+	/* bucket sort on interval start */
+	ord = tmpalloc((n+1) * sizeof(REGW *));
+	cnt = tmpalloc((maxpos+2) * sizeof(int));
+	memset(cnt, 0, (maxpos+2) * sizeof(int));
+	DLIST_FOREACH(w, &simplifyWorklist, link)
+		cnt[LSTART(w)+1]++;
+	DLIST_FOREACH(w, &freezeWorklist, link)
+		cnt[LSTART(w)+1]++;
+	DLIST_FOREACH(w, &spillWorklist, link)
+		cnt[LSTART(w)+1]++;
+	for (i = 1; i <= maxpos; i++)
+		cnt[i] += cnt[i-1];
+	while (!WLISTEMPTY(simplifyWorklist)) {
+		w = POPWLIST(simplifyWorklist);
+		ord[cnt[LSTART(w)]++] = w;
+	}
+	while (!WLISTEMPTY(freezeWorklist)) {
+		w = POPWLIST(freezeWorklist);
+		ord[cnt[LSTART(w)]++] = w;
+	}
+	while (!WLISTEMPTY(spillWorklist)) {
+		w = POPWLIST(spillWorklist);
+		ord[cnt[LSTART(w)]++] = w;
+	}
+
+	for (i = 0; i < n; i++) {
+		w = ord[i];
+		okColors = classmask(CLASS(w));
+		v = NULL;
+		for (x = ADJLIST(w); x; x = x->r_next) {
+			o = GetAlias(x->a_temp);
+			if (ONLIST(o) != &coloredNodes &&
+			    ONLIST(o) != &precolored)
+				continue;
+			okColors &= ~aliasmap(CLASS(w), COLOR(o));
+			if (ONLIST(o) == &coloredNodes &&
+			    o >= &nblock[tempmin] && o < &nblock[tempmax] &&
+			    !innotspill(o - nblock) && o->r_end > w->r_end &&
+			    (v == NULL || o->r_end > v->r_end))
+				v = o;
+		}
+		if (okColors == 0 && v != NULL) {
+			/* would spilling v give a color? */
+			okColors = classmask(CLASS(w));
+			for (x = ADJLIST(w); x; x = x->r_next) {
+				o = GetAlias(x->a_temp);
+				if (o == v || (ONLIST(o) != &coloredNodes &&
+				    ONLIST(o) != &precolored))
+					continue;
+				okColors &= ~aliasmap(CLASS(w), COLOR(o));
+			}
+			if (okColors) {
+#ifdef PCC_DEBUG
+				RDEBUG(("Spilling node %d for %d\n",
+				    ASGNUM(v), ASGNUM(w)));
+#endif
+				DELWLIST(v);
+				PUSHWLIST(v, spilledNodes);
+			}
+		}
+		if (okColors == 0) {
+			PUSHWLIST(w, spilledNodes);
+#ifdef PCC_DEBUG
+			RDEBUG(("Spilling node %d\n", ASGNUM(w)));
+#endif
+		} else {
+			c = colfind(okColors, w);
+			COLOR(w) = c;
+			PUSHWLIST(w, coloredNodes);
+#ifdef PCC_DEBUG
+			RDEBUG(("Coloring %d with %s, interval %d-%d\n",
+			    ASGNUM(w), rnames[c], w->r_start, w->r_end));
+#endif
+		}
+	}
+}
+
 static REGW *spole, *longsp;
 /*
  * Store all spilled nodes in memory by fetching a temporary on the stack.
@@ -2820,10 +2972,8 @@ RewriteProgram(struct interpass *ip)
 		}
 	}
 
-	if (rwtyp == LEAVES) {
+	if (rwtyp == LEAVES)
 		leafrewrite(ip, &longregs);
-		rwtyp = ONLYPERM;
-	}
 
 	if (rwtyp == 0 && !DLIST_ISEMPTY(&shortregs, link)) {
 		/* Must rewrite the trees */
@@ -2889,18 +3039,190 @@ insgen()
 #endif
 
 /*
- * Do register allocation for trees by graph-coloring.
+ * The interference graph as last built from the trees.  A spill of
+ * only permanent registers leaves the trees untouched, so the graph
+ * is then the same except for the spilled registers and is replayed
+ * from here instead of redoing instruction selection and liveness.
+ */
+static REGW **gnodes;		/* initial list */
+static REGM **gmoves;		/* moves, in creation order */
+static int ngnodes, ngmoves;
+
+#define	SAVEDPERM(w)	((w) >= &nblock[tempmin] && (w) < &nblock[basetemp] && \
+	nsavregs[(w) - nblock - tempmin])
+
+/* statistics, printed with -s */
+int rafuncs, rarounds, ramaxrounds, rafull, raincr;
+long rafulltime, raincrtime;
+
+static void
+savegraph(void)
+{
+	REGW *w;
+	REGM *m;
+	int n;
+
+	edgelast = NULL;
+	n = 0;
+	DLIST_FOREACH(w, &initial, link)
+		n++;
+	gnodes = tmpalloc((n+1) * sizeof(REGW *));
+	ngnodes = 0;
+	DLIST_FOREACH(w, &initial, link)
+		gnodes[ngnodes++] = w;
+	n = 0;
+	DLIST_FOREACH(m, &worklistMoves, link)
+		n++;
+	gmoves = tmpalloc((n+1) * sizeof(REGM *));
+	ngmoves = 0;
+	DLIST_FOREACH_REVERSE(m, &worklistMoves, link)
+		gmoves[ngmoves++] = m;
+}
+
+/*
+ * Build the interference graph from the trees.
+ */
+static void
+treegraph(struct p2env *p2e)
+{
+	struct interpass *ipole = &p2e->ipole;
+	extern NODE *nodepole;
+	struct interpass *ip;
+	int i, j, tbits = tempmax - tempmin;
+
+	edgelog = NULL;
+	edgelast = &edgelog;
+	memset(edgehash, 0, sizeof(edgehash));
+
+	/* clear adjacent node and move lists */
+	for (i = 0; i < MAXREGS; i++) {
+		for (j = 0; j < NUMCLASS+1; j++)
+			NCLASS(&ablock[i], j) = 0;
+		ablock[i].r_moveList = NULL;
+	}
+
+	if (tbits) {
+		memset(nblock+tempmin, 0, tbits * sizeof(REGW));
+#ifdef PCC_DEBUG
+		for (i = tempmin; i < tempmax; i++)
+			nblock[i].nodnum = i;
+#endif
+	}
+	memset(live, 0, BIT2BYTE(xbits));
+	RPRINTIP(ipole);
+	DLIST_INIT(&initial, link);
+	ntsz = 0;
+	DLIST_FOREACH(ip, ipole, qelem) {
+		extern int thisline;
+		if (ip->type != IP_NODE)
+			continue;
+		nodepole = ip->ip_node;
+		thisline = ip->lineno;
+		if (ip->ip_node->n_op != XASM) {
+			clrsu(ip->ip_node);
+			geninsn(ip->ip_node, FOREFF);
+		}
+		nsucomp(ip->ip_node);
+		walkf(ip->ip_node, traclass, 0);
+	}
+	nodepole = NIL;
+	RDEBUG(("nsucomp allocated %d temps (%d,%d)\n", 
+	    tempmax-tempmin, tempmin, tempmax));
+
+#ifdef PCC_DEBUG
+	use_regw = 1;
+	RPRINTIP(ipole);
+	use_regw = 0;
+#endif
+	RDEBUG(("ngenregs: numtemps %d (%d, %d)\n", tempmax-tempmin,
+		    tempmin, tempmax));
+
+	DLIST_INIT(&coalescedMoves, link);
+	DLIST_INIT(&constrainedMoves, link);
+	DLIST_INIT(&frozenMoves, link);
+	DLIST_INIT(&worklistMoves, link);
+	DLIST_INIT(&activeMoves, link);
+
+	/* Set class and move-related for perm regs */
+	for (i = 0; i < (NPERMREG-1); i++) {
+		if (nsavregs[i])
+			continue;
+		nblock[i+tempmin].r_class = GCLASS(permregs[i]);
+		DLIST_INSERT_AFTER(&initial, &nblock[i+tempmin], link);
+		moveadd(&nblock[i+tempmin], &ablock[permregs[i]]);
+		addalledges(&nblock[i+tempmin]);
+	}
+
+	Build(p2e);
+	RDEBUG(("Build done\n"));
+	savegraph();
+}
+
+/*
+ * Rebuild the graph after only permanent registers were spilled.
+ * Edges and moves are added back in the order they were first
+ * found, so the result is what treegraph() would give.
+ */
+static void
+regraph(void)
+{
+	struct AdjSet *e;
+	REGW *w;
+	REGM *m;
+	int i, j;
+
+	memset(edgehash, 0, sizeof(edgehash));
+	for (i = 0; i < MAXREGS; i++) {
+		for (j = 0; j < NUMCLASS+1; j++)
+			NCLASS(&ablock[i], j) = 0;
+		ablock[i].r_moveList = NULL;
+	}
+
+	DLIST_INIT(&initial, link);
+	for (i = 0; i < ngnodes; i++) {
+		w = gnodes[i];
+		w->r_adjList = NULL;
+		for (j = 1; j < NUMCLASS+1; j++)
+			NCLASS(w, j) = 0; /* leaf info in 0 is kept */
+		w->r_alias = NULL;
+		w->r_color = 0;
+		w->r_onlist = NULL;
+		w->r_moveList = NULL;
+		if (!SAVEDPERM(w))
+			DLIST_INSERT_BEFORE(&initial, w, link);
+	}
+
+	DLIST_INIT(&coalescedMoves, link);
+	DLIST_INIT(&constrainedMoves, link);
+	DLIST_INIT(&frozenMoves, link);
+	DLIST_INIT(&worklistMoves, link);
+	DLIST_INIT(&activeMoves, link);
+
+	for (e = edgelog; e; e = e->onext)
+		if (!SAVEDPERM(e->u) && !SAVEDPERM(e->v))
+			AddEdge(e->u, e->v);
+	for (i = 0; i < ngmoves; i++) {
+		m = gmoves[i];
+		if (!SAVEDPERM(m->src) && !SAVEDPERM(m->dst))
+			moveadd(m->dst, m->src);
+	}
+	RDEBUG(("regraph: %d nodes %d moves\n", ngnodes, ngmoves));
+}
+
+/*
+ * Do register allocation for trees by graph-coloring,
+ * or by linear scan if xlinscan is set.
  */
 void
 ngenregs(struct p2env *p2e)
 {
 	struct interpass *ipole = &p2e->ipole;
-	extern NODE *nodepole;
 	struct interpass *ip;
 	int i, j, tbits;
 	int uu[NPERMREG] = { -1 };
 	int xnsavregs[NPERMREG];
-	int beenhere = 0;
+	int beenhere = 0, rwtyp = 0, nrounds = 0;
+	clock_t t0 = 0;
 	TWORD type;
 
 	DLIST_INIT(&lunused, link);
@@ -2965,72 +3287,19 @@ ssagain:
 
 
 recalc:
-onlyperm: /* XXX - should not have to redo all */
-	memset(edgehash, 0, sizeof(edgehash));
-
-	/* clear adjacent node list */
-	for (i = 0; i < MAXREGS; i++)
-		for (j = 0; j < NUMCLASS+1; j++)
-			NCLASS(&ablock[i], j) = 0;
-
-	if (tbits) {
-		memset(nblock+tempmin, 0, tbits * sizeof(REGW));
-#ifdef PCC_DEBUG
-		for (i = tempmin; i < tempmax; i++)
-			nblock[i].nodnum = i;
-#endif
-	}
-	memset(live, 0, BIT2BYTE(xbits));
-	RPRINTIP(ipole);
-	DLIST_INIT(&initial, link);
-	ntsz = 0;
-	DLIST_FOREACH(ip, ipole, qelem) {
-		extern int thisline;
-		if (ip->type != IP_NODE)
-			continue;
-		nodepole = ip->ip_node;
-		thisline = ip->lineno;
-		if (ip->ip_node->n_op != XASM) {
-			clrsu(ip->ip_node);
-			geninsn(ip->ip_node, FOREFF);
-		}
-		nsucomp(ip->ip_node);
-		walkf(ip->ip_node, traclass, 0);
-	}
-	nodepole = NIL;
-	RDEBUG(("nsucomp allocated %d temps (%d,%d)\n", 
-	    tempmax-tempmin, tempmin, tempmax));
-
-#ifdef PCC_DEBUG
-	use_regw = 1;
-	RPRINTIP(ipole);
-	use_regw = 0;
-#endif
-	RDEBUG(("ngenregs: numtemps %d (%d, %d)\n", tempmax-tempmin,
-		    tempmin, tempmax));
-
-	DLIST_INIT(&coalescedMoves, link);
-	DLIST_INIT(&constrainedMoves, link);
-	DLIST_INIT(&frozenMoves, link);
-	DLIST_INIT(&worklistMoves, link);
-	DLIST_INIT(&activeMoves, link);
-
-	/* Set class and move-related for perm regs */
-	for (i = 0; i < (NPERMREG-1); i++) {
-		if (nsavregs[i])
-			continue;
-		nblock[i+tempmin].r_class = GCLASS(permregs[i]);
-		DLIST_INSERT_AFTER(&initial, &nblock[i+tempmin], link);
-		moveadd(&nblock[i+tempmin], &ablock[permregs[i]]);
-		addalledges(&nblock[i+tempmin]);
-	}
-
-	Build(p2e);
-	RDEBUG(("Build done\n"));
+	if (sflag)
+		t0 = clock();
+	nrounds++;
+	if (rwtyp == ONLYPERM)
+		regraph();
+	else
+		treegraph(p2e);
 	MkWorklist();
 	RDEBUG(("MkWorklist done\n"));
 	Coalassign(p2e);
-	do {
+	if (xlinscan) {
+		LinearScan();
+	} else do {
 		if (!WLISTEMPTY(simplifyWorklist))
 			Simplify();
 		else if (!WLISTEMPTY(worklistMoves))
@@ -3046,10 +3315,20 @@ onlyperm: /* XXX - should not have to redo all */
 	RDEBUG(("After AssignColors\n"));
 	RPRINTIP(ipole);
 
+	if (sflag) {
+		long us = (long)((clock() - t0) * 1000000.0 / CLOCKS_PER_SEC);
+
+		if (rwtyp == ONLYPERM)
+			raincr++, raincrtime += us;
+		else
+			rafull++, rafulltime += us;
+	}
+
 	if (!WLISTEMPTY(spilledNodes)) {
-		switch (RewriteProgram(ipole)) {
+		switch (rwtyp = RewriteProgram(ipole)) {
 		case ONLYPERM:
-			goto onlyperm;
+		case LEAVES:
+			goto recalc;
 		case SMALL:
 			optimize(p2e);
 			if (beenhere++ == MAXLOOP)
@@ -3108,6 +3387,10 @@ onlyperm: /* XXX - should not have to redo all */
 		DLIST_INSERT_BEFORE(ipole->qelem.q_back, ip, qelem);
 	}
 	stktemp = freetemp(ntsz);
+	rafuncs++;
+	rarounds += nrounds;
+	if (nrounds > ramaxrounds)
+		ramaxrounds = nrounds;
 	memcpy(p2e->epp->ipp_regs, p2e->ipp->ipp_regs, sizeof(p2e->epp->ipp_regs));
 	/* Done! */
 }